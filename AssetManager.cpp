@@ -0,0 +1,285 @@
+#include <iostream>
+#include <filesystem>
+#include <future>
+#include <algorithm>
+#include <cstdint>
+
+#include "AssetManager.h"
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "Trace.h"
+
+AssetManager::AssetManager(size_t memoryBudget, unsigned int threadCount, bool useMeshCache)
+	: memoryBudget(memoryBudget), useMeshCache(useMeshCache), parserMemory(memoryBudget / 4), pool(threadCount) {
+}
+
+namespace {
+	bool hashFile(const std::string& path, uint64_t& outHash){
+		TraceScope trace("AssetManager::hash");
+		MappedFile mapped(path);
+		if(mapped.wasError()){
+			return false;
+		}
+		outHash = fnv1a64(mapped.data(), mapped.size());
+		trace.setBytes(mapped.size());
+		return true;
+	}
+}
+
+std::vector<MeshHandle> AssetManager::loadBatch(const std::vector<std::string>& paths){
+	TraceScope trace("AssetManager::loadBatch");
+	std::vector<MeshHandle> handles(paths.size());
+
+	// A file not resident under its path, with the requests waiting for it
+	class Pending {
+		public:
+			std::string path;
+			std::vector<size_t> requests;
+			size_t fileBytes = 0;
+			bool hashed = false;
+			uint64_t contentHash = 0;
+			// Earlier pending file with the same contents, parsed in its place
+			size_t sameAs = SIZE_MAX;
+			MeshHandle asset;
+	};
+	// A resident asset of the same size as a pending file, not hashed yet
+	class ResidentToHash {
+		public:
+			std::string path;
+			bool hashed = false;
+			uint64_t contentHash = 0;
+	};
+
+	std::vector<std::string> canonicalPaths(paths.size());
+	std::vector<size_t> fileSizes(paths.size());
+	for(size_t i = 0; i < paths.size(); i++){
+		std::error_code error;
+		canonicalPaths[i] = std::filesystem::canonical(paths[i], error).string();
+		if(!error){
+			fileSizes[i] = std::filesystem::file_size(canonicalPaths[i], error);
+		}
+		if(error){
+			std::cerr << "Error: Cannot find asset " << paths[i] << std::endl;
+			canonicalPaths[i].clear();
+		}
+	}
+
+	std::vector<Pending> pending;
+	std::vector<ResidentToHash> residentToHash;
+	{
+		std::unordered_map<std::string, size_t> pendingByPath;
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.requests += paths.size();
+		for(size_t i = 0; i < paths.size(); i++){
+			if(canonicalPaths[i].empty()){
+				stats.failed++;
+				continue;
+			}
+			auto resident = byPath.find(canonicalPaths[i]);
+			if(resident != byPath.end()){
+				handles[i] = resident->second->asset;
+				touch(resident->second);
+				stats.pathHits++;
+				continue;
+			}
+			auto known = pendingByPath.find(canonicalPaths[i]);
+			if(known == pendingByPath.end()){
+				known = pendingByPath.emplace(canonicalPaths[i], pending.size()).first;
+				pending.emplace_back();
+				pending.back().path = canonicalPaths[i];
+				pending.back().fileBytes = fileSizes[i];
+			}
+			pending[known->second].requests.push_back(i);
+		}
+
+		// Equal contents need equal sizes, so only files sharing a size with another are hashed
+		std::unordered_map<size_t, unsigned int> pendingSizes;
+		for(const Pending& file : pending){
+			pendingSizes[file.fileBytes]++;
+		}
+		for(Pending& file : pending){
+			bool sameSizeResident = false;
+			auto range = bySize.equal_range(file.fileBytes);
+			for(auto resident = range.first; resident != range.second; ++resident){
+				sameSizeResident = true;
+				if(!resident->second->hashed){
+					residentToHash.emplace_back();
+					residentToHash.back().path = resident->second->paths[0];
+				}
+			}
+			file.hashed = sameSizeResident || pendingSizes[file.fileBytes] > 1;
+		}
+	}
+	if(pending.empty()){
+		return handles;
+	}
+
+	std::vector<std::future<void>> hashes;
+	for(Pending& file : pending){
+		if(file.hashed){
+			hashes.push_back(pool.submit([&file](){ file.hashed = hashFile(file.path, file.contentHash); }));
+		}
+	}
+	for(ResidentToHash& file : residentToHash){
+		hashes.push_back(pool.submit([&file](){ file.hashed = hashFile(file.path, file.contentHash); }));
+	}
+	for(std::future<void>& result : hashes){
+		result.get();
+	}
+
+	// Resident under another path, or the same contents as an earlier file of this batch
+	std::vector<size_t> toParse;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(const ResidentToHash& file : residentToHash){
+			auto resident = byPath.find(file.path);
+			if(file.hashed && resident != byPath.end()){
+				resident->second->hashed = true;
+				resident->second->contentHash = file.contentHash;
+			}
+		}
+		for(size_t i = 0; i < pending.size(); i++){
+			Pending& file = pending[i];
+			if(file.hashed){
+				auto range = bySize.equal_range(file.fileBytes);
+				for(auto resident = range.first; resident != range.second && !file.asset; ++resident){
+					Entry& entry = *resident->second;
+					if(entry.hashed && entry.contentHash == file.contentHash){
+						file.asset = entry.asset;
+						entry.paths.push_back(file.path);
+						byPath[file.path] = resident->second;
+						touch(resident->second);
+						stats.contentHits += file.requests.size();
+					}
+				}
+				for(size_t earlier = 0; earlier < i && !file.asset && file.sameAs == SIZE_MAX; earlier++){
+					const Pending& other = pending[earlier];
+					if(other.hashed && other.sameAs == SIZE_MAX && other.fileBytes == file.fileBytes && other.contentHash == file.contentHash){
+						file.sameAs = earlier;
+						stats.contentHits += file.requests.size();
+					}
+				}
+				if(file.asset || file.sameAs != SIZE_MAX){
+					continue;
+				}
+			}
+			toParse.push_back(i);
+		}
+	}
+
+	// With several files in flight each is parsed on one thread; a single one gets the parallel parser
+	unsigned int parserThreads = toParse.size() > 1 ? 1 : 0;
+	std::vector<std::future<MeshHandle>> parsed;
+	for(size_t i : toParse){
+		Pending& file = pending[i];
+		parsed.push_back(pool.submit([this, &file, parserThreads](){
+			return parse(file.path, file.fileBytes, parserThreads);
+		}));
+	}
+	for(size_t i = 0; i < toParse.size(); i++){
+		pending[toParse[i]].asset = parsed[i].get();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for(Pending& file : pending){
+		if(file.sameAs != SIZE_MAX){
+			file.asset = pending[file.sameAs].asset;
+		}
+		if(!file.asset){
+			stats.failed += file.requests.size();
+			continue;
+		}
+		auto resident = byPath.find(file.path);
+		if(resident != byPath.end()){
+			// Another batch got there first, or this is an alias registered above
+			file.asset = resident->second->asset;
+			touch(resident->second);
+		} else if(file.asset->path == file.path){
+			stats.parsed++;
+			entries.push_front(Entry());
+			Entry& entry = entries.front();
+			entry.asset = file.asset;
+			entry.paths.push_back(file.path);
+			entry.hashed = file.hashed;
+			entry.contentHash = file.contentHash;
+			byPath[file.path] = entries.begin();
+			bySize.emplace(file.fileBytes, entries.begin());
+			stats.residentBytes += file.asset->bytes;
+		} else {
+			auto parsedEntry = byPath.find(file.asset->path);
+			if(parsedEntry != byPath.end()){
+				parsedEntry->second->paths.push_back(file.path);
+				byPath[file.path] = parsedEntry->second;
+			}
+		}
+		for(size_t request : file.requests){
+			handles[request] = file.asset;
+		}
+	}
+	stats.peakResidentBytes = std::max(stats.peakResidentBytes, stats.residentBytes);
+	evict();
+	return handles;
+}
+
+MeshHandle AssetManager::load(const std::string& path){
+	return loadBatch({ path })[0];
+}
+
+void AssetManager::trim(){
+	std::lock_guard<std::mutex> lock(mutex);
+	evict();
+	parserMemory.release();
+}
+
+AssetManager::Stats AssetManager::getStats(){
+	std::lock_guard<std::mutex> lock(mutex);
+	Stats current = stats;
+	current.residentAssets = entries.size();
+	return current;
+}
+
+MeshHandle AssetManager::parse(const std::string& path, size_t fileBytes, unsigned int parserThreads){
+	TraceScope trace("AssetManager::parse");
+	std::shared_ptr<MeshAsset> asset = std::make_shared<MeshAsset>();
+	ObjReader objReader;
+	objReader.setThreadCount(parserThreads);
+	objReader.setMemoryResource(&parserMemory);
+	bool read = useMeshCache ? objReader.readObjFileCached(path, asset->data, true) : objReader.readObjFile(path, asset->data, true);
+	if(!read){
+		std::cerr << "Error: Cannot parse asset " << path << std::endl;
+		return nullptr;
+	}
+	asset->path = path;
+	asset->fileBytes = fileBytes;
+	asset->bytes = objDataBytes(asset->data);
+	trace.setBytes(fileBytes);
+	trace.setTriangles(asset->data.vertexIndices.size() / 3);
+	return asset;
+}
+
+void AssetManager::touch(EntryIterator entry){
+	entries.splice(entries.begin(), entries, entry);
+}
+
+void AssetManager::evict(){
+	for(auto entry = entries.end(); entry != entries.begin() && stats.residentBytes > memoryBudget; ){
+		--entry;
+		if(entry->asset.use_count() > 1){
+			continue;
+		}
+		for(const std::string& path : entry->paths){
+			byPath.erase(path);
+		}
+		auto range = bySize.equal_range(entry->asset->fileBytes);
+		for(auto sized = range.first; sized != range.second; ++sized){
+			if(sized->second == entry){
+				bySize.erase(sized);
+				break;
+			}
+		}
+		stats.residentBytes -= entry->asset->bytes;
+		stats.evictions++;
+		entry = entries.erase(entry);
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "ObjData.h"
+#include "ThreadPool.h"
+#include "RecyclingResource.h"
+
+// A model parsed once and shared by everyone who loaded it: triangulated indexed data as from
+// ObjReader::readObjFileCached. Never modified after the manager hands it out.
+class MeshAsset {
+	public:
+		// Canonical path of the file that was parsed; other paths with the same content share it
+		std::string path;
+		size_t fileBytes = 0;
+		// Of data
+		size_t bytes = 0;
+		ObjData data;
+};
+typedef std::shared_ptr<const MeshAsset> MeshHandle;
+
+// Loads batches of .obj files on a thread pool. A file is parsed at most once while its asset is
+// resident: requests are matched by canonical path first, then by a hash of the file contents,
+// so copies of a file under other names share one asset as well. Only files whose size matches
+// another one's are hashed, which leaves most of a batch with a stat before its parse. Assets are kept in least
+// recently used order and the oldest are dropped while their ObjData is over memoryBudget bytes;
+// one with a handle still alive outside the manager stays, as dropping it would not free anything
+// and a later request would parse a second copy. Safe to call from several threads.
+class AssetManager {
+	public:
+		class Stats {
+			public:
+				size_t requests = 0;
+				size_t pathHits = 0;
+				size_t contentHits = 0;
+				size_t parsed = 0;
+				size_t failed = 0;
+				size_t evictions = 0;
+				size_t residentAssets = 0;
+				size_t residentBytes = 0;
+				size_t peakResidentBytes = 0;
+		};
+
+		// threadCount workers (0 = all hardware threads). useMeshCache reads through the binary
+		// sidecar and optimizes the triangle order of a first parse (readObjFileCached); without
+		// it every parse is a plain readObjFile.
+		AssetManager(size_t memoryBudget, unsigned int threadCount = 0, bool useMeshCache = true);
+
+		AssetManager(const AssetManager&) = delete;
+		AssetManager& operator=(const AssetManager&) = delete;
+
+		// One handle per path, in the same order; null where the file can't be read or parsed
+		std::vector<MeshHandle> loadBatch(const std::vector<std::string>& paths);
+		MeshHandle load(const std::string& path);
+
+		// Evicts now, e.g. after the handles of the last batch have been released, and frees the kept
+		// parser blocks
+		void trim();
+
+		Stats getStats();
+		size_t getMemoryBudget() { return memoryBudget; }
+
+	private:
+		class Entry {
+			public:
+				MeshHandle asset;
+				// Canonical paths resolving to this asset, the parsed one first
+				std::vector<std::string> paths;
+				// FNV-1a of the file, computed once a file of the same size shows up
+				bool hashed = false;
+				uint64_t contentHash = 0;
+		};
+		typedef std::list<Entry>::iterator EntryIterator;
+
+		size_t memoryBudget;
+		bool useMeshCache;
+		// Upstream of the parser arenas, so a batch after batch reuses the blocks of the last one
+		RecyclingResource parserMemory;
+		ThreadPool pool;
+
+		std::mutex mutex;
+		// Most recently used first
+		std::list<Entry> entries;
+		std::unordered_map<std::string, EntryIterator> byPath;
+		std::unordered_multimap<size_t, EntryIterator> bySize;
+		Stats stats;
+
+		MeshHandle parse(const std::string& path, size_t fileBytes, unsigned int parserThreads);
+		void touch(EntryIterator entry);
+		void evict();
+};
@@ -0,0 +1,271 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+#include "AsyncModelLoader.h"
+#include "ObjReader.h"
+#include "MeshCache.h"
+#include "Trace.h"
+
+namespace {
+	// Corners of the cache path per queued batch, about 1.5 MB of vertices
+	const size_t cornersPerSlice = 3 * 21846;
+
+	// Add a batch of separate triangles to the ones read so far, keeping the per corner arrays
+	// aligned when only some batches have normals or uvs
+	void appendSeparateTriangles(ObjData& data, const ObjData& batch){
+		size_t corners = data.vertices.size();
+		data.vertices.insert(data.vertices.end(), batch.vertices.begin(), batch.vertices.end());
+		if(!batch.normals.empty() || !data.normals.empty()){
+			data.normals.resize(corners, glm::vec3(0.0f));
+			data.normals.insert(data.normals.end(), batch.normals.begin(), batch.normals.end());
+			data.normals.resize(data.vertices.size(), glm::vec3(0.0f));
+		}
+		if(!batch.uvs.empty() || !data.uvs.empty()){
+			data.uvs.resize(corners, glm::vec2(0.0f));
+			data.uvs.insert(data.uvs.end(), batch.uvs.begin(), batch.uvs.end());
+			data.uvs.resize(data.vertices.size(), glm::vec2(0.0f));
+		}
+	}
+}
+
+ProgressiveMesh::ProgressiveMesh(size_t initialVertices){
+	VAO = 0;
+	VBO = 0;
+	capacity = 0;
+	vertexCount = 0;
+	glGenVertexArrays(1, &VAO);
+	allocate(std::max<size_t>(initialVertices, 3));
+}
+
+ProgressiveMesh::~ProgressiveMesh(){
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+}
+
+void ProgressiveMesh::allocate(size_t newCapacity){
+	const size_t stride = floatsPerVertex * sizeof(float);
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * stride, nullptr, GL_STATIC_DRAW);
+	if(VBO != 0){
+		glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertexCount * stride);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &VBO);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	VBO = buffer;
+	capacity = newCapacity;
+
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)stride, (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, (GLsizei)stride, (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void ProgressiveMesh::append(const std::vector<float>& vertices){
+	const size_t stride = floatsPerVertex * sizeof(float);
+	size_t count = vertices.size() / floatsPerVertex;
+	if(count == 0){
+		return;
+	}
+	TraceScope trace("ProgressiveMesh::append");
+	trace.setBytes(count * stride);
+	trace.setTriangles(count / 3);
+	if(vertexCount + count > capacity){
+		allocate(std::max(capacity * 2, vertexCount + count));
+	}
+
+	// Draws only read [0, vertexCount), so the tail can be written without waiting for them
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	void* target = glMapBufferRange(GL_ARRAY_BUFFER, vertexCount * stride, count * stride,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if(target){
+		std::memcpy(target, vertices.data(), count * stride);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	} else {
+		glBufferSubData(GL_ARRAY_BUFFER, vertexCount * stride, count * stride, vertices.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	vertexCount += count;
+}
+
+void ProgressiveMesh::draw(){
+	glBindVertexArray(VAO);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertexCount);
+}
+
+AsyncModelLoader::AsyncModelLoader(const std::string& modelName, VertexLayout::Type layout, bool buildLods)
+	: modelName(modelName), layout(layout), buildLods(buildLods), errorFlag(false), cancelled(false), done(false) {
+	thread = std::thread(&AsyncModelLoader::run, this);
+}
+
+AsyncModelLoader::~AsyncModelLoader(){
+	cancelled = true;
+	if(thread.joinable()){
+		thread.join();
+	}
+}
+
+void AsyncModelLoader::run(){
+	setTraceThreadName("model loader");
+	ObjData separateTriangles;
+	bool needsCache = false;
+	if(!loadSeparateTriangles(modelName, separateTriangles, needsCache)){
+		errorFlag = true;
+		return;
+	}
+	if(cancelled){
+		return;
+	}
+
+	std::unique_ptr<PreparedModel> model(new PreparedModel());
+	prepareRenderModel(separateTriangles, layout, buildLods, *model);
+	separateTriangles = ObjData();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		prepared = std::move(model);
+	}
+
+	// The streamed batches don't keep the file's indices, which is what the cache stores
+	if(needsCache && !cancelled){
+		ObjReader objReader;
+		ObjData indexed;
+		if(objReader.readObjCached(modelName, indexed, true)){
+			printCachedLoadStats(std::cout, objReader.getCachedLoadStats());
+		}
+	}
+}
+
+bool AsyncModelLoader::loadSeparateTriangles(const std::string& name, ObjData& outData, bool& outNeedsCache){
+	ObjReader objReader;
+	std::string path = "../data/objects/" + name + ".obj";
+	MeshCache cache(path);
+	ObjData indexed;
+	// readObjCached writes the cache with the triangle order optimized
+	if(cache.load(indexed, true, true)){
+		if(!objReader.indexedToSeparateTriangles(indexed, outData)){
+			std::cout << "Invalid indices in object " << name << "\n";
+			return false;
+		}
+		for(size_t corner = 0; corner < outData.vertices.size() && !cancelled; corner += cornersPerSlice){
+			queueTriangles(outData, corner, std::min(corner + cornersPerSlice, outData.vertices.size()));
+		}
+		return true;
+	}
+
+	// Windows of about 1/16 of the file, so the first triangles show after a fraction of the parse.
+	// The ceiling leaves room for the v/vt/vn arrays, which stay below the size of their text.
+	std::error_code error;
+	size_t fileBytes = std::filesystem::file_size(path, error);
+	size_t memoryCeiling = error ? 0 : 4 * fileBytes + 64 * 1024 * 1024;
+	ObjReader::StreamStats stats;
+	bool read = objReader.readObjStreaming(name, memoryCeiling, [&](const ObjData& batch){
+		if(cancelled){
+			return false;
+		}
+		if(batch.vertices.empty()){
+			return true;
+		}
+		appendSeparateTriangles(outData, batch);
+		queueTriangles(outData, outData.vertices.size() - batch.vertices.size(), outData.vertices.size());
+		return true;
+	}, stats);
+
+	// Smooth normals need the whole mesh, so corners the file gave none were only previewed with
+	// their face normal. The model is made from readObjCached instead, which generates them and
+	// writes the cache, so it looks the same as on the next launch. A file the streaming reader
+	// can't take (such as one over the memory ceiling) goes the same way.
+	bool normalsMissing = outData.normals.size() != outData.vertices.size();
+	for(size_t corner = 0; corner < outData.normals.size() && !normalsMissing; corner++){
+		normalsMissing = outData.normals[corner] == glm::vec3(0.0f);
+	}
+	if((!read || normalsMissing) && !cancelled){
+		if(!objReader.readObjCached(name, indexed, true) || !objReader.indexedToSeparateTriangles(indexed, outData)){
+			std::cout << "Failed to read object " << name << "\n";
+			return false;
+		}
+		printCachedLoadStats(std::cout, objReader.getCachedLoadStats());
+		return true;
+	}
+	outNeedsCache = true;
+	return true;
+}
+
+// Convert corners [firstCorner, endCorner) to the ProgressiveMesh vertex format and queue them
+void AsyncModelLoader::queueTriangles(const ObjData& separateTriangles, size_t firstCorner, size_t endCorner){
+	const bool hasNormals = separateTriangles.normals.size() == separateTriangles.vertices.size();
+	const bool octahedral = layout == VertexLayout::Type::QUANTIZED;
+	std::vector<float> vertices((endCorner - firstCorner) * ProgressiveMesh::floatsPerVertex);
+	float* out = vertices.data();
+	for(size_t corner = firstCorner; corner < endCorner; corner++){
+		const glm::vec3& position = separateTriangles.vertices[corner];
+		glm::vec3 normal = hasNormals ? separateTriangles.normals[corner] : glm::vec3(0.0f);
+		if(normal == glm::vec3(0.0f)){
+			size_t first = corner - corner % 3;
+			const std::vector<glm::vec3>& positions = separateTriangles.vertices;
+			glm::vec3 face = glm::cross(positions[first + 1] - positions[first], positions[first + 2] - positions[first]);
+			normal = glm::dot(face, face) > 0.0f ? glm::normalize(face) : face;
+		}
+		if(octahedral && glm::dot(normal, normal) > 0.0f){
+			normal = glm::vec3(octahedralEncode(glm::normalize(normal)), 0.0f);
+		}
+		*out++ = position.x;
+		*out++ = position.y;
+		*out++ = position.z;
+		*out++ = normal.x;
+		*out++ = normal.y;
+		*out++ = normal.z;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	batches.push_back(std::move(vertices));
+}
+
+bool AsyncModelLoader::update(RenderModel& outModel, size_t budgetBytes){
+	if(done){
+		return false;
+	}
+	TraceScope trace("AsyncModelLoader::update");
+
+	// Take what fits in the budget under the lock, upload outside it
+	std::vector<std::vector<float>> uploads;
+	std::unique_ptr<PreparedModel> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t bytes = 0;
+		while(!batches.empty() && (uploads.empty() || bytes + batches.front().size() * sizeof(float) <= budgetBytes)){
+			bytes += batches.front().size() * sizeof(float);
+			uploads.push_back(std::move(batches.front()));
+			batches.pop_front();
+		}
+		// The prepared model holds every triangle, so the rest of the queue is no longer needed
+		if(prepared){
+			ready = std::move(prepared);
+			batches.clear();
+		}
+	}
+
+	if(ready){
+		uploadRenderModel(*ready, outModel);
+		progressiveMesh.reset();
+		done = true;
+		return true;
+	}
+	for(const std::vector<float>& vertices : uploads){
+		if(!progressiveMesh){
+			progressiveMesh.reset(new ProgressiveMesh());
+		}
+		progressiveMesh->append(vertices);
+	}
+	return false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "Renderer.h"
+
+// Separate triangles of a model as they arrive, appended to one growing vertex buffer and drawn
+// with glDrawArrays over what has been uploaded so far. Vertices are a float position and normal;
+// for the QUANTIZED layout the normal is octahedral encoded (z = 0), so the same shader decodes it.
+// Requires a current GL context.
+class ProgressiveMesh {
+	public:
+		static const size_t floatsPerVertex = 6;
+
+		ProgressiveMesh(size_t initialVertices = 1 << 16);
+		~ProgressiveMesh();
+
+		ProgressiveMesh(const ProgressiveMesh&) = delete;
+		ProgressiveMesh& operator=(const ProgressiveMesh&) = delete;
+
+		// Written through an unsynchronized mapping of the unused tail, which no draw reads yet.
+		// A full buffer is doubled and its contents copied on the GPU.
+		void append(const std::vector<float>& vertices);
+		void draw();
+
+		size_t getVertexCount() { return vertexCount; }
+
+	private:
+		unsigned int VAO;
+		unsigned int VBO;
+		size_t capacity;
+		size_t vertexCount;
+
+		void allocate(size_t newCapacity);
+};
+
+// Loads a model on a background thread. Triangles are queued as the file is parsed, and update()
+// on the render thread uploads them to a ProgressiveMesh within a byte budget per frame, so
+// frames keep drawing whatever has arrived. After the last triangle the thread prepares the
+// RenderModel (prepareRenderModel), which update() uploads in place of the progressive mesh.
+// A fresh mesh cache is read whole and queued in slices; otherwise the file is streamed
+// (readObjStreaming) and parsed once more after the model is ready, to write the cache.
+class AsyncModelLoader {
+	public:
+		// modelName as for ObjReader::readObjCached
+		AsyncModelLoader(const std::string& modelName, VertexLayout::Type layout, bool buildLods);
+		// Skips the stages not started yet and waits for the thread
+		~AsyncModelLoader();
+
+		AsyncModelLoader(const AsyncModelLoader&) = delete;
+		AsyncModelLoader& operator=(const AsyncModelLoader&) = delete;
+
+		// Render thread: upload queued triangles until budgetBytes is used up (at least one batch),
+		// and the prepared model once it is ready. Returns true on the call that filled outModel.
+		bool update(RenderModel& outModel, size_t budgetBytes);
+
+		bool isLoading() { return !done && !errorFlag; }
+		bool wasError() { return errorFlag; }
+		// Null until the first triangles are uploaded and after the model has replaced it
+		ProgressiveMesh* getProgressiveMesh() { return progressiveMesh.get(); }
+
+	private:
+		std::string modelName;
+		VertexLayout::Type layout;
+		bool buildLods;
+
+		std::mutex mutex;
+		std::deque<std::vector<float>> batches;
+		std::unique_ptr<PreparedModel> prepared;
+		std::atomic<bool> errorFlag;
+		std::atomic<bool> cancelled;
+		bool done;
+
+		std::unique_ptr<ProgressiveMesh> progressiveMesh;
+		std::thread thread;
+
+		void run();
+		bool loadSeparateTriangles(const std::string& name, ObjData& outData, bool& outNeedsCache);
+		void queueTriangles(const ObjData& separateTriangles, size_t firstCorner, size_t endCorner);
+};
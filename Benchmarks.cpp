@@ -0,0 +1,1105 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <fstream>
+#include <iomanip>
+#include <atomic>
+#include <cstdlib>
+#include <memory_resource>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "Benchmarks.h"
+#include "ObjReader.h"
+#include "Parallel.h"
+#include "MeshCache.h"
+#include "Hash.h"
+#include "VertexLayout.h"
+#include "MeshOptimizer.h"
+#include "MeshClusters.h"
+#include "AssetManager.h"
+#include "NormalGenerator.h"
+#include "RecyclingResource.h"
+
+namespace {
+	// Counts the allocations the code under test makes through it, for the benchmarks that check
+	// a parse doesn't allocate per face. Thread safe, as the parallel parser allocates from workers.
+	class CountingResource : public std::pmr::memory_resource {
+		public:
+			CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+				: upstream(upstream), allocations(0) {
+			}
+
+			size_t getAllocations() { return allocations; }
+			void reset() { allocations = 0; }
+
+		private:
+			std::pmr::memory_resource* upstream;
+			std::atomic<size_t> allocations;
+
+			void* do_allocate(size_t bytes, size_t alignment) override {
+				allocations.fetch_add(1, std::memory_order_relaxed);
+				return upstream->allocate(bytes, alignment);
+			}
+
+			void do_deallocate(void* block, size_t bytes, size_t alignment) override {
+				upstream->deallocate(block, bytes, alignment);
+			}
+
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+				return this == &other;
+			}
+	};
+
+	// Peak resident set size of the process so far
+	size_t peakResidentBytes(){
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return usage.ru_maxrss;
+#else
+		return usage.ru_maxrss * 1024;
+#endif
+#endif
+	}
+
+	template <typename T>
+	bool sameArray(const std::vector<T>& a, const std::vector<T>& b){
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	double secondsSince(std::chrono::high_resolution_clock::time_point start){
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+bool sameObjData(const ObjData& a, const ObjData& b){
+	return sameArray(a.vertices, b.vertices)
+		&& sameArray(a.uvs, b.uvs)
+		&& sameArray(a.normals, b.normals)
+		&& sameArray(a.verticesPerFaceCounts, b.verticesPerFaceCounts)
+		&& sameArray(a.vertexIndices, b.vertexIndices)
+		&& sameArray(a.uvIndices, b.uvIndices)
+		&& sameArray(a.normalIndices, b.normalIndices);
+}
+
+// Load the same file with the stream and mapped parsers, compare results and report the speedup
+bool benchmarkObjParsers(const std::string& objName){
+	ObjReader objReader;
+
+	ObjData streamData;
+	auto start = std::chrono::high_resolution_clock::now();
+	if(!objReader.readObjAsIndexed(objName, streamData, true, ObjReader::Parser::STREAM)){
+		return false;
+	}
+	double streamSeconds = secondsSince(start);
+
+	ObjData mappedData;
+	start = std::chrono::high_resolution_clock::now();
+	if(!objReader.readObjAsIndexed(objName, mappedData, true, ObjReader::Parser::MAPPED)){
+		return false;
+	}
+	double mappedSeconds = secondsSince(start);
+
+	bool identical = sameObjData(streamData, mappedData);
+	std::cout << "Parsed " << objName << ": " << mappedData.vertices.size() << " vertices, "
+		<< mappedData.verticesPerFaceCounts.size() << " faces\n";
+	std::cout << "  stream: " << streamSeconds * 1000.0 << " ms\n";
+	std::cout << "  mapped: " << mappedSeconds * 1000.0 << " ms (" << streamSeconds / mappedSeconds << "x)\n";
+	std::cout << "  output " << (identical ? "identical" : "DIFFERS") << std::endl;
+	return identical;
+}
+
+// Load with the serial mapped parser, then with the parallel parser at 1, 2, 4 ... maxThreads workers.
+// Every parallel result must be bit-identical to the serial one.
+bool benchmarkParallelLoad(const std::string& objName, unsigned int maxThreads){
+	maxThreads = resolveThreadCount(maxThreads);
+	ObjReader objReader;
+
+	ObjData serialData;
+	auto start = std::chrono::high_resolution_clock::now();
+	if(!objReader.readObjAsIndexed(objName, serialData, true, ObjReader::Parser::MAPPED)){
+		return false;
+	}
+	double serialSeconds = secondsSince(start);
+	std::cout << "Parsed " << objName << ": " << serialData.vertices.size() << " vertices, "
+		<< serialData.verticesPerFaceCounts.size() << " faces\n";
+	std::cout << "  serial:     " << serialSeconds * 1000.0 << " ms\n";
+
+	bool allIdentical = true;
+	for(unsigned int threads = 1; threads <= maxThreads; threads = (threads == maxThreads) ? threads + 1 : std::min(threads * 2, maxThreads)){
+		objReader.setThreadCount(threads);
+		ObjData parallelData;
+		start = std::chrono::high_resolution_clock::now();
+		objReader.readObjAsIndexed(objName, parallelData, true, ObjReader::Parser::PARALLEL);
+		double parallelSeconds = secondsSince(start);
+
+		bool identical = sameObjData(serialData, parallelData);
+		allIdentical = allIdentical && identical;
+		std::cout << "  " << threads << " threads: " << parallelSeconds * 1000.0 << " ms ("
+			<< serialSeconds / parallelSeconds << "x)" << (identical ? "" : " DIFFERS") << "\n";
+	}
+	std::cout << "  output " << (allIdentical ? "identical" : "DIFFERS") << std::endl;
+	return allIdentical;
+}
+
+// Cold text parse (which writes the sidecar) against a warm load from the sidecar. The sidecar
+// gets what readObjCached stores, normals generated and triangles reordered, so the viewer's next
+// launch still takes it.
+bool benchmarkMeshCache(const std::string& objName){
+	ObjReader objReader;
+	MeshCache cache("../data/objects/" + objName + ".obj");
+	if(cache.wasError()){
+		std::cout << "Cannot read " << objName << std::endl;
+		return false;
+	}
+
+	ObjData textData;
+	auto start = std::chrono::high_resolution_clock::now();
+	if(!objReader.readObjAsIndexed(objName, textData, true)){
+		return false;
+	}
+	double parseSeconds = secondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	NormalOptions normalOptions;
+	objReader.generateMissingNormals(textData, normalOptions);
+	objReader.optimizeTriangleOrder(textData);
+	double processSeconds = secondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	if(!cache.store(textData, true, true)){
+		return false;
+	}
+	double storeSeconds = secondsSince(start);
+
+	ObjData cachedData;
+	start = std::chrono::high_resolution_clock::now();
+	if(!cache.load(cachedData, true, true)){
+		std::cout << "Cache was not accepted" << std::endl;
+		return false;
+	}
+	double loadSeconds = secondsSince(start);
+
+	bool identical = sameObjData(textData, cachedData);
+	double megabytes = objDataBytes(cachedData) / (1024.0 * 1024.0);
+	std::cout << "Cached " << objName << ": " << megabytes << " MB in " << cache.getCachePath() << "\n";
+	std::cout << "  text parse: " << parseSeconds * 1000.0 << " ms, normals and triangle order: " << processSeconds * 1000.0 << " ms\n";
+	std::cout << "  cache write: " << storeSeconds * 1000.0 << " ms\n";
+	std::cout << "  cache load: " << loadSeconds * 1000.0 << " ms (" << (parseSeconds + processSeconds) / loadSeconds << "x, "
+		<< megabytes / loadSeconds << " MB/s)\n";
+	std::cout << "  output " << (identical ? "identical" : "DIFFERS") << std::endl;
+	return identical;
+}
+
+// Weld the separate triangles of a model and report the vertex and memory reduction
+bool benchmarkWeld(const std::string& objName){
+	ObjReader objReader;
+	ObjData objData;
+	if(!objReader.readObjCached(objName, objData, true)){
+		return false;
+	}
+	ObjData separateData;
+	if(!objReader.indexedToSeparateTriangles(objData, separateData)){
+		return false;
+	}
+
+	ObjData weldedData;
+	auto start = std::chrono::high_resolution_clock::now();
+	objReader.separateTrianglesToIndexed(separateData, weldedData);
+	double weldSeconds = secondsSince(start);
+
+	// Every corner must still see exactly the attributes it had before welding
+	bool identical = weldedData.vertexIndices.size() == separateData.vertices.size();
+	for(size_t corner = 0; identical && corner < separateData.vertices.size(); corner++){
+		unsigned int vertex = weldedData.vertexIndices[corner];
+		identical = memcmp(&weldedData.vertices[vertex], &separateData.vertices[corner], sizeof(glm::vec3)) == 0
+			&& (weldedData.normals.empty() || memcmp(&weldedData.normals[vertex], &separateData.normals[corner], sizeof(glm::vec3)) == 0);
+	}
+
+	size_t indexSize = weldedData.vertices.size() <= 0xFFFF ? sizeof(unsigned short) : sizeof(unsigned int);
+	size_t separateBytes = objDataBytes(separateData);
+	size_t weldedBytes = objDataBytes(weldedData) - weldedData.vertexIndices.size() * sizeof(unsigned int) + weldedData.vertexIndices.size() * indexSize;
+	std::cout << "Welded " << objName << " in " << weldSeconds * 1000.0 << " ms\n";
+	std::cout << "  vertices: " << separateData.vertices.size() << " -> " << weldedData.vertices.size()
+		<< " (" << (double)separateData.vertices.size() / std::max<size_t>(weldedData.vertices.size(), 1) << "x fewer)\n";
+	std::cout << "  memory: " << separateBytes / 1024 << " KB -> " << weldedBytes / 1024 << " KB with "
+		<< indexSize * 8 << " bit indices (saved " << ((double)separateBytes - weldedBytes) / 1024 << " KB)\n";
+	std::cout << "  corners " << (identical ? "preserved" : "DIFFER") << std::endl;
+	return identical;
+}
+
+// Stream a model under a memory ceiling and check the tracked peak stays below it. The streamed
+// triangles are hashed and compared against the in-memory pipeline, which runs afterwards so it
+// doesn't show up in the peak resident size measured for the streaming pass.
+bool benchmarkStreaming(const std::string& objName, size_t memoryCeiling){
+	ObjReader objReader;
+	uint64_t streamedHash = fnv1a64(nullptr, 0);
+	uint64_t streamedNormalHash = fnv1a64(nullptr, 0);
+	size_t streamedBytes = 0;
+	ObjReader::StreamStats stats;
+
+	size_t residentBefore = peakResidentBytes();
+	auto start = std::chrono::high_resolution_clock::now();
+	bool streamed = objReader.readObjStreaming(objName, memoryCeiling, [&](const ObjData& batch){
+		streamedHash = fnv1a64(batch.vertices.data(), batch.vertices.size() * sizeof(glm::vec3), streamedHash);
+		streamedNormalHash = fnv1a64(batch.normals.data(), batch.normals.size() * sizeof(glm::vec3), streamedNormalHash);
+		streamedBytes += objDataBytes(batch);
+		return true;
+	}, stats);
+	double streamSeconds = secondsSince(start);
+	size_t residentAfter = peakResidentBytes();
+	if(!streamed){
+		return false;
+	}
+
+	std::error_code error;
+	size_t fileBytes = std::filesystem::file_size("../data/objects/" + objName + ".obj", error);
+	bool underCeiling = stats.peakBytes <= memoryCeiling;
+	std::cout << "Streamed " << objName << " (" << fileBytes / 1024 << " KB) in " << streamSeconds * 1000.0 << " ms\n";
+	std::cout << "  " << stats.triangles << " triangles in " << stats.batches << " batches, " << streamedBytes / 1024 << " KB emitted\n";
+	std::cout << "  ceiling: " << memoryCeiling / 1024 << " KB, tracked peak: " << stats.peakBytes / 1024 << " KB "
+		<< (underCeiling ? "(under)" : "(OVER)") << "\n";
+	std::cout << "  peak RSS: " << residentBefore / 1024 << " KB before, " << residentAfter / 1024 << " KB after streaming\n";
+	if(fileBytes <= memoryCeiling){
+		std::cout << "  note: the file fits in the ceiling, use a larger model to exercise the bound\n";
+	}
+
+	// Same triangles through the in-memory path
+	ObjData objData;
+	ObjData separateData;
+	if(!objReader.readObjAsIndexed(objName, objData, true) || !objReader.indexedToSeparateTriangles(objData, separateData)){
+		return false;
+	}
+	uint64_t fullHash = fnv1a64(separateData.vertices.data(), separateData.vertices.size() * sizeof(glm::vec3));
+	uint64_t fullNormalHash = fnv1a64(separateData.normals.data(), separateData.normals.size() * sizeof(glm::vec3));
+
+	bool identical = fullHash == streamedHash && fullNormalHash == streamedNormalHash;
+	std::cout << "  output " << (identical ? "identical" : "DIFFERS") << " to the in-memory loader" << std::endl;
+	return identical && underCeiling;
+}
+
+// CPU cost of building each vertex layout from the welded mesh, the bytes it uploads and the
+// precision it loses against the float source
+bool benchmarkVertexLayouts(const std::string& objName){
+	ObjReader objReader;
+	ObjData objData;
+	if(!objReader.readObjCached(objName, objData, true)){
+		return false;
+	}
+	ObjData separateData;
+	ObjData weldedData;
+	if(!objReader.indexedToSeparateTriangles(objData, separateData)){
+		return false;
+	}
+	objReader.separateTrianglesToIndexed(separateData, weldedData);
+
+	const int repeats = 5;
+	const VertexLayout::Type layouts[] = { VertexLayout::Type::SEPARATE, VertexLayout::Type::INTERLEAVED, VertexLayout::Type::PACKED, VertexLayout::Type::QUANTIZED };
+	std::cout << "Vertex layouts for " << objName << " (" << weldedData.vertices.size() << " vertices)\n";
+	for(VertexLayout::Type layout : layouts){
+		VertexBufferData vertexData;
+		auto start = std::chrono::high_resolution_clock::now();
+		for(int i = 0; i < repeats; i++){
+			buildVertexBuffers(weldedData, layout, vertexData);
+		}
+		double buildSeconds = secondsSince(start) / repeats;
+
+		size_t bytes = vertexData.bytes();
+		std::cout << "  " << VertexLayout::name(layout) << ": " << buildSeconds * 1000.0 << " ms to build, "
+			<< bytes / 1024 << " KB in " << vertexData.buffers.size() << " buffer(s), "
+			<< (vertexData.vertexCount > 0 ? bytes / vertexData.vertexCount : 0) << " bytes/vertex\n";
+
+		QuantizationReport report = measureQuantizationError(weldedData, vertexData);
+		std::cout << "    max error: position " << report.maxPositionError << " (" << report.maxPositionErrorRelative * 100.0f
+			<< "% of diagonal), normal " << report.maxNormalErrorDegrees << " degrees, uv " << report.maxUvError << "\n";
+	}
+	std::cout.flush();
+	return true;
+}
+
+namespace {
+	// scaleToClipCoords as it was before the SIMD kernels, kept as the reference
+	void scaleToClipCoordsReference(ObjData& data){
+		if(data.vertices.size() == 0){
+			return;
+		}
+
+		float maxDistance = glm::length(data.vertices[0]);
+		for(glm::vec3& vert : data.vertices){
+			float distance = glm::length(vert);
+			if(distance > maxDistance){
+				maxDistance = distance;
+			}
+		}
+
+		glm::mat4 ortho = glm::ortho(-maxDistance, maxDistance, -maxDistance, maxDistance, -maxDistance, maxDistance);
+		for(glm::vec3& vert : data.vertices){
+			vert = ortho * glm::vec4(vert, 1);
+		}
+	}
+}
+
+// scaleToClipCoords on random vertices: matrix reference against the SIMD kernels, single threaded and with threadCount workers
+bool benchmarkScaleToClipCoords(size_t vertexCount, unsigned int threadCount){
+	ObjData source;
+	source.vertices.resize(vertexCount);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+	for(glm::vec3& vertex : source.vertices){
+		vertex = glm::vec3(distribution(random), distribution(random), distribution(random));
+	}
+
+	ObjData reference = source;
+	auto start = std::chrono::high_resolution_clock::now();
+	scaleToClipCoordsReference(reference);
+	double referenceSeconds = secondsSince(start);
+
+	ObjReader objReader;
+	objReader.setThreadCount(1);
+	ObjData serial = source;
+	start = std::chrono::high_resolution_clock::now();
+	objReader.scaleToClipCoords(serial);
+	double serialSeconds = secondsSince(start);
+
+	objReader.setThreadCount(threadCount);
+	ObjData parallel = source;
+	start = std::chrono::high_resolution_clock::now();
+	objReader.scaleToClipCoords(parallel);
+	double parallelSeconds = secondsSince(start);
+
+	bool identical = sameObjData(reference, serial) && sameObjData(reference, parallel);
+	std::cout << "scaleToClipCoords on " << vertexCount << " vertices\n";
+	std::cout << "  matrix reference: " << referenceSeconds * 1000.0 << " ms\n";
+	std::cout << "  simd, 1 thread: " << serialSeconds * 1000.0 << " ms (" << referenceSeconds / serialSeconds << "x)\n";
+	std::cout << "  simd, " << resolveThreadCount(threadCount) << " threads: " << parallelSeconds * 1000.0 << " ms ("
+		<< referenceSeconds / parallelSeconds << "x)\n";
+	std::cout << "  output " << (identical ? "identical" : "DIFFERS") << std::endl;
+	return identical;
+}
+
+namespace {
+	// indexedToSeparateTriangles as it was before the parallel gather (push_back per corner, no uvs), kept as the reference
+	bool indexedToSeparateTrianglesReference(const ObjData& inData, ObjData& outData){
+		for(size_t i = 0; i < inData.vertexIndices.size(); i++){
+			unsigned int vertexIndex = inData.vertexIndices[i];
+			const glm::vec3& vert = inData.vertices[vertexIndex];
+			outData.vertices.push_back(vert);
+		}
+
+		for (size_t i = 0; i < inData.normalIndices.size(); i++) {
+			try {
+				unsigned int normalIndex = inData.normalIndices.at(i);
+				const glm::vec3& normal = inData.normals.at(normalIndex);
+				outData.normals.push_back(normal);
+			}
+			catch(...) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// Old serial expansion against the validated parallel gather, single threaded and with threadCount workers
+bool benchmarkSeparateTriangles(const std::string& objName, unsigned int threadCount){
+	ObjReader objReader;
+	ObjData objData;
+	if(!objReader.readObjAsIndexed(objName, objData, true)){
+		return false;
+	}
+
+	const int repeats = 3;
+	ObjData reference;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < repeats; i++){
+		reference = ObjData();
+		if(!indexedToSeparateTrianglesReference(objData, reference)){
+			std::cout << "The reference implementation needs a normal on every corner, " << objName << " has faces without" << std::endl;
+			return false;
+		}
+	}
+	double referenceSeconds = secondsSince(start) / repeats;
+
+	objReader.setThreadCount(1);
+	ObjData serial;
+	start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < repeats; i++){
+		serial = ObjData();
+		if(!objReader.indexedToSeparateTriangles(objData, serial)){
+			return false;
+		}
+	}
+	double serialSeconds = secondsSince(start) / repeats;
+
+	objReader.setThreadCount(threadCount);
+	ObjData parallel;
+	start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < repeats; i++){
+		parallel = ObjData();
+		if(!objReader.indexedToSeparateTriangles(objData, parallel)){
+			return false;
+		}
+	}
+	double parallelSeconds = secondsSince(start) / repeats;
+
+	// The reference never gathered uvs
+	serial.uvs.clear();
+	parallel.uvs.clear();
+	bool identical = sameObjData(reference, serial) && sameObjData(reference, parallel);
+
+	// An out of range index has to be reported instead of terminating the process. A model
+	// without faces has no index to corrupt.
+	bool rejectsInvalid = true;
+	if(!objData.vertexIndices.empty()){
+		ObjData corrupt = objData;
+		corrupt.vertexIndices[corrupt.vertexIndices.size() / 2] = corrupt.vertices.size();
+		ObjData rejected;
+		rejectsInvalid = !objReader.indexedToSeparateTriangles(corrupt, rejected);
+	}
+
+	std::cout << "indexedToSeparateTriangles on " << objData.vertexIndices.size() / 3 << " triangles\n";
+	std::cout << "  reference: " << referenceSeconds * 1000.0 << " ms\n";
+	std::cout << "  1 thread: " << serialSeconds * 1000.0 << " ms (" << referenceSeconds / serialSeconds << "x)\n";
+	std::cout << "  " << resolveThreadCount(threadCount) << " threads: " << parallelSeconds * 1000.0 << " ms ("
+		<< referenceSeconds / parallelSeconds << "x)\n";
+	std::cout << "  output " << (identical ? "identical" : "DIFFERS") << ", invalid index "
+		<< (objData.vertexIndices.empty() ? "not checked (no faces)" : rejectsInvalid ? "rejected" : "NOT REJECTED") << std::endl;
+	return identical && rejectsInvalid;
+}
+
+namespace {
+	// Counter clockwise outlines used by benchmarkPolygonTriangulation, convex ones first
+	std::vector<std::vector<glm::vec2>> testPolygons(){
+		std::vector<std::vector<glm::vec2>> polygons;
+		for(int sides : {5, 6, 8}){
+			std::vector<glm::vec2> polygon;
+			for(int i = 0; i < sides; i++){
+				float angle = 6.2831853f * i / sides;
+				polygon.push_back(glm::vec2(cos(angle), sin(angle)));
+			}
+			polygons.push_back(polygon);
+		}
+		polygons.push_back({{0, 0}, {2, 0}, {2, 1}, {1, 1}, {1, 2}, {0, 2}});
+		polygons.push_back({{0, 0}, {3, 0}, {3, 2}, {2, 2}, {2, 1}, {1, 1}, {1, 2}, {0, 2}});
+		std::vector<glm::vec2> star;
+		for(int i = 0; i < 10; i++){
+			float angle = 6.2831853f * i / 10;
+			float radius = i % 2 == 0 ? 1.0f : 0.4f;
+			star.push_back(glm::vec2(radius * cos(angle), radius * sin(angle)));
+		}
+		polygons.push_back(star);
+		return polygons;
+	}
+
+	float signedArea(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c){
+		return 0.5f * ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+	}
+
+	bool insidePolygon(const glm::vec2& point, const std::vector<glm::vec2>& polygon){
+		bool inside = false;
+		for(size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++){
+			const glm::vec2& a = polygon[i];
+			const glm::vec2& b = polygon[j];
+			if((a.y > point.y) != (b.y > point.y) && point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x){
+				inside = !inside;
+			}
+		}
+		return inside;
+	}
+}
+
+// Writes copies of convex and concave 5 to 10 corner polygons on a tilted plane, half of them
+// with faces at the end of the file (absolute indices, so parallel chunks don't hold their
+// positions) and half inline with negative indices. Checks every polygon becomes n - 2 triangles
+// with the face's winding that tile it exactly, that the serial and parallel parsers agree, and
+// counts the allocations the parser makes for its temporaries.
+bool benchmarkPolygonTriangulation(unsigned int copies){
+	const std::string objName = "bench_polygons";
+	const std::string path = "../data/objects/" + objName + ".obj";
+	const std::vector<std::vector<glm::vec2>> shapes = testPolygons();
+	const glm::mat3 tilt = glm::mat3(glm::rotate(glm::mat4(1.0f), 0.7f, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f))));
+
+	// Shape of every face in file order
+	std::vector<size_t> expected;
+	{
+		std::ofstream out(path);
+		if(!out.is_open()){
+			std::cerr << "Error: Cannot write " << path << std::endl;
+			return false;
+		}
+		out << std::setprecision(9);
+		std::vector<size_t> deferred;
+		std::vector<size_t> deferredStarts;
+		size_t vertexCount = 0;
+		for(unsigned int copy = 0; copy < copies; copy++){
+			for(size_t shape = 0; shape < shapes.size(); shape++){
+				const std::vector<glm::vec2>& outline = shapes[shape];
+				glm::vec2 offset(4.0f * (copy % 1000), 4.0f * (shape + shapes.size() * (copy / 1000)));
+				for(const glm::vec2& corner : outline){
+					glm::vec3 position = tilt * glm::vec3(corner + offset, 0.0f);
+					out << "v " << position.x << " " << position.y << " " << position.z << "\n";
+				}
+				if(copy % 2 == 0){
+					deferred.push_back(shape);
+					deferredStarts.push_back(vertexCount + 1);
+				} else {
+					out << "f";
+					for(size_t i = 0; i < outline.size(); i++){
+						out << " " << (long)i - (long)outline.size();
+					}
+					out << "\n";
+					expected.push_back(shape);
+				}
+				vertexCount += outline.size();
+			}
+		}
+		for(size_t i = 0; i < deferred.size(); i++){
+			out << "f";
+			for(size_t corner = 0; corner < shapes[deferred[i]].size(); corner++){
+				out << " " << deferredStarts[i] + corner;
+			}
+			out << "\n";
+			expected.push_back(deferred[i]);
+		}
+	}
+
+	ObjReader objReader;
+	CountingResource counting;
+	objReader.setMemoryResource(&counting);
+	ObjData mappedData;
+	auto start = std::chrono::high_resolution_clock::now();
+	bool read = objReader.readObjAsIndexed(objName, mappedData, true, ObjReader::Parser::MAPPED);
+	double mappedSeconds = secondsSince(start);
+	size_t mappedAllocations = counting.getAllocations();
+
+	// At least 4 chunks, so deferred polygons reference positions in other chunks
+	ObjData parallelData;
+	objReader.setThreadCount(std::max(4u, resolveThreadCount(0)));
+	read = read && objReader.readObjAsIndexed(objName, parallelData, true, ObjReader::Parser::PARALLEL);
+	std::filesystem::remove(path);
+	if(!read){
+		return false;
+	}
+
+	// Untilted corner of its shape for every vertex, to measure the triangles exactly
+	std::vector<glm::vec2> planar;
+	for(unsigned int copy = 0; copy < copies; copy++){
+		for(size_t shape = 0; shape < shapes.size(); shape++){
+			planar.insert(planar.end(), shapes[shape].begin(), shapes[shape].end());
+		}
+	}
+
+	size_t faceCount = expected.size();
+	size_t triangle = 0;
+	size_t badPolygons = 0;
+	bool valid = planar.size() == mappedData.vertices.size();
+	for(size_t face = 0; valid && face < faceCount; face++){
+		const std::vector<glm::vec2>& outline = shapes[expected[face]];
+		size_t triangleCount = outline.size() - 2;
+		if(triangle + triangleCount > mappedData.verticesPerFaceCounts.size()){
+			valid = false;
+			break;
+		}
+
+		float polygonArea = 0.0f;
+		for(size_t i = 0; i < outline.size(); i++){
+			polygonArea += 0.5f * (outline[i].x * outline[(i + 1) % outline.size()].y - outline[(i + 1) % outline.size()].x * outline[i].y);
+		}
+		float area = 0.0f;
+		bool good = true;
+		for(size_t i = 0; i < triangleCount; i++, triangle++){
+			const glm::vec2& a = planar[mappedData.vertexIndices[triangle * 3]];
+			const glm::vec2& b = planar[mappedData.vertexIndices[triangle * 3 + 1]];
+			const glm::vec2& c = planar[mappedData.vertexIndices[triangle * 3 + 2]];
+			float triangleArea = signedArea(a, b, c);
+			good = good && triangleArea > 0.0f && insidePolygon((a + b + c) / 3.0f, outline);
+			area += triangleArea;
+		}
+		good = good && fabs(area - polygonArea) < 1e-3f * polygonArea;
+		if(!good){
+			badPolygons++;
+		}
+	}
+	valid = valid && badPolygons == 0 && triangle == mappedData.verticesPerFaceCounts.size();
+	bool identical = sameObjData(mappedData, parallelData);
+	bool allocationFree = mappedAllocations < faceCount / 100 + 256;
+
+	std::cout << "Triangulated " << faceCount << " polygons of 5 to 10 corners into " << triangle << " triangles\n";
+	std::cout << "  mapped parse: " << mappedSeconds * 1000.0 << " ms, " << mappedAllocations << " parser allocations ("
+		<< (double)mappedAllocations / std::max<size_t>(faceCount, 1) << " per face)\n";
+	std::cout << "  triangulation " << (valid ? "valid" : "INVALID") << " (" << badPolygons << " bad polygons), parallel output "
+		<< (identical ? "identical" : "DIFFERS") << std::endl;
+	return valid && identical && allocationFree;
+}
+
+// Optimize the triangle order of a parsed model and report the time and the vertex cache and
+// overdraw metrics before and after, on the parsed indices and on what is uploaded (welded, then
+// clustered for culling). Checks the same triangles come out and that the order is repeatable.
+bool benchmarkTriangleOrder(const std::string& objName){
+	ObjReader objReader;
+	ObjData parsed;
+	if(!objReader.readObjAsIndexed(objName, parsed, true)){
+		return false;
+	}
+
+	ObjData optimized = parsed;
+	auto start = std::chrono::high_resolution_clock::now();
+	objReader.optimizeTriangleOrder(optimized);
+	double optimizeSeconds = secondsSince(start);
+	ObjData measured = parsed;
+	MeshOptimizationStats stats = objReader.optimizeTriangleOrder(measured, true);
+
+	// Every triangle as a hash of its corners' attribute values, in a sorted list
+	auto triangleHashes = [&](const ObjData& data){
+		ObjData separate;
+		objReader.indexedToSeparateTriangles(data, separate);
+		std::vector<uint64_t> hashes(separate.vertices.size() / 3);
+		for(size_t triangle = 0; triangle < hashes.size(); triangle++){
+			uint64_t hash = fnv1a64(&separate.vertices[triangle * 3], 3 * sizeof(glm::vec3));
+			if(!separate.normals.empty()){
+				hash = fnv1a64(&separate.normals[triangle * 3], 3 * sizeof(glm::vec3), hash);
+			}
+			if(!separate.uvs.empty()){
+				hash = fnv1a64(&separate.uvs[triangle * 3], 3 * sizeof(glm::vec2), hash);
+			}
+			hashes[triangle] = hash;
+		}
+		std::sort(hashes.begin(), hashes.end());
+		return hashes;
+	};
+	bool sameTriangles = triangleHashes(parsed) == triangleHashes(optimized);
+	bool repeatable = sameObjData(optimized, measured);
+
+	auto uploadedMetrics = [&](const ObjData& data, VertexCacheStats& outCache, OverdrawStats& outOverdraw){
+		ObjData separate;
+		ObjData welded;
+		objReader.indexedToSeparateTriangles(data, separate);
+		objReader.separateTrianglesToIndexed(separate, welded);
+		MeshClusters clusters;
+		buildMeshClusters(welded.vertices, welded.vertexIndices, clusters);
+		outCache = analyzeVertexCache(welded.vertexIndices, welded.vertices.size());
+		outOverdraw = analyzeOverdraw(welded.vertexIndices, welded.vertices);
+	};
+	VertexCacheStats uploadedCache[2];
+	OverdrawStats uploadedOverdraw[2];
+	uploadedMetrics(parsed, uploadedCache[0], uploadedOverdraw[0]);
+	uploadedMetrics(optimized, uploadedCache[1], uploadedOverdraw[1]);
+
+	std::cout << "Triangle order of " << objName << " (" << parsed.vertexIndices.size() / 3 << " triangles), optimized in "
+		<< optimizeSeconds * 1000.0 << " ms\n";
+	std::cout << "  parsed indices: ACMR " << stats.cacheBefore.acmr << " -> " << stats.cacheAfter.acmr
+		<< ", ATVR " << stats.cacheBefore.atvr << " -> " << stats.cacheAfter.atvr
+		<< ", overdraw " << stats.overdrawBefore.overdraw << " -> " << stats.overdrawAfter.overdraw << "\n";
+	std::cout << "  uploaded (welded, clustered): ACMR " << uploadedCache[0].acmr << " -> " << uploadedCache[1].acmr
+		<< ", ATVR " << uploadedCache[0].atvr << " -> " << uploadedCache[1].atvr
+		<< ", overdraw " << uploadedOverdraw[0].overdraw << " -> " << uploadedOverdraw[1].overdraw << "\n";
+	std::cout << "  triangles " << (sameTriangles ? "preserved" : "DIFFER") << ", order " << (repeatable ? "repeatable" : "DIFFERS") << std::endl;
+	return sameTriangles && repeatable;
+}
+
+namespace {
+	// UV sphere with normals, squashed by stretch so the parts differ in shape as well as size
+	bool writeSpherePart(const std::string& path, unsigned int segments, const glm::vec3& stretch){
+		std::ofstream out(path);
+		if(!out.is_open()){
+			std::cerr << "Error: Cannot write " << path << std::endl;
+			return false;
+		}
+		out << std::setprecision(7);
+		unsigned int rings = segments / 2;
+		for(unsigned int ring = 0; ring <= rings; ring++){
+			float polar = 3.14159265f * ring / rings;
+			for(unsigned int segment = 0; segment <= segments; segment++){
+				float azimuth = 6.28318531f * segment / segments;
+				glm::vec3 normal(std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth));
+				glm::vec3 position = normal * stretch;
+				out << "v " << position.x << " " << position.y << " " << position.z << "\n";
+				out << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+			}
+		}
+		for(unsigned int ring = 0; ring < rings; ring++){
+			for(unsigned int segment = 0; segment < segments; segment++){
+				unsigned int a = ring * (segments + 1) + segment + 1;
+				unsigned int b = a + segments + 1;
+				out << "f " << a << "//" << a << " " << b << "//" << b << " " << b + 1 << "//" << b + 1 << " " << a + 1 << "//" << a + 1 << "\n";
+			}
+		}
+		return out.good();
+	}
+
+	// fileCount parts in directory, one in eight a byte-identical copy of an earlier one under another name
+	bool writeAssetDirectory(const std::string& directory, unsigned int fileCount){
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		std::mt19937 generator(4321);
+		std::uniform_int_distribution<unsigned int> segments(8, 96);
+		std::uniform_real_distribution<float> stretch(0.5f, 2.0f);
+		for(unsigned int i = 0; i < fileCount; i++){
+			char name[32];
+			snprintf(name, sizeof(name), "part%04u.obj", i);
+			std::string path = directory + "/" + name;
+			if(i % 8 == 7){
+				std::uniform_int_distribution<unsigned int> earlier(i - std::min(i, 64u), i - 1);
+				char original[32];
+				snprintf(original, sizeof(original), "part%04u.obj", earlier(generator));
+				std::filesystem::copy_file(directory + "/" + original, path, std::filesystem::copy_options::overwrite_existing, error);
+				if(error){
+					std::cerr << "Error: Cannot write " << path << std::endl;
+					return false;
+				}
+			} else if(!writeSpherePart(path, segments(generator), glm::vec3(stretch(generator), stretch(generator), stretch(generator)))){
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// Every .obj in directory read serially, one readObjFile after another, then as one batch
+// through an AssetManager: cold, warm, and under a budget of a quarter of the parsed data.
+// Writes fileCount generated parts to directory first if it has no .obj files.
+bool benchmarkAssetManager(const std::string& directory, unsigned int fileCount){
+	std::vector<std::string> paths;
+	auto listObjFiles = [&](){
+		paths.clear();
+		std::error_code error;
+		for(const auto& file : std::filesystem::directory_iterator(directory, error)){
+			if(file.path().extension() == ".obj"){
+				paths.push_back(file.path().string());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+	};
+	listObjFiles();
+	if(paths.empty()){
+		std::cout << "Writing " << fileCount << " parts to " << directory << "\n";
+		if(!writeAssetDirectory(directory, fileCount)){
+			return false;
+		}
+		listObjFiles();
+	}
+	size_t fileBytes = 0;
+	for(const std::string& path : paths){
+		std::error_code error;
+		fileBytes += std::filesystem::file_size(path, error);
+	}
+
+	// Serial: what loading a scene of these did before, one parse per file
+	std::vector<ObjData> serial(paths.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for(size_t i = 0; i < paths.size(); i++){
+		ObjReader objReader;
+		if(!objReader.readObjFile(paths[i], serial[i], true)){
+			return false;
+		}
+	}
+	double serialSeconds = secondsSince(start);
+	size_t parsedBytes = 0;
+	for(const ObjData& data : serial){
+		parsedBytes += objDataBytes(data);
+	}
+
+	// Plain parses on both sides, the sidecar cache would turn the manager's into reads
+	AssetManager assets(SIZE_MAX, 0, false);
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<MeshHandle> handles = assets.loadBatch(paths);
+	double coldSeconds = secondsSince(start);
+	AssetManager::Stats cold = assets.getStats();
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<MeshHandle> again = assets.loadBatch(paths);
+	double warmSeconds = secondsSince(start);
+
+	bool same = true;
+	for(size_t i = 0; i < paths.size(); i++){
+		same = same && handles[i] && again[i] == handles[i] && sameObjData(handles[i]->data, serial[i]);
+	}
+
+	// Held handles pin their assets; once released the budget applies
+	AssetManager budgeted(parsedBytes / 4, 0, false);
+	handles = budgeted.loadBatch(paths);
+	handles.clear();
+	budgeted.trim();
+	AssetManager::Stats trimmed = budgeted.getStats();
+	start = std::chrono::high_resolution_clock::now();
+	handles = budgeted.loadBatch(paths);
+	double reloadSeconds = secondsSince(start);
+	AssetManager::Stats reloaded = budgeted.getStats();
+	for(size_t i = 0; i < paths.size(); i++){
+		same = same && handles[i] && sameObjData(handles[i]->data, serial[i]);
+	}
+
+	std::cout << paths.size() << " files in " << directory << ", " << fileBytes / (1024.0 * 1024.0) << " MB of text, "
+		<< parsedBytes / (1024.0 * 1024.0) << " MB parsed, " << resolveThreadCount(0) << " threads\n";
+	std::cout << "  serial:         " << serialSeconds * 1000.0 << " ms\n";
+	std::cout << "  manager, cold:  " << coldSeconds * 1000.0 << " ms (" << serialSeconds / coldSeconds << "x), "
+		<< cold.parsed << " parsed, " << cold.contentHits << " shared by content, " << cold.residentBytes / (1024.0 * 1024.0) << " MB resident\n";
+	std::cout << "  manager, warm:  " << warmSeconds * 1000.0 << " ms, " << assets.getStats().pathHits << " path hits\n";
+	std::cout << "  budget " << budgeted.getMemoryBudget() / (1024.0 * 1024.0) << " MB: " << trimmed.evictions << " evicted, "
+		<< trimmed.residentAssets << " assets / " << trimmed.residentBytes / (1024.0 * 1024.0) << " MB resident; reload "
+		<< reloadSeconds * 1000.0 << " ms, " << reloaded.parsed - trimmed.parsed << " parsed again\n";
+	std::cout << "  data " << (same ? "identical" : "DIFFERS") << std::endl;
+	return same && trimmed.residentBytes <= budgeted.getMemoryBudget();
+}
+
+namespace {
+	// The obvious serial version of generateNormals: a list of corners per vertex built by
+	// push_back, then per corner a sum over that list. Per corner normals only.
+	void referenceNormals(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const NormalOptions& options,
+			std::vector<glm::vec3>& outCornerNormals){
+		const size_t cornerCount = indices.size();
+		std::vector<glm::vec3> units(cornerCount);
+		std::vector<glm::vec3> contributions(cornerCount);
+		for(size_t corner = 0; corner < cornerCount; corner++){
+			size_t first = corner - corner % 3;
+			glm::vec3 cross = glm::cross(positions[indices[first + 1]] - positions[indices[first]], positions[indices[first + 2]] - positions[indices[first]]);
+			float length = glm::length(cross);
+			units[corner] = length > 0.0f ? cross / length : glm::vec3(0.0f);
+			if(options.weighting == NormalOptions::Weighting::AREA){
+				contributions[corner] = cross;
+			} else {
+				glm::vec3 p = positions[indices[corner]];
+				glm::vec3 toNext = positions[indices[first + (corner - first + 1) % 3]] - p;
+				glm::vec3 toPrevious = positions[indices[first + (corner - first + 2) % 3]] - p;
+				float lengths = glm::length(toNext) * glm::length(toPrevious);
+				float cosine = lengths > 0.0f ? std::clamp(glm::dot(toNext, toPrevious) / lengths, -1.0f, 1.0f) : 1.0f;
+				contributions[corner] = units[corner] * std::acos(cosine);
+			}
+		}
+
+		outCornerNormals.assign(cornerCount, glm::vec3(0.0f));
+		if(options.mode == NormalOptions::Mode::FLAT){
+			for(size_t corner = 0; corner < cornerCount; corner++){
+				outCornerNormals[corner] = units[corner - corner % 3];
+			}
+			return;
+		}
+		std::vector<std::vector<size_t>> cornersOfVertex(positions.size());
+		for(size_t corner = 0; corner < cornerCount; corner++){
+			cornersOfVertex[indices[corner]].push_back(corner);
+		}
+		float creaseCosine = std::cos(glm::radians(std::min(options.creaseAngleDegrees, 180.0f)));
+		for(size_t corner = 0; corner < cornerCount; corner++){
+			glm::vec3 sum(0.0);
+			for(size_t other : cornersOfVertex[indices[corner]]){
+				if(options.creaseAngleDegrees >= 180.0f || units[corner] == glm::vec3(0.0f) || glm::dot(units[corner], units[other]) >= creaseCosine){
+					sum += contributions[other];
+				}
+			}
+			float length = glm::length(sum);
+			outCornerNormals[corner] = length > 0.0f ? sum / length : glm::vec3(0.0f);
+		}
+	}
+
+	// Largest angle in degrees between generated and reference corner normals; a zero normal on
+	// one side only counts as 180
+	double maxNormalErrorDegrees(const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& normalIndices, const std::vector<glm::vec3>& reference){
+		double maxError = 0.0;
+		for(size_t corner = 0; corner < reference.size(); corner++){
+			const glm::vec3& normal = normals[normalIndices[corner]];
+			bool zero = normal == glm::vec3(0.0f);
+			bool referenceZero = reference[corner] == glm::vec3(0.0f);
+			double error = 0.0;
+			if(zero != referenceZero){
+				error = 180.0;
+			} else if(!zero){
+				glm::vec3 unit = glm::normalize(normal);
+				error = glm::degrees(std::atan2((double)glm::length(glm::cross(unit, reference[corner])), (double)glm::dot(unit, reference[corner])));
+			}
+			maxError = std::max(maxError, error);
+		}
+		return maxError;
+	}
+
+	// Unit cube with shared corners: split at a crease every corner takes its face's axis,
+	// smoothed every vertex takes its diagonal (three faces at 90 degrees each)
+	bool checkCubeNormals(){
+		std::vector<glm::vec3> positions;
+		for(int i = 0; i < 8; i++){
+			positions.push_back(glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f));
+		}
+		const std::vector<unsigned int> indices = {
+			0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,  0, 1, 5, 0, 5, 4,
+			2, 6, 7, 2, 7, 3,  0, 4, 6, 0, 6, 2,  1, 3, 7, 1, 7, 5 };
+		NormalOptions options;
+		std::vector<glm::vec3> normals;
+		std::vector<unsigned int> normalIndices;
+		bool correct = generateNormals(positions, indices, options, normals, normalIndices) && normals.size() == 24;
+		for(size_t corner = 0; corner < indices.size() && correct; corner++){
+			glm::vec3 face = glm::normalize(glm::cross(positions[indices[corner - corner % 3 + 1]] - positions[indices[corner - corner % 3]],
+				positions[indices[corner - corner % 3 + 2]] - positions[indices[corner - corner % 3]]));
+			correct = glm::length(normals[normalIndices[corner]] - face) < 1e-6f;
+		}
+		options.creaseAngleDegrees = 180.0f;
+		correct = correct && generateNormals(positions, indices, options, normals, normalIndices) && normals.size() == 8;
+		for(size_t corner = 0; corner < indices.size() && correct; corner++){
+			correct = glm::length(normals[normalIndices[corner]] - glm::normalize(positions[indices[corner]])) < 1e-6f;
+		}
+		return correct;
+	}
+}
+
+// generateNormals on a model's positions with its own normals ignored: every mode checked against
+// referenceNormals, and timed at 1, 2, 4 ... maxThreads workers, which must agree bit for bit
+bool benchmarkNormalGeneration(const std::string& objName, unsigned int maxThreads){
+	maxThreads = resolveThreadCount(maxThreads);
+	bool cubeCorrect = checkCubeNormals();
+	std::cout << "Cube normals " << (cubeCorrect ? "correct" : "WRONG") << "\n";
+
+	ObjReader objReader;
+	ObjData objData;
+	if(!objReader.readObjAsIndexed(objName, objData, true)){
+		return false;
+	}
+	const std::vector<glm::vec3>& positions = objData.vertices;
+	const std::vector<unsigned int>& indices = objData.vertexIndices;
+	std::cout << "Normals of " << objName << " (" << indices.size() / 3 << " triangles, " << positions.size() << " vertices)\n";
+
+	class Variant {
+		public:
+			const char* name;
+			NormalOptions::Mode mode;
+			NormalOptions::Weighting weighting;
+			float creaseAngleDegrees;
+	};
+	const Variant variants[] = {
+		{ "smooth, angle weighted, 60 degree crease", NormalOptions::Mode::SMOOTH, NormalOptions::Weighting::ANGLE, 60.0f },
+		{ "smooth, angle weighted, no crease", NormalOptions::Mode::SMOOTH, NormalOptions::Weighting::ANGLE, 180.0f },
+		{ "smooth, area weighted, 60 degree crease", NormalOptions::Mode::SMOOTH, NormalOptions::Weighting::AREA, 60.0f },
+		{ "flat", NormalOptions::Mode::FLAT, NormalOptions::Weighting::ANGLE, 180.0f },
+	};
+	bool allCorrect = cubeCorrect;
+	for(const Variant& variant : variants){
+		NormalOptions options;
+		options.mode = variant.mode;
+		options.weighting = variant.weighting;
+		options.creaseAngleDegrees = variant.creaseAngleDegrees;
+
+		std::vector<glm::vec3> reference;
+		auto start = std::chrono::high_resolution_clock::now();
+		referenceNormals(positions, indices, options, reference);
+		double referenceSeconds = secondsSince(start);
+		std::cout << "  " << variant.name << "\n    reference: " << referenceSeconds * 1000.0 << " ms\n";
+
+		std::vector<glm::vec3> firstNormals;
+		std::vector<unsigned int> firstIndices;
+		for(unsigned int threads = 1; threads <= maxThreads; threads = (threads == maxThreads) ? threads + 1 : std::min(threads * 2, maxThreads)){
+			options.threadCount = threads;
+			std::vector<glm::vec3> normals;
+			std::vector<unsigned int> normalIndices;
+			start = std::chrono::high_resolution_clock::now();
+			bool generated = generateNormals(positions, indices, options, normals, normalIndices);
+			double seconds = secondsSince(start);
+
+			bool identical = true;
+			if(threads == 1){
+				firstNormals = normals;
+				firstIndices = normalIndices;
+			} else {
+				identical = normalIndices == firstIndices && normals.size() == firstNormals.size()
+					&& memcmp(normals.data(), firstNormals.data(), normals.size() * sizeof(glm::vec3)) == 0;
+			}
+			double error = generated ? maxNormalErrorDegrees(normals, normalIndices, reference) : 180.0;
+			bool correct = generated && identical && error < 0.1;
+			allCorrect = allCorrect && correct;
+			std::cout << "    " << threads << " threads: " << seconds * 1000.0 << " ms (" << referenceSeconds / seconds << "x), "
+				<< normals.size() << " normals, max error " << error << " degrees" << (identical ? "" : ", DIFFERS from 1 thread") << "\n";
+		}
+	}
+	std::cout << "  normals " << (allCorrect ? "correct" : "WRONG") << std::endl;
+	return allCorrect;
+}
+
+namespace {
+	// Resident set size of the process now
+	size_t currentResidentBytes(){
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.WorkingSetSize;
+#else
+		std::ifstream statm("/proc/self/statm");
+		size_t pages = 0;
+		size_t residentPages = 0;
+		statm >> pages >> residentPages;
+		return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+}
+
+// The same model loaded loads times with the parser's arenas taken from the heap, then from one
+// RecyclingResource kept across the loads, as a long running viewer would. Prints the time, the
+// heap allocations of the parser's temporaries and the resident set size of every load; every
+// load must give the same ObjData.
+bool benchmarkRepeatedLoads(const std::string& objName, unsigned int loads){
+	ObjData first;
+	bool identical = true;
+	// Between the parser (or the recycling resource) and the heap
+	CountingResource heap;
+	auto run = [&](const char* name, std::pmr::memory_resource* resource){
+		std::cout << "  " << name << ":\n";
+		double totalSeconds = 0.0;
+		size_t totalAllocations = 0;
+		for(unsigned int load = 0; load < loads; load++){
+			ObjReader objReader;
+			objReader.setMemoryResource(resource);
+			ObjData objData;
+			heap.reset();
+			auto start = std::chrono::high_resolution_clock::now();
+			bool read = objReader.readObjAsIndexed(objName, objData, true);
+			double seconds = secondsSince(start);
+			size_t allocations = heap.getAllocations();
+			if(!read){
+				return false;
+			}
+			if(first.vertexIndices.empty()){
+				first = objData;
+			} else {
+				identical = identical && sameObjData(first, objData);
+			}
+			totalSeconds += seconds;
+			totalAllocations += allocations;
+			std::cout << "    load " << load + 1 << ": " << seconds * 1000.0 << " ms, " << allocations << " heap allocations, "
+				<< currentResidentBytes() / (1024 * 1024) << " MB resident\n";
+		}
+		std::cout << "    mean " << totalSeconds * 1000.0 / loads << " ms, " << totalAllocations / loads << " heap allocations per load, "
+			<< peakResidentBytes() / (1024 * 1024) << " MB peak resident so far\n";
+		return true;
+	};
+
+	std::cout << "Loading " << objName << " " << loads << " times\n";
+	if(!run("arenas from the heap", &heap)){
+		return false;
+	}
+	RecyclingResource recycling(1024 * 1024 * 1024, &heap);
+	if(!run("arenas from a recycling resource", &recycling)){
+		return false;
+	}
+	RecyclingResource::Stats stats = recycling.getStats();
+	std::cout << "    " << stats.upstreamAllocations << " blocks from the heap, " << stats.reusedAllocations << " reused, "
+		<< stats.cachedBytes / (1024 * 1024) << " MB kept\n";
+	std::cout << "  data " << (identical ? "identical" : "DIFFERS") << std::endl;
+	return identical;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include "ObjData.h"
+
+// Command line benchmarks, run from main with --bench-<name> <model>.
+// Each prints its timings to stdout and returns false if the compared outputs differ.
+
+bool benchmarkObjParsers(const std::string& objName);
+bool benchmarkParallelLoad(const std::string& objName, unsigned int maxThreads);
+bool benchmarkMeshCache(const std::string& objName);
+bool benchmarkWeld(const std::string& objName);
+bool benchmarkStreaming(const std::string& objName, size_t memoryCeiling);
+bool benchmarkVertexLayouts(const std::string& objName);
+bool benchmarkScaleToClipCoords(size_t vertexCount, unsigned int threadCount);
+bool benchmarkSeparateTriangles(const std::string& objName, unsigned int threadCount);
+bool benchmarkPolygonTriangulation(unsigned int copies);
+bool benchmarkTriangleOrder(const std::string& objName);
+bool benchmarkAssetManager(const std::string& directory, unsigned int fileCount);
+bool benchmarkNormalGeneration(const std::string& objName, unsigned int maxThreads);
+bool benchmarkRepeatedLoads(const std::string& objName, unsigned int loads);
+
+// Bitwise comparison of every array in two ObjData
+bool sameObjData(const ObjData& a, const ObjData& b);
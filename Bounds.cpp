@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BOUNDS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOUNDS_SSE
+#endif
+
+#include "Bounds.h"
+#include "Parallel.h"
+
+namespace {
+	const size_t parallelThreshold = 1 << 20;
+	// Ranges are multiples of 8 vertices so every SIMD block starts on a vertex
+	const size_t vertexBlock = 8;
+
+	class PartialBounds {
+		public:
+			glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+			glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+			float maxSquaredDistance = 0.0f;
+
+			void merge(const PartialBounds& other){
+				min = glm::min(min, other.min);
+				max = glm::max(max, other.max);
+				maxSquaredDistance = std::max(maxSquaredDistance, other.maxSquaredDistance);
+			}
+	};
+
+	void scalarBounds(const float* values, size_t begin, size_t end, PartialBounds& bounds){
+		for(size_t i = begin; i < end; i++){
+			glm::vec3 vertex(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+			bounds.min = glm::min(bounds.min, vertex);
+			bounds.max = glm::max(bounds.max, vertex);
+			bounds.maxSquaredDistance = std::max(bounds.maxSquaredDistance, vertex.x * vertex.x + vertex.y * vertex.y + vertex.z * vertex.z);
+		}
+	}
+
+#if defined(BOUNDS_AVX)
+	// 8 vertices per step. Loading the two halves of each register 12 floats apart puts
+	// vertices 0-3 in the low lanes and 4-7 in the high lanes, so the 128 bit deinterleave
+	// shuffles work unchanged on both halves.
+	size_t simdBounds(const float* values, size_t begin, size_t end, PartialBounds& bounds){
+		__m256 minX = _mm256_set1_ps(bounds.min.x), minY = _mm256_set1_ps(bounds.min.y), minZ = _mm256_set1_ps(bounds.min.z);
+		__m256 maxX = _mm256_set1_ps(bounds.max.x), maxY = _mm256_set1_ps(bounds.max.y), maxZ = _mm256_set1_ps(bounds.max.z);
+		__m256 maxSquared = _mm256_set1_ps(bounds.maxSquaredDistance);
+
+		size_t i = begin;
+		for(; i + 8 <= end; i += 8){
+			const float* p = values + 3 * i;
+			__m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+			__m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+			__m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+
+			__m256 xy = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+			__m256 yz = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+			__m256 x = _mm256_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+			__m256 y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			__m256 z = _mm256_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+
+			minX = _mm256_min_ps(minX, x); minY = _mm256_min_ps(minY, y); minZ = _mm256_min_ps(minZ, z);
+			maxX = _mm256_max_ps(maxX, x); maxY = _mm256_max_ps(maxY, y); maxZ = _mm256_max_ps(maxZ, z);
+			__m256 squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+			maxSquared = _mm256_max_ps(maxSquared, squared);
+		}
+
+		alignas(32) float lanes[7][8];
+		_mm256_store_ps(lanes[0], minX); _mm256_store_ps(lanes[1], minY); _mm256_store_ps(lanes[2], minZ);
+		_mm256_store_ps(lanes[3], maxX); _mm256_store_ps(lanes[4], maxY); _mm256_store_ps(lanes[5], maxZ);
+		_mm256_store_ps(lanes[6], maxSquared);
+		for(int lane = 0; lane < 8; lane++){
+			bounds.min = glm::min(bounds.min, glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]));
+			bounds.max = glm::max(bounds.max, glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]));
+			bounds.maxSquaredDistance = std::max(bounds.maxSquaredDistance, lanes[6][lane]);
+		}
+		return i;
+	}
+
+	// The x,y,z scale pattern repeats every 24 floats = 3 registers
+	size_t simdScale(float* values, size_t begin, size_t end, const glm::vec3& scale){
+		alignas(32) float pattern[24];
+		for(int i = 0; i < 24; i++){
+			pattern[i] = scale[i % 3];
+		}
+		__m256 s0 = _mm256_load_ps(pattern), s1 = _mm256_load_ps(pattern + 8), s2 = _mm256_load_ps(pattern + 16);
+
+		size_t i = begin;
+		for(; i + 8 <= end; i += 8){
+			float* p = values + 3 * i;
+			_mm256_storeu_ps(p, _mm256_mul_ps(_mm256_loadu_ps(p), s0));
+			_mm256_storeu_ps(p + 8, _mm256_mul_ps(_mm256_loadu_ps(p + 8), s1));
+			_mm256_storeu_ps(p + 16, _mm256_mul_ps(_mm256_loadu_ps(p + 16), s2));
+		}
+		return i;
+	}
+#elif defined(BOUNDS_SSE)
+	// 4 vertices per step, transposed from xyz xyz xyz xyz into x/y/z registers
+	size_t simdBounds(const float* values, size_t begin, size_t end, PartialBounds& bounds){
+		__m128 minX = _mm_set1_ps(bounds.min.x), minY = _mm_set1_ps(bounds.min.y), minZ = _mm_set1_ps(bounds.min.z);
+		__m128 maxX = _mm_set1_ps(bounds.max.x), maxY = _mm_set1_ps(bounds.max.y), maxZ = _mm_set1_ps(bounds.max.z);
+		__m128 maxSquared = _mm_set1_ps(bounds.maxSquaredDistance);
+
+		size_t i = begin;
+		for(; i + 4 <= end; i += 4){
+			const float* p = values + 3 * i;
+			__m128 a = _mm_loadu_ps(p);
+			__m128 b = _mm_loadu_ps(p + 4);
+			__m128 c = _mm_loadu_ps(p + 8);
+
+			__m128 xy = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+			__m128 yz = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+			__m128 x = _mm_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+			__m128 y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			__m128 z = _mm_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+
+			minX = _mm_min_ps(minX, x); minY = _mm_min_ps(minY, y); minZ = _mm_min_ps(minZ, z);
+			maxX = _mm_max_ps(maxX, x); maxY = _mm_max_ps(maxY, y); maxZ = _mm_max_ps(maxZ, z);
+			__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+			maxSquared = _mm_max_ps(maxSquared, squared);
+		}
+
+		alignas(16) float lanes[7][4];
+		_mm_store_ps(lanes[0], minX); _mm_store_ps(lanes[1], minY); _mm_store_ps(lanes[2], minZ);
+		_mm_store_ps(lanes[3], maxX); _mm_store_ps(lanes[4], maxY); _mm_store_ps(lanes[5], maxZ);
+		_mm_store_ps(lanes[6], maxSquared);
+		for(int lane = 0; lane < 4; lane++){
+			bounds.min = glm::min(bounds.min, glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]));
+			bounds.max = glm::max(bounds.max, glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]));
+			bounds.maxSquaredDistance = std::max(bounds.maxSquaredDistance, lanes[6][lane]);
+		}
+		return i;
+	}
+
+	// The x,y,z scale pattern repeats every 12 floats = 3 registers
+	size_t simdScale(float* values, size_t begin, size_t end, const glm::vec3& scale){
+		__m128 s0 = _mm_setr_ps(scale.x, scale.y, scale.z, scale.x);
+		__m128 s1 = _mm_setr_ps(scale.y, scale.z, scale.x, scale.y);
+		__m128 s2 = _mm_setr_ps(scale.z, scale.x, scale.y, scale.z);
+
+		size_t i = begin;
+		for(; i + 4 <= end; i += 4){
+			float* p = values + 3 * i;
+			_mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p), s0));
+			_mm_storeu_ps(p + 4, _mm_mul_ps(_mm_loadu_ps(p + 4), s1));
+			_mm_storeu_ps(p + 8, _mm_mul_ps(_mm_loadu_ps(p + 8), s2));
+		}
+		return i;
+	}
+#else
+	size_t simdBounds(const float*, size_t begin, size_t, PartialBounds&){
+		return begin;
+	}
+
+	size_t simdScale(float*, size_t begin, size_t, const glm::vec3&){
+		return begin;
+	}
+#endif
+
+	void rangeBounds(const float* values, size_t begin, size_t end, PartialBounds& bounds){
+		size_t done = simdBounds(values, begin, end, bounds);
+		scalarBounds(values, done, end, bounds);
+	}
+
+	void rangeScale(float* values, size_t begin, size_t end, const glm::vec3& scale){
+		for(size_t i = simdScale(values, begin, end, scale); i < end; i++){
+			values[3 * i] *= scale.x;
+			values[3 * i + 1] *= scale.y;
+			values[3 * i + 2] *= scale.z;
+		}
+	}
+
+	// Split into per-worker ranges on vertexBlock boundaries
+	template <typename Fn>
+	void forEachRange(size_t count, unsigned int threadCount, Fn fn){
+		if(count < parallelThreshold){
+			fn(0, 0, count);
+			return;
+		}
+		size_t rangeCount = resolveThreadCount(threadCount);
+		size_t blocks = (count + vertexBlock - 1) / vertexBlock;
+		parallelFor(rangeCount, threadCount, [&](size_t range){
+			size_t begin = std::min(count, blocks * range / rangeCount * vertexBlock);
+			size_t end = std::min(count, blocks * (range + 1) / rangeCount * vertexBlock);
+			fn(range, begin, end);
+		});
+	}
+}
+
+Bounds computeBounds(const std::vector<glm::vec3>& positions, unsigned int threadCount){
+	Bounds result;
+	if(positions.empty()){
+		return result;
+	}
+
+	static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "positions must be tightly packed floats");
+	const float* values = &positions[0].x;
+	std::vector<PartialBounds> partials(positions.size() < parallelThreshold ? 1 : resolveThreadCount(threadCount));
+	forEachRange(positions.size(), threadCount, [&](size_t range, size_t begin, size_t end){
+		rangeBounds(values, begin, end, partials[range]);
+	});
+
+	PartialBounds total;
+	for(const PartialBounds& partial : partials){
+		total.merge(partial);
+	}
+	result.min = total.min;
+	result.max = total.max;
+	result.maxDistance = std::sqrt(total.maxSquaredDistance);
+	return result;
+}
+
+void scalePositions(std::vector<glm::vec3>& positions, const glm::vec3& scale, unsigned int threadCount){
+	if(positions.empty()){
+		return;
+	}
+
+	float* values = &positions[0].x;
+	forEachRange(positions.size(), threadCount, [&](size_t, size_t begin, size_t end){
+		rangeScale(values, begin, end, scale);
+	});
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis aligned box of a point set plus the radius of the origin centred sphere enclosing it
+class Bounds {
+	public:
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		float maxDistance = 0.0f;
+};
+
+// Both kernels read the positions as a flat float array and deinterleave them in registers
+// (SSE2, or AVX when compiled with it, scalar otherwise). Inputs of more than a million
+// vertices are split across threadCount workers (0 = all hardware threads).
+Bounds computeBounds(const std::vector<glm::vec3>& positions, unsigned int threadCount = 0);
+// Multiply every position by scale component-wise
+void scalePositions(std::vector<glm::vec3>& positions, const glm::vec3& scale, unsigned int threadCount = 0);
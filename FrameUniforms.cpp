@@ -0,0 +1,155 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+
+#include "FrameUniforms.h"
+
+static_assert(sizeof(FrameParameters) == 320, "FrameParameters must match the std140 block");
+
+void FrameParameters::setNormalMatrix(const glm::mat3& matrix){
+	for(int i = 0; i < 3; i++){
+		normalMatrix[i] = glm::vec4(matrix[i], 0.0f);
+	}
+}
+
+glm::mat3 FrameParameters::getNormalMatrix() const {
+	return glm::mat3(glm::vec3(normalMatrix[0]), glm::vec3(normalMatrix[1]), glm::vec3(normalMatrix[2]));
+}
+
+FrameUniforms::FrameUniforms(const ShaderProgram& program, unsigned int bindingPoint) :
+	fields{
+		{ "model", offsetof(FrameParameters, model), -1, false },
+		{ "view", offsetof(FrameParameters, view), -1, false },
+		{ "projection", offsetof(FrameParameters, projection), -1, false },
+		{ "normalMatrix", offsetof(FrameParameters, normalMatrix), -1, false },
+		{ "lightPosition", offsetof(FrameParameters, lightPosition), -1, false },
+		{ "shininess", offsetof(FrameParameters, shininess), -1, false },
+		{ "viewerPosition", offsetof(FrameParameters, viewerPosition), -1, false },
+		{ "showZBuffer", offsetof(FrameParameters, showZBuffer), -1, true },
+		{ "lightColor", offsetof(FrameParameters, lightColor), -1, false },
+		{ "useGouraudShading", offsetof(FrameParameters, useGouraudShading), -1, true },
+		{ "objectColor", offsetof(FrameParameters, objectColor), -1, false },
+		{ "usePhongShading", offsetof(FrameParameters, usePhongShading), -1, true },
+		{ "useFlatShading", offsetof(FrameParameters, useFlatShading), -1, true }
+	} {
+	errorFlag = false;
+	buffer = 0;
+	uploaded = false;
+
+	const ShaderUniformBlock* block = program.findUniformBlock("FrameParameters");
+	if(block != nullptr && blockMatches(program, *block)){
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, block->dataSize, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glUniformBlockBinding(program.getID(), block->index, bindingPoint);
+		glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+		return;
+	}
+	if(block != nullptr){
+		std::cerr << "Warning: FrameParameters block doesn't have the expected std140 layout, using plain uniforms" << std::endl;
+	}
+
+	for(Field& field : fields){
+		field.location = program.getUniformLocation(field.name);
+		if(field.location == -1 && !field.shadingFlag){
+			std::cerr << "Error: Cannot find uniform variable: " << field.name << std::endl;
+			errorFlag = true;
+		}
+	}
+}
+
+FrameUniforms::~FrameUniforms(){
+	if(buffer != 0){
+		glDeleteBuffers(1, &buffer);
+	}
+}
+
+// Every member must be in the block at the offset FrameParameters puts it
+bool FrameUniforms::blockMatches(const ShaderProgram& program, const ShaderUniformBlock& block){
+	if(block.dataSize < (int)sizeof(FrameParameters) - (int)sizeof(FrameParameters::padding)){
+		return false;
+	}
+	for(const Field& field : fields){
+		const ShaderUniform* uniform = program.findUniform(field.name);
+		if(uniform == nullptr){
+			uniform = program.findUniform("FrameParameters." + std::string(field.name));
+		}
+		if(uniform == nullptr || uniform->blockIndex != (int)block.index || uniform->offset != (int)field.offset){
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned int FrameUniforms::upload(const FrameParameters& parameters){
+	const unsigned char* current = (const unsigned char*)&parameters;
+	const unsigned char* previous = (const unsigned char*)&last;
+	unsigned int calls = 0;
+
+	if(buffer != 0){
+		// Re-send the smallest byte range covering every change
+		size_t size = sizeof(FrameParameters) - sizeof(FrameParameters::padding);
+		size_t first = 0;
+		size_t end = size;
+		if(uploaded){
+			while(first < size && current[first] == previous[first]){
+				first++;
+			}
+			while(end > first && current[end - 1] == previous[end - 1]){
+				end--;
+			}
+		}
+		if(first < end){
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, first, end - first, current + first);
+			calls += 2;
+		}
+	} else {
+		for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++){
+			size_t fieldEnd = i + 1 < sizeof(fields) / sizeof(fields[0]) ? fields[i + 1].offset : offsetof(FrameParameters, padding);
+			const Field& field = fields[i];
+			if(field.location == -1){
+				continue;
+			}
+			if(!uploaded || memcmp(current + field.offset, previous + field.offset, fieldEnd - field.offset) != 0){
+				calls += uploadField(field, parameters);
+			}
+		}
+	}
+
+	last = parameters;
+	uploaded = true;
+	return calls;
+}
+
+unsigned int FrameUniforms::uploadField(const Field& field, const FrameParameters& parameters){
+	const unsigned char* value = (const unsigned char*)&parameters + field.offset;
+	switch(field.offset){
+		case offsetof(FrameParameters, model):
+		case offsetof(FrameParameters, view):
+		case offsetof(FrameParameters, projection):
+			glUniformMatrix4fv(field.location, 1, GL_FALSE, (const float*)value);
+			break;
+		case offsetof(FrameParameters, normalMatrix): {
+			glm::mat3 normalMatrix = parameters.getNormalMatrix();
+			glUniformMatrix3fv(field.location, 1, GL_FALSE, &normalMatrix[0][0]);
+			break;
+		}
+		case offsetof(FrameParameters, lightPosition):
+		case offsetof(FrameParameters, viewerPosition):
+		case offsetof(FrameParameters, lightColor):
+		case offsetof(FrameParameters, objectColor):
+			glUniform3fv(field.location, 1, (const float*)value);
+			break;
+		case offsetof(FrameParameters, shininess):
+			glUniform1f(field.location, *(const float*)value);
+			break;
+		default:
+			glUniform1i(field.location, *(const int*)value);
+			break;
+	}
+	return 1;
+}
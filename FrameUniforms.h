@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <glm/glm.hpp>
+#include "ShaderProgram.h"
+
+// Per frame shader parameters, laid out like the std140 block
+//
+//   layout(std140) uniform FrameParameters {
+//       mat4 model;
+//       mat4 view;
+//       mat4 projection;
+//       mat3 normalMatrix;
+//       vec3 lightPosition;  float shininess;
+//       vec3 viewerPosition; bool showZBuffer;
+//       vec3 lightColor;     bool useGouraudShading;
+//       vec3 objectColor;    bool usePhongShading;
+//       bool useFlatShading;
+//   };
+//
+// A std140 mat3 is three vec4 columns; every vec3 shares its 16 bytes with the scalar after it.
+class FrameParameters {
+	public:
+		glm::mat4 model = glm::mat4(1.0f);
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 projection = glm::mat4(1.0f);
+		glm::vec4 normalMatrix[3] = { glm::vec4(1, 0, 0, 0), glm::vec4(0, 1, 0, 0), glm::vec4(0, 0, 1, 0) };
+		glm::vec3 lightPosition = glm::vec3(0.0f);
+		float shininess = 0.0f;
+		glm::vec3 viewerPosition = glm::vec3(0.0f);
+		int showZBuffer = 0;
+		glm::vec3 lightColor = glm::vec3(0.0f);
+		int useGouraudShading = 0;
+		glm::vec3 objectColor = glm::vec3(0.0f);
+		int usePhongShading = 0;
+		int useFlatShading = 0;
+		int padding[3] = { 0, 0, 0 };
+
+		void setNormalMatrix(const glm::mat3& matrix);
+		glm::mat3 getNormalMatrix() const;
+};
+
+// Uploads FrameParameters to a program, only when they changed since the last upload. Programs
+// that declare the FrameParameters block read them from a uniform buffer (only the changed byte
+// range is re-sent); others get plain uniforms through locations cached at construction (only
+// the changed ones are set, shading flags the program doesn't have are skipped). The program has
+// to be in use when upload is called.
+class FrameUniforms {
+	public:
+		FrameUniforms(const ShaderProgram& program, unsigned int bindingPoint = 0);
+		~FrameUniforms();
+		FrameUniforms(const FrameUniforms&) = delete;
+		FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+		// Returns the number of GL calls issued
+		unsigned int upload(const FrameParameters& parameters);
+
+		bool wasError() { return errorFlag; }
+		bool usesUniformBuffer() { return buffer != 0; }
+
+	private:
+		class Field {
+			public:
+				const char* name;
+				size_t offset;
+				int location;
+				// A ShadingVariant compiles the shading flags in as constants, so the program may not have them
+				bool shadingFlag;
+		};
+
+		bool errorFlag;
+		unsigned int buffer;
+		bool uploaded;
+		FrameParameters last;
+		Field fields[13];
+
+		bool blockMatches(const ShaderProgram& program, const ShaderUniformBlock& block);
+		unsigned int uploadField(const Field& field, const FrameParameters& parameters);
+};
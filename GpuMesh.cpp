@@ -0,0 +1,87 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GpuMesh.h"
+#include "Trace.h"
+
+namespace {
+	GLenum glType(VertexAttributeFormat::Type type){
+		switch(type){
+			case VertexAttributeFormat::Type::FLOAT: return GL_FLOAT;
+			case VertexAttributeFormat::Type::HALF_FLOAT: return GL_HALF_FLOAT;
+			case VertexAttributeFormat::Type::INT_2_10_10_10_REV: return GL_INT_2_10_10_10_REV;
+			case VertexAttributeFormat::Type::UNSIGNED_SHORT: return GL_UNSIGNED_SHORT;
+			case VertexAttributeFormat::Type::SHORT: return GL_SHORT;
+		}
+		return GL_FLOAT;
+	}
+}
+
+void setupVertexAttributes(const VertexLayout& layout, const std::vector<unsigned int>& buffers){
+	for(const VertexAttributeFormat& attribute : layout.attributes){
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[attribute.buffer]);
+		glVertexAttribPointer(attribute.location, attribute.components, glType(attribute.type),
+			attribute.normalized ? GL_TRUE : GL_FALSE, (GLsizei)layout.strides[attribute.buffer], (void*)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Upload the vertex buffers and the indices (16 bit when every vertex fits) into a new VAO
+GpuMesh::GpuMesh(const VertexBufferData& vertexData, const std::vector<unsigned int>& indices) {
+	TraceScope trace("GpuMesh::upload");
+	indexCount = indices.size();
+	uploadedBytes = 0;
+
+	glGenVertexArrays(1, &VAO);
+	VBOs.resize(vertexData.buffers.size());
+	glGenBuffers(VBOs.size(), VBOs.data());
+	glGenBuffers(1, &EBO);
+
+	glBindVertexArray(VAO);
+
+	for(size_t i = 0; i < VBOs.size(); i++){
+		glBindBuffer(GL_ARRAY_BUFFER, VBOs[i]);
+		glBufferData(GL_ARRAY_BUFFER, vertexData.buffers[i].size(), vertexData.buffers[i].data(), GL_STATIC_DRAW);
+		uploadedBytes += vertexData.buffers[i].size();
+	}
+	setupVertexAttributes(vertexData.layout, VBOs);
+
+	// The element buffer binding is part of the VAO state, so it stays bound after the VAO is unbound
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if(vertexData.vertexCount <= 0xFFFF){
+		std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		indexType = GL_UNSIGNED_SHORT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+		uploadedBytes += shortIndices.size() * sizeof(unsigned short);
+	} else {
+		indexType = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		uploadedBytes += indices.size() * sizeof(unsigned int);
+	}
+
+	glBindVertexArray(0);
+	trace.setBytes(uploadedBytes);
+	trace.setTriangles(indexCount / 3);
+}
+
+GpuMesh::~GpuMesh(){
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(VBOs.size(), VBOs.data());
+	glDeleteBuffers(1, &EBO);
+}
+
+void GpuMesh::draw(){
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)0);
+}
+
+void GpuMesh::draw(const VisibleClusters& visible){
+	size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	rangeOffsets.resize(visible.firstIndices.size());
+	for(size_t i = 0; i < rangeOffsets.size(); i++){
+		rangeOffsets[i] = (const void*)(visible.firstIndices[i] * indexSize);
+	}
+	glBindVertexArray(VAO);
+	glMultiDrawElements(GL_TRIANGLES, visible.counts.data(), indexType, rangeOffsets.data(), (GLsizei)rangeOffsets.size());
+}
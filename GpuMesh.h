@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "VertexLayout.h"
+#include "MeshClusters.h"
+
+// Vertex array object with its vertex and index buffers, configured from a VertexLayout
+// instead of hardcoded attribute pointers. Requires a current GL context.
+class GpuMesh {
+	public:
+		GpuMesh(const VertexBufferData& vertexData, const std::vector<unsigned int>& indices);
+		~GpuMesh();
+
+		GpuMesh(const GpuMesh&) = delete;
+		GpuMesh& operator=(const GpuMesh&) = delete;
+
+		void draw();
+		// Only the visible index ranges, in one glMultiDrawElements
+		void draw(const VisibleClusters& visible);
+
+		unsigned int getVAO() { return VAO; }
+		unsigned int getIndexCount() { return indexCount; }
+		unsigned int getIndexType() { return indexType; }
+		size_t getUploadedBytes() { return uploadedBytes; }
+
+	private:
+		unsigned int VAO;
+		std::vector<unsigned int> VBOs;
+		unsigned int EBO;
+		unsigned int indexCount;
+		unsigned int indexType;
+		size_t uploadedBytes;
+		std::vector<const void*> rangeOffsets;
+};
+
+// Bind each attribute of the layout to its buffer in the currently bound VAO
+void setupVertexAttributes(const VertexLayout& layout, const std::vector<unsigned int>& buffers);
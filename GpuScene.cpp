@@ -0,0 +1,270 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+
+#include "GpuScene.h"
+#include "GpuMesh.h"
+
+// Concatenate the models into shared buffers and upload the instances grouped by model
+GpuScene::GpuScene(const SceneData& scene, const std::vector<SceneModel>& models) {
+	errorFlag = true;
+	VAO = 0;
+	EBO = 0;
+	instanceBuffer = 0;
+	indirectBuffer = 0;
+	indexType = GL_UNSIGNED_INT;
+	indexSize = sizeof(unsigned int);
+	triangleCount = 0;
+	uploadedBytes = 0;
+	commandCount = 0;
+
+	if (models.empty() || models.size() != scene.models.size()) {
+		std::cerr << "Error: Scene needs one loaded model per model name" << std::endl;
+		return;
+	}
+	const VertexLayout& layout = models[0].vertexData.layout;
+	for (size_t i = 0; i < models.size(); i++) {
+		const VertexLayout& modelLayout = models[i].vertexData.layout;
+		if (modelLayout.type != layout.type || modelLayout.strides != layout.strides || modelLayout.attributes.size() != layout.attributes.size()) {
+			std::cerr << "Error: Model " << scene.models[i] << " has different vertex attributes than " << scene.models[0] << std::endl;
+			return;
+		}
+	}
+
+	// Each model's indices stay relative to its own vertices, so 16 bits are enough as long as
+	// no single model has more vertices than that
+	bool shortIndices = true;
+	size_t totalIndices = 0;
+	ranges.resize(models.size());
+	for (size_t i = 0; i < models.size(); i++) {
+		shortIndices = shortIndices && models[i].vertexData.vertexCount <= 0xFFFF;
+		ranges[i].indexCount = models[i].indices.size();
+		ranges[i].firstIndex = totalIndices;
+		totalIndices += models[i].indices.size();
+	}
+	indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	indexSize = shortIndices ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	// Instances ordered by model, so the instances of a model are one contiguous range
+	std::vector<unsigned int> order(scene.instances.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	for (const SceneInstance& instance : scene.instances) {
+		if (instance.model >= models.size()) {
+			std::cerr << "Error: Instance of unknown model " << instance.model << std::endl;
+			return;
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return scene.instances[a].model < scene.instances[b].model;
+	});
+	instances.resize(order.size());
+	instanceModels.resize(order.size());
+	for (size_t i = 0; i < models.size(); i++) {
+		ranges[i].firstInstance = 0;
+		ranges[i].instanceCount = 0;
+	}
+	for (size_t i = 0; i < order.size(); i++) {
+		const SceneInstance& instance = scene.instances[order[i]];
+		ModelRange& range = ranges[instance.model];
+		if (range.instanceCount == 0) {
+			range.firstInstance = i;
+		}
+		range.instanceCount++;
+		// Quantized positions are scaled back per model, ahead of the instance transform
+		instances[i].model = instance.transform * models[instance.model].vertexData.positionDequantization;
+		instances[i].normalMatrix = glm::mat3(glm::transpose(glm::inverse(instance.transform)));
+		instanceModels[i] = instance.model;
+		triangleCount += ranges[instance.model].indexCount / 3;
+	}
+
+	glGenVertexArrays(1, &VAO);
+	VBOs.resize(layout.strides.size());
+	glGenBuffers(VBOs.size(), VBOs.data());
+	glGenBuffers(1, &EBO);
+	glGenBuffers(1, &instanceBuffer);
+
+	glBindVertexArray(VAO);
+
+	// Allocate each layout buffer for all models, then copy the models in one after the other
+	int baseVertex = 0;
+	for (size_t i = 0; i < models.size(); i++) {
+		ranges[i].baseVertex = baseVertex;
+		baseVertex += models[i].vertexData.vertexCount;
+	}
+	for (size_t buffer = 0; buffer < VBOs.size(); buffer++) {
+		size_t bufferBytes = 0;
+		for (const SceneModel& model : models) {
+			bufferBytes += model.vertexData.buffers[buffer].size();
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, VBOs[buffer]);
+		glBufferData(GL_ARRAY_BUFFER, bufferBytes, nullptr, GL_STATIC_DRAW);
+		size_t offset = 0;
+		for (const SceneModel& model : models) {
+			glBufferSubData(GL_ARRAY_BUFFER, offset, model.vertexData.buffers[buffer].size(), model.vertexData.buffers[buffer].data());
+			offset += model.vertexData.buffers[buffer].size();
+		}
+		uploadedBytes += bufferBytes;
+	}
+	setupVertexAttributes(layout, VBOs);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalIndices * indexSize, nullptr, GL_STATIC_DRAW);
+	for (size_t i = 0; i < models.size(); i++) {
+		const std::vector<unsigned int>& indices = models[i].indices;
+		if (shortIndices) {
+			std::vector<unsigned short> modelIndices(indices.begin(), indices.end());
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, ranges[i].firstIndex * indexSize, modelIndices.size() * indexSize, modelIndices.data());
+		} else {
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, ranges[i].firstIndex * indexSize, indices.size() * indexSize, indices.data());
+		}
+	}
+	uploadedBytes += totalIndices * indexSize;
+
+	// A mat4 and a mat3 attribute take one location per column, advancing once per instance
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+	uploadedBytes += instances.size() * sizeof(InstanceData);
+	for (unsigned int location = 3; location < 10; location++) {
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+	pointInstanceAttributes(0);
+
+	// One indirect command per model that has instances, base instance selecting its range
+	if (supports(DrawMode::MULTI_DRAW_INDIRECT)) {
+		std::vector<DrawCommand> commands;
+		for (const ModelRange& range : ranges) {
+			if (range.instanceCount > 0) {
+				commands.push_back({ range.indexCount, range.instanceCount, range.firstIndex, range.baseVertex, range.firstInstance });
+			}
+		}
+		commandCount = commands.size();
+		glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		uploadedBytes += commands.size() * sizeof(DrawCommand);
+	}
+
+	glBindVertexArray(0);
+	errorFlag = false;
+}
+
+GpuScene::~GpuScene(){
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(VBOs.size(), VBOs.data());
+	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &instanceBuffer);
+	if (indirectBuffer != 0) {
+		glDeleteBuffers(1, &indirectBuffer);
+	}
+}
+
+void GpuScene::pointInstanceAttributes(unsigned int firstInstance){
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	size_t base = firstInstance * sizeof(InstanceData);
+	for (unsigned int column = 0; column < 4; column++) {
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(base + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+	}
+	for (unsigned int column = 0; column < 3; column++) {
+		glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(base + offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int GpuScene::draw(DrawMode mode, FrameUniforms& uniforms, const FrameParameters& parameters){
+	glBindVertexArray(VAO);
+	unsigned int calls = 1;
+
+	if (mode == DrawMode::NAIVE) {
+		// What drawing every object on its own costs: new matrices and a draw call per instance
+		FrameParameters instanceParameters = parameters;
+		glm::mat3 normalMatrix = parameters.getNormalMatrix();
+		for (size_t i = 0; i < instances.size(); i++) {
+			const ModelRange& range = ranges[instanceModels[i]];
+			instanceParameters.model = parameters.model * instances[i].model;
+			instanceParameters.setNormalMatrix(normalMatrix * instances[i].normalMatrix);
+			calls += uniforms.upload(instanceParameters);
+			glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)(range.firstIndex * indexSize), range.baseVertex);
+			calls++;
+		}
+		return calls;
+	}
+
+	calls += uniforms.upload(parameters);
+	if (mode == DrawMode::MULTI_DRAW_INDIRECT && indirectBuffer != 0) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)0, commandCount, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		return calls + 3;
+	}
+
+	// Also the fallback when multi draw indirect isn't available
+	bool baseInstance = GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+	for (const ModelRange& range : ranges) {
+		if (range.instanceCount == 0) {
+			continue;
+		}
+		if (baseInstance) {
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, range.indexCount, indexType,
+				(void*)(range.firstIndex * indexSize), range.instanceCount, range.baseVertex, range.firstInstance);
+			calls++;
+		} else {
+			// Without base instance the attributes start at the model's first instance instead
+			pointInstanceAttributes(range.firstInstance);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, indexType,
+				(void*)(range.firstIndex * indexSize), range.instanceCount, range.baseVertex);
+			calls += 10;
+		}
+	}
+	if (!baseInstance) {
+		pointInstanceAttributes(0);
+		calls += 9;
+	}
+	return calls;
+}
+
+unsigned int GpuScene::getDrawCallCount(DrawMode mode){
+	if (mode == DrawMode::NAIVE) {
+		return instances.size();
+	}
+	if (mode == DrawMode::MULTI_DRAW_INDIRECT && indirectBuffer != 0) {
+		return 1;
+	}
+	unsigned int draws = 0;
+	for (const ModelRange& range : ranges) {
+		draws += range.instanceCount > 0 ? 1 : 0;
+	}
+	return draws;
+}
+
+bool GpuScene::supports(DrawMode mode){
+	switch (mode) {
+		case DrawMode::NAIVE: return true;
+		case DrawMode::INSTANCED: return true;
+		case DrawMode::MULTI_DRAW_INDIRECT: return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+	}
+	return false;
+}
+
+const char* GpuScene::name(DrawMode mode){
+	switch (mode) {
+		case DrawMode::NAIVE: return "naive";
+		case DrawMode::INSTANCED: return "instanced";
+		case DrawMode::MULTI_DRAW_INDIRECT: return "multi-draw-indirect";
+	}
+	return "";
+}
+
+std::string instancingGLSL(){
+	return
+		"#define INSTANCED\n"
+		"layout (location = 3) in mat4 instanceModel;\n"
+		"layout (location = 7) in mat3 instanceNormalMatrix;\n";
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include "SceneData.h"
+#include "VertexLayout.h"
+#include "FrameUniforms.h"
+
+// Vertex data and indices of one model of a scene, before upload
+class SceneModel {
+	public:
+		VertexBufferData vertexData;
+		std::vector<unsigned int> indices;
+};
+
+// Every model of a scene packed into one VAO: the layout buffers and the indices of all models
+// are concatenated (each model draws with its base vertex and first index), and one per instance
+// buffer holds the instance transforms, sorted by model. All models must share a vertex layout.
+//   NAIVE:               one draw per instance, its model matrix set as a uniform
+//   INSTANCED:           one instanced draw per model
+//   MULTI_DRAW_INDIRECT: one glMultiDrawElementsIndirect for the whole scene (GL 4.3)
+// INSTANCED and MULTI_DRAW_INDIRECT need a program built with instancingGLSL.
+class GpuScene {
+	public:
+		enum class DrawMode { NAIVE, INSTANCED, MULTI_DRAW_INDIRECT };
+
+		GpuScene(const SceneData& scene, const std::vector<SceneModel>& models);
+		~GpuScene();
+
+		GpuScene(const GpuScene&) = delete;
+		GpuScene& operator=(const GpuScene&) = delete;
+
+		bool wasError() { return errorFlag; }
+
+		// Uploads parameters (once, or per instance for NAIVE) and draws every instance.
+		// The program has to be in use. Returns the number of GL calls issued.
+		unsigned int draw(DrawMode mode, FrameUniforms& uniforms, const FrameParameters& parameters);
+
+		// Draw calls (not counting uniform uploads) one draw issues
+		unsigned int getDrawCallCount(DrawMode mode);
+
+		size_t getInstanceCount() { return instances.size(); }
+		size_t getTriangleCount() { return triangleCount; }
+		size_t getUploadedBytes() { return uploadedBytes; }
+
+		// MULTI_DRAW_INDIRECT needs GL 4.3 or ARB_multi_draw_indirect (drawn INSTANCED without).
+		// INSTANCED uses the base instance draw with GL 4.2 or ARB_base_instance and re-points
+		// the instance attributes per model otherwise.
+		static bool supports(DrawMode mode);
+		static const char* name(DrawMode mode);
+
+	private:
+		class ModelRange {
+			public:
+				unsigned int indexCount;
+				unsigned int firstIndex;
+				int baseVertex;
+				unsigned int firstInstance;
+				unsigned int instanceCount;
+		};
+
+		class DrawCommand {
+			public:
+				unsigned int count;
+				unsigned int instanceCount;
+				unsigned int firstIndex;
+				int baseVertex;
+				unsigned int baseInstance;
+		};
+
+		// Per instance vertex attributes, locations 3-6 and 7-9
+		class InstanceData {
+			public:
+				glm::mat4 model;
+				glm::mat3 normalMatrix;
+		};
+
+		bool errorFlag;
+		unsigned int VAO;
+		std::vector<unsigned int> VBOs;
+		unsigned int EBO;
+		unsigned int instanceBuffer;
+		unsigned int indirectBuffer;
+		unsigned int indexType;
+		size_t indexSize;
+		size_t triangleCount;
+		size_t uploadedBytes;
+		std::vector<ModelRange> ranges;
+		std::vector<InstanceData> instances;
+		std::vector<unsigned int> instanceModels;
+		unsigned int commandCount;
+
+		void pointInstanceAttributes(unsigned int firstInstance);
+};
+
+// GLSL inserted after #version of the vertex shader for instanced drawing: defines INSTANCED
+// and declares the per instance attributes. The shader multiplies them in, e.g.
+//   #ifdef INSTANCED
+//       mat4 objectModel = model * instanceModel;
+//       mat3 objectNormalMatrix = normalMatrix * instanceNormalMatrix;
+//   #endif
+std::string instancingGLSL();
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// 64-bit FNV-1a. Pass a previous result as seed to hash several buffers as one stream.
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = 14695981039346656037ull){
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+	for(size_t i = 0; i < size; i++){
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& text, uint64_t seed = 14695981039346656037ull){
+	return fnv1a64(text.data(), text.size(), seed);
+}
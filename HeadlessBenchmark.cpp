@@ -0,0 +1,1332 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+#include <cstring>
+#include <ctime>
+
+#include "HeadlessBenchmark.h"
+#include "Renderer.h"
+#include "SceneReader.h"
+#include "AsyncModelLoader.h"
+#include "MeshCache.h"
+#include "ObjReader.h"
+#include "SoftwareRasterizer.h"
+#include "Parallel.h"
+
+namespace {
+	const int width = 800;
+	const int height = 600;
+	// Parsed models kept by a scene's AssetManager; the benchmark only loads one batch
+	const size_t sceneAssetBudget = 256 * 1024 * 1024;
+
+	// Offscreen core profile context on the default EGL display
+	class HeadlessContext {
+		public:
+			HeadlessContext();
+			~HeadlessContext();
+			bool wasError() { return errorFlag; }
+			void swapBuffers() { eglSwapBuffers(display, surface); }
+
+		private:
+			bool errorFlag;
+			EGLDisplay display;
+			EGLSurface surface;
+			EGLContext context;
+	};
+
+	HeadlessContext::HeadlessContext(){
+		errorFlag = true;
+		surface = EGL_NO_SURFACE;
+		context = EGL_NO_CONTEXT;
+
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		EGLint major, minor;
+		if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)){
+			std::cerr << "Error: Cannot initialize EGL" << std::endl;
+			display = EGL_NO_DISPLAY;
+			return;
+		}
+
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if(!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0){
+			std::cerr << "Error: No EGL config with a pbuffer and a depth buffer" << std::endl;
+			return;
+		}
+
+		const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+
+		// Same version and profile as the GLFW window
+		eglBindAPI(EGL_OPENGL_API);
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if(surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)){
+			std::cerr << "Error: Cannot create an EGL pbuffer context" << std::endl;
+			return;
+		}
+
+		// GLEW looks for a GLX display after loading the entry points, which fails under EGL
+		glewExperimental = GL_TRUE;
+		GLenum result = glewInit();
+		if(result != GLEW_OK && result != GLEW_ERROR_NO_GLX_DISPLAY){
+			std::cerr << "Error: " << glewGetErrorString(result) << std::endl;
+			return;
+		}
+		errorFlag = false;
+	}
+
+	HeadlessContext::~HeadlessContext(){
+		if(display == EGL_NO_DISPLAY){
+			return;
+		}
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if(context != EGL_NO_CONTEXT){
+			eglDestroyContext(display, context);
+		}
+		if(surface != EGL_NO_SURFACE){
+			eglDestroySurface(display, surface);
+		}
+		eglTerminate(display);
+	}
+
+	// Color and depth renderbuffers of any size, for targets larger than the pbuffer
+	class OffscreenTarget {
+		public:
+			OffscreenTarget(int width, int height);
+			~OffscreenTarget();
+			bool wasError() { return errorFlag; }
+			void bind();
+			std::vector<unsigned char> readPixels();
+
+		private:
+			bool errorFlag;
+			int width;
+			int height;
+			unsigned int framebuffer;
+			unsigned int renderbuffers[2];
+	};
+
+	OffscreenTarget::OffscreenTarget(int width, int height){
+		this->width = width;
+		this->height = height;
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(2, renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		errorFlag = glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE;
+		if(errorFlag){
+			std::cerr << "Error: Cannot create a " << width << "x" << height << " framebuffer" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	OffscreenTarget::~OffscreenTarget(){
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(2, renderbuffers);
+	}
+
+	void OffscreenTarget::bind(){
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+	}
+
+	std::vector<unsigned char> OffscreenTarget::readPixels(){
+		std::vector<unsigned char> pixels((size_t)width * height * 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	}
+
+	// One orbit around the model, moving in and out and tilting, with the shading mode switching
+	// every quarter so each path through the fragment shader is timed
+	ViewState cameraPath(unsigned int frame, unsigned int frameCount){
+		float t = (float)frame / std::max(frameCount, 1u);
+		float angle = 6.2831853f * t;
+
+		ViewState view;
+		view.aspectRatio = (float)width / (float)height;
+		view.position = glm::vec3(0.0f, 0.0f, -5.0f + 1.5f * sin(angle));
+		view.rotationDegrees = glm::vec3(20.0f * sin(2.0f * angle), 360.0f * t, 0.0f);
+
+		int quarter = std::min((int)(t * 4.0f), 3);
+		view.useFlatShading = quarter == 1;
+		view.useGouraudShading = quarter == 2;
+		view.usePhongShading = quarter == 3;
+		return view;
+	}
+
+	// Nearest rank percentile
+	double percentile(std::vector<double> values, double p){
+		if(values.empty()){
+			return 0.0;
+		}
+		std::sort(values.begin(), values.end());
+		size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+		return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+	}
+
+	void writeStats(std::ostream& out, const char* name, const std::vector<double>& values, const char* indent = "  "){
+		double sum = 0.0;
+		for(double value : values){
+			sum += value;
+		}
+		out << indent << "\"" << name << "\": { \"mean\": " << (values.empty() ? 0.0 : sum / values.size())
+			<< ", \"p50\": " << percentile(values, 50) << ", \"p95\": " << percentile(values, 95)
+			<< ", \"p99\": " << percentile(values, 99)
+			<< ", \"max\": " << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end())) << " },\n";
+	}
+
+	void writeArray(std::ostream& out, const char* name, const std::vector<double>& values, bool last){
+		out << "  \"" << name << "\": [";
+		for(size_t i = 0; i < values.size(); i++){
+			out << (i == 0 ? "" : ", ") << values[i];
+		}
+		out << "]" << (last ? "\n" : ",\n");
+	}
+
+	std::string jsonEscape(const std::string& text){
+		std::string escaped;
+		for(char c : text){
+			if(c == '"' || c == '\\'){
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	// instanceCount copies of the models, cycling through them, on a cube shaped grid around the
+	// origin, each turned its own way
+	void generateScene(const std::string& modelList, unsigned int instanceCount, SceneData& outScene){
+		std::stringstream names(modelList);
+		std::string name;
+		while(getline(names, name, ',')){
+			if(!name.empty()){
+				outScene.models.push_back(name);
+			}
+		}
+		if(outScene.models.empty()){
+			return;
+		}
+
+		const float spacing = 3.0f;
+		unsigned int side = (unsigned int)std::ceil(std::cbrt((double)instanceCount));
+		float center = 0.5f * spacing * (side - 1);
+		for(unsigned int i = 0; i < instanceCount; i++){
+			glm::vec3 position(spacing * (i % side) - center, spacing * (i / side % side) - center, spacing * (i / (side * side)) - center);
+			glm::vec3 rotation((i * 37) % 360, (i * 113) % 360, (i * 59) % 360);
+			outScene.instances.push_back({ i % (unsigned int)outScene.models.size(), instanceTransform(position, rotation, 1.0f) });
+		}
+	}
+
+	// Sphere around the origin enclosing every instance, assuming models within the unit sphere
+	float sceneRadius(const SceneData& scene){
+		float radius = 1.0f;
+		for(const SceneInstance& instance : scene.instances){
+			radius = std::max(radius, glm::length(glm::vec3(instance.transform[3])) + 1.0f);
+		}
+		return radius;
+	}
+
+	// Far enough back to see the whole scene, orbiting it
+	ViewState sceneCameraPath(float radius, unsigned int frame, unsigned int frameCount){
+		float t = (float)frame / std::max(frameCount, 1u);
+
+		ViewState view;
+		view.aspectRatio = (float)width / (float)height;
+		view.position = glm::vec3(0.0f, 0.0f, -radius / std::tan(glm::radians(view.fovy / 2.0f)) - radius);
+		view.rotationDegrees = glm::vec3(20.0f, 360.0f * t, 0.0f);
+		view.usePhongShading = true;
+		return view;
+	}
+
+	// Close to the model with a narrow field of view, panning across it while it turns, so only
+	// a small part is on screen at any time
+	ViewState zoomedCameraPath(unsigned int frame, unsigned int frameCount){
+		float t = (float)frame / std::max(frameCount, 1u);
+		float angle = 6.2831853f * t;
+
+		ViewState view;
+		view.aspectRatio = (float)width / (float)height;
+		view.fovy = 10.0f;
+		view.position = glm::vec3(0.5f * sin(angle), 0.3f * sin(2.0f * angle), -2.5f);
+		view.rotationDegrees = glm::vec3(15.0f, 90.0f * t, 0.0f);
+		view.usePhongShading = true;
+		return view;
+	}
+
+	std::vector<unsigned char> readPixels(){
+		std::vector<unsigned char> pixels(width * height * 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	}
+
+	bool writeJson(const std::string& json, const std::string& jsonPath){
+		if(jsonPath.empty()){
+			std::cout << json;
+			return true;
+		}
+		std::ofstream out(jsonPath);
+		if(!out.is_open()){
+			std::cerr << "Error: Cannot write " << jsonPath << std::endl;
+			return false;
+		}
+		out << json;
+		std::cout << "Wrote " << jsonPath << std::endl;
+		return true;
+	}
+}
+
+bool benchmarkHeadlessRender(const std::string& model, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> shaderProgram = loadShaderProgram(layout);
+	if(!shaderProgram){
+		return false;
+	}
+	shaderProgram->use();
+	FrameUniforms frameUniforms(*shaderProgram);
+	if(frameUniforms.wasError()){
+		return false;
+	}
+	RenderModel renderModel;
+	if(!loadRenderModel(model, layout, renderModel, false)){
+		return false;
+	}
+
+	// Results are read a few frames late so waiting on a query doesn't stall the pipeline
+	const unsigned int queryCount = 4;
+	unsigned int queries[queryCount];
+	glGenQueries(queryCount, queries);
+
+	// The first frames include shader compilation and first use of the buffers
+	const unsigned int warmupFrames = std::min(10u, frameCount / 10);
+	std::vector<double> cpuMilliseconds;
+	std::vector<double> frameMilliseconds;
+	std::vector<double> gpuMilliseconds;
+	unsigned long long glCalls = 0;
+	VisibleClusters ranges;
+
+	auto readQuery = [&](unsigned int frame){
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[frame % queryCount], GL_QUERY_RESULT, &nanoseconds);
+		if(frame >= warmupFrames){
+			gpuMilliseconds.push_back(nanoseconds / 1e6);
+		}
+	};
+
+	for(unsigned int frame = 0; frame < frameCount; frame++){
+		if(frame >= queryCount){
+			readQuery(frame - queryCount);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, queries[frame % queryCount]);
+		FrameParameters frameParameters = computeFrameParameters(cameraPath(frame, frameCount), renderModel.vertexData.positionDequantization);
+		selectDrawRanges(renderModel, frameParameters, 0, false, ranges);
+		unsigned int calls = renderFrame(*shaderProgram, frameUniforms, *renderModel.mesh, frameParameters, false, ranges);
+		glEndQuery(GL_TIME_ELAPSED);
+		std::chrono::duration<double> submitted = std::chrono::high_resolution_clock::now() - start;
+
+		// A software rasterizer does most of the work when the frame is flushed
+		context.swapBuffers();
+		std::chrono::duration<double> presented = std::chrono::high_resolution_clock::now() - start;
+
+		if(frame >= warmupFrames){
+			cpuMilliseconds.push_back(submitted.count() * 1000.0);
+			frameMilliseconds.push_back(presented.count() * 1000.0);
+			glCalls += calls;
+		}
+	}
+	for(unsigned int frame = frameCount > queryCount ? frameCount - queryCount : 0; frame < frameCount; frame++){
+		readQuery(frame);
+	}
+	glDeleteQueries(queryCount, queries);
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"width\": " << width << ", \"height\": " << height << ",\n";
+	json << "  \"frames\": " << frameCount << ", \"warmupFrames\": " << warmupFrames << ",\n";
+	json << "  \"triangles\": " << renderModel.mesh->getIndexCount() / 3 << ",\n";
+	json << "  \"glCallsPerFrame\": " << (cpuMilliseconds.empty() ? 0.0 : (double)glCalls / cpuMilliseconds.size()) << ",\n";
+	writeStats(json, "cpuMs", cpuMilliseconds);
+	writeStats(json, "frameMs", frameMilliseconds);
+	writeStats(json, "gpuMs", gpuMilliseconds);
+	writeArray(json, "cpuFrameMs", cpuMilliseconds, false);
+	writeArray(json, "frameMs", frameMilliseconds, false);
+	writeArray(json, "gpuFrameMs", gpuMilliseconds, true);
+	json << "}\n";
+
+	renderModel.mesh.reset();
+	shaderProgram.reset();
+	return writeJson(json.str(), jsonPath);
+}
+
+bool benchmarkHeadlessScene(const std::string& scene, unsigned int instanceCount, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	SceneData sceneData;
+	std::string scenePath = "../data/scenes/" + scene + ".scene";
+	if(std::ifstream(scenePath).good()){
+		SceneReader sceneReader(scenePath);
+		sceneReader.read(sceneData);
+		if(sceneReader.wasError()){
+			return false;
+		}
+	} else {
+		generateScene(scene, instanceCount, sceneData);
+	}
+	if(sceneData.instances.empty()){
+		std::cerr << "Error: Scene " << scene << " has no instances" << std::endl;
+		return false;
+	}
+
+	// Each model is read once, however many instances it has, and the files are read concurrently
+	AssetManager assets(sceneAssetBudget);
+	std::vector<SceneModel> models;
+	if(!loadSceneModels(assets, sceneData.models, layout, models)){
+		return false;
+	}
+	std::unique_ptr<GpuScene> gpuScene(new GpuScene(sceneData, models));
+	if(gpuScene->wasError()){
+		return false;
+	}
+
+	// Naive draws use the shader as it is, the other modes the one reading per instance matrices
+	std::unique_ptr<ShaderProgram> programs[2] = { loadShaderProgram(layout), loadShaderProgram(layout, true) };
+	if(!programs[0] || !programs[1]){
+		return false;
+	}
+	// Each program keeps its own uniform buffer binding point
+	std::unique_ptr<FrameUniforms> uniforms[2];
+	for(int i = 0; i < 2; i++){
+		programs[i]->use();
+		uniforms[i].reset(new FrameUniforms(*programs[i], i));
+		if(uniforms[i]->wasError()){
+			return false;
+		}
+	}
+
+	const float radius = sceneRadius(sceneData);
+	const GpuScene::DrawMode modes[] = { GpuScene::DrawMode::NAIVE, GpuScene::DrawMode::INSTANCED, GpuScene::DrawMode::MULTI_DRAW_INDIRECT };
+	const unsigned int warmupFrames = std::min(10u, frameCount / 10);
+	std::vector<unsigned char> naivePixels;
+	bool identical = true;
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"scene\": \"" << jsonEscape(scene) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"width\": " << width << ", \"height\": " << height << ",\n";
+	json << "  \"models\": " << sceneData.models.size() << ", \"instances\": " << gpuScene->getInstanceCount() << ",\n";
+	json << "  \"triangles\": " << gpuScene->getTriangleCount() << ",\n";
+	json << "  \"frames\": " << frameCount << ", \"warmupFrames\": " << warmupFrames << ",\n";
+	json << "  \"modes\": [\n";
+
+	for(GpuScene::DrawMode mode : modes){
+		if(!GpuScene::supports(mode)){
+			std::cout << GpuScene::name(mode) << ": not supported by this context\n";
+			continue;
+		}
+		int program = mode == GpuScene::DrawMode::NAIVE ? 0 : 1;
+
+		std::vector<double> cpuMilliseconds;
+		std::vector<double> frameMilliseconds;
+		unsigned long long glCalls = 0;
+		for(unsigned int frame = 0; frame < frameCount; frame++){
+			auto start = std::chrono::high_resolution_clock::now();
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			programs[program]->use();
+			FrameParameters frameParameters = computeFrameParameters(sceneCameraPath(radius, frame, frameCount), glm::mat4(1.0f));
+			unsigned int calls = 3 + gpuScene->draw(mode, *uniforms[program], frameParameters);
+			std::chrono::duration<double> submitted = std::chrono::high_resolution_clock::now() - start;
+
+			context.swapBuffers();
+			std::chrono::duration<double> presented = std::chrono::high_resolution_clock::now() - start;
+			if(frame >= warmupFrames){
+				cpuMilliseconds.push_back(submitted.count() * 1000.0);
+				frameMilliseconds.push_back(presented.count() * 1000.0);
+				glCalls += calls;
+			}
+		}
+
+		// Every mode draws the same first frame once more to compare against the naive one
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gpuScene->draw(mode, *uniforms[program], computeFrameParameters(sceneCameraPath(radius, 0, frameCount), glm::mat4(1.0f)));
+		std::vector<unsigned char> pixels = readPixels();
+		double differing = 0.0;
+		if(mode == GpuScene::DrawMode::NAIVE){
+			naivePixels = pixels;
+		} else {
+			differing = differingPixels(naivePixels, pixels);
+			identical = identical && differing < 0.01;
+		}
+
+		double cpuMean = 0.0;
+		for(double value : cpuMilliseconds){
+			cpuMean += value;
+		}
+		cpuMean = cpuMilliseconds.empty() ? 0.0 : cpuMean / cpuMilliseconds.size();
+		std::cout << GpuScene::name(mode) << ": " << gpuScene->getDrawCallCount(mode) << " draw calls, "
+			<< cpuMean << " ms CPU per frame, " << differing * 100.0 << "% pixels differ from naive\n";
+
+		json << (mode == GpuScene::DrawMode::NAIVE ? "" : ",\n") << "    {\n";
+		json << "      \"mode\": \"" << GpuScene::name(mode) << "\",\n";
+		json << "      \"drawCalls\": " << gpuScene->getDrawCallCount(mode) << ",\n";
+		json << "      \"glCallsPerFrame\": " << (cpuMilliseconds.empty() ? 0.0 : (double)glCalls / cpuMilliseconds.size()) << ",\n";
+		json << "      \"differingPixels\": " << differing << ",\n";
+		writeStats(json, "cpuMs", cpuMilliseconds, "      ");
+		writeStats(json, "frameMs", frameMilliseconds, "      ");
+		json << "      \"samples\": " << cpuMilliseconds.size() << "\n";
+		json << "    }";
+	}
+	json << "\n  ]\n}\n";
+
+	gpuScene.reset();
+	uniforms[0].reset();
+	uniforms[1].reset();
+	programs[0].reset();
+	programs[1].reset();
+
+	if(!identical){
+		std::cout << "Instanced drawing renders a different image than naive drawing\n";
+	}
+	return writeJson(json.str(), jsonPath) && identical;
+}
+
+bool benchmarkHeadlessCulling(const std::string& model, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> shaderProgram = loadShaderProgram(layout);
+	if(!shaderProgram){
+		return false;
+	}
+	shaderProgram->use();
+	FrameUniforms frameUniforms(*shaderProgram);
+	if(frameUniforms.wasError()){
+		return false;
+	}
+	RenderModel renderModel;
+	if(!loadRenderModel(model, layout, renderModel, false)){
+		return false;
+	}
+
+	const unsigned int warmupFrames = std::min(10u, frameCount / 10);
+	std::vector<unsigned char> unculledPixels;
+	bool identical = true;
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"width\": " << width << ", \"height\": " << height << ",\n";
+	json << "  \"triangles\": " << renderModel.clusters.triangleCount << ",\n";
+	json << "  \"clusters\": " << renderModel.clusters.clusters.size() << ", \"bvhNodes\": " << renderModel.clusters.nodes.size() << ",\n";
+	json << "  \"frames\": " << frameCount << ", \"warmupFrames\": " << warmupFrames << ",\n";
+	json << "  \"passes\": [\n";
+
+	VisibleClusters visible;
+	for(int culling = 0; culling < 2; culling++){
+		std::vector<double> cullMilliseconds;
+		std::vector<double> cpuMilliseconds;
+		std::vector<double> frameMilliseconds;
+		std::vector<double> trianglesSubmitted;
+		std::vector<double> nodesVisited;
+		for(unsigned int frame = 0; frame <= frameCount; frame++){
+			// One frame past the path to draw the first view again for the image comparison
+			bool compareFrame = frame == frameCount;
+			FrameParameters frameParameters = computeFrameParameters(zoomedCameraPath(compareFrame ? 0 : frame, frameCount), renderModel.vertexData.positionDequantization);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			selectDrawRanges(renderModel, frameParameters, 0, culling, visible);
+			std::chrono::duration<double> culled = std::chrono::high_resolution_clock::now() - start;
+			renderFrame(*shaderProgram, frameUniforms, *renderModel.mesh, frameParameters, false, visible);
+			std::chrono::duration<double> submitted = std::chrono::high_resolution_clock::now() - start;
+
+			if(compareFrame){
+				break;
+			}
+			context.swapBuffers();
+			std::chrono::duration<double> presented = std::chrono::high_resolution_clock::now() - start;
+			if(frame >= warmupFrames){
+				cullMilliseconds.push_back(culled.count() * 1000.0);
+				cpuMilliseconds.push_back(submitted.count() * 1000.0);
+				frameMilliseconds.push_back(presented.count() * 1000.0);
+				trianglesSubmitted.push_back(visible.triangleCount);
+				nodesVisited.push_back(visible.nodesVisited);
+			}
+		}
+
+		std::vector<unsigned char> pixels = readPixels();
+		double differing = 0.0;
+		if(!culling){
+			unculledPixels = pixels;
+		} else {
+			differing = differingPixels(unculledPixels, pixels);
+			identical = identical && differing == 0.0;
+		}
+
+		double triangleMean = 0.0;
+		for(double value : trianglesSubmitted){
+			triangleMean += value;
+		}
+		triangleMean = trianglesSubmitted.empty() ? 0.0 : triangleMean / trianglesSubmitted.size();
+		std::cout << (culling ? "culled" : "unculled") << ": " << triangleMean << " of " << renderModel.clusters.triangleCount
+			<< " triangles submitted per frame, " << percentile(cullMilliseconds, 50) << " ms culling, "
+			<< percentile(frameMilliseconds, 50) << " ms per frame (p50)\n";
+
+		json << (culling ? ",\n" : "") << "    {\n";
+		json << "      \"culling\": " << (culling ? "true" : "false") << ",\n";
+		json << "      \"differingPixels\": " << differing << ",\n";
+		writeStats(json, "trianglesSubmitted", trianglesSubmitted, "      ");
+		writeStats(json, "nodesVisited", nodesVisited, "      ");
+		writeStats(json, "cullMs", cullMilliseconds, "      ");
+		writeStats(json, "cpuMs", cpuMilliseconds, "      ");
+		writeStats(json, "frameMs", frameMilliseconds, "      ");
+		json << "      \"samples\": " << cpuMilliseconds.size() << "\n";
+		json << "    }";
+	}
+	json << "\n  ]\n}\n";
+
+	renderModel.mesh.reset();
+	shaderProgram.reset();
+
+	if(!identical){
+		std::cout << "Culling changed the rendered image\n";
+	}
+	return writeJson(json.str(), jsonPath) && identical;
+}
+
+bool benchmarkHeadlessLod(const std::string& model, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> shaderProgram = loadShaderProgram(layout);
+	if(!shaderProgram){
+		return false;
+	}
+	shaderProgram->use();
+	FrameUniforms frameUniforms(*shaderProgram);
+	if(frameUniforms.wasError()){
+		return false;
+	}
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	RenderModel renderModel;
+	if(!loadRenderModel(model, layout, renderModel)){
+		return false;
+	}
+	std::chrono::duration<double> loaded = std::chrono::high_resolution_clock::now() - loadStart;
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"width\": " << width << ", \"height\": " << height << ",\n";
+	json << "  \"loadMs\": " << loaded.count() * 1000.0 << ",\n";
+	json << "  \"levels\": [";
+	for(size_t lod = 0; lod < renderModel.lods.size(); lod++){
+		json << (lod == 0 ? "" : ",") << "\n    { \"triangles\": " << renderModel.lods[lod].indexCount / 3
+			<< ", \"error\": " << renderModel.lods[lod].error
+			<< ", \"relativeError\": " << renderModel.lods[lod].error / (2.0f * std::max(renderModel.boundingRadius, 1e-30f)) << " }";
+	}
+	json << "\n  ],\n";
+	json << "  \"frames\": " << frameCount << ",\n";
+	json << "  \"distances\": [";
+
+	const float distances[] = { 2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f };
+	const unsigned int warmupFrames = std::min(5u, frameCount / 10);
+	VisibleClusters ranges;
+	bool first = true;
+	for(float distance : distances){
+		double frameMedian[2];
+		double trianglesMean[2];
+		double lodMean = 0.0;
+		std::vector<unsigned char> pixels[2];
+		for(int automatic = 0; automatic < 2; automatic++){
+			std::vector<double> frameMilliseconds;
+			double triangles = 0.0;
+			double lods = 0.0;
+			for(unsigned int frame = 0; frame <= frameCount; frame++){
+				// The extra frame draws the first view again for the image comparison
+				bool compareFrame = frame == frameCount;
+				ViewState view;
+				view.aspectRatio = (float)width / (float)height;
+				view.position = glm::vec3(0.0f, 0.0f, -distance);
+				view.rotationDegrees = glm::vec3(20.0f, 360.0f * (compareFrame ? 0 : frame) / std::max(frameCount, 1u), 0.0f);
+				view.usePhongShading = true;
+				FrameParameters frameParameters = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				unsigned int lod = automatic ? selectLod(renderModel, frameParameters, view.fovy, (float)height) : 0;
+				selectDrawRanges(renderModel, frameParameters, lod, false, ranges);
+				renderFrame(*shaderProgram, frameUniforms, *renderModel.mesh, frameParameters, false, ranges);
+				if(compareFrame){
+					pixels[automatic] = readPixels();
+					break;
+				}
+				context.swapBuffers();
+				std::chrono::duration<double> presented = std::chrono::high_resolution_clock::now() - start;
+				if(frame >= warmupFrames){
+					frameMilliseconds.push_back(presented.count() * 1000.0);
+					triangles += ranges.triangleCount;
+					lods += lod;
+				}
+			}
+			frameMedian[automatic] = percentile(frameMilliseconds, 50);
+			trianglesMean[automatic] = frameMilliseconds.empty() ? 0.0 : triangles / frameMilliseconds.size();
+			if(automatic){
+				lodMean = frameMilliseconds.empty() ? 0.0 : lods / frameMilliseconds.size();
+			}
+		}
+		double differing = differingPixels(pixels[0], pixels[1]);
+
+		std::cout << "distance " << distance << ": LOD " << lodMean << ", " << trianglesMean[1] << " of " << trianglesMean[0]
+			<< " triangles, " << frameMedian[1] << " ms vs " << frameMedian[0] << " ms per frame (p50), "
+			<< differing * 100.0 << "% pixels differ\n";
+		json << (first ? "" : ",") << "\n    { \"distance\": " << distance << ", \"lod\": " << lodMean
+			<< ", \"triangles\": " << trianglesMean[1] << ", \"fullTriangles\": " << trianglesMean[0]
+			<< ", \"frameMsP50\": " << frameMedian[1] << ", \"fullFrameMsP50\": " << frameMedian[0]
+			<< ", \"differingPixels\": " << differing << " }";
+		first = false;
+	}
+	json << "\n  ]\n}\n";
+
+	renderModel.mesh.reset();
+	shaderProgram.reset();
+	return writeJson(json.str(), jsonPath);
+}
+
+bool benchmarkHeadlessLoad(const std::string& model, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> shaderProgram = loadShaderProgram(layout);
+	if(!shaderProgram){
+		return false;
+	}
+	shaderProgram->use();
+	FrameUniforms frameUniforms(*shaderProgram);
+	if(frameUniforms.wasError()){
+		return false;
+	}
+
+	std::string cachePath = MeshCache("../data/objects/" + model + ".obj").getCachePath();
+	const size_t uploadBudgetBytes = 4 * 1024 * 1024;
+	ViewState view;
+	view.aspectRatio = (float)width / (float)height;
+	view.usePhongShading = true;
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"uploadBudgetBytes\": " << uploadBudgetBytes << ",\n";
+	json << "  \"runs\": [";
+
+	bool first = true;
+	bool identical = true;
+	for(int cached = 0; cached < 2; cached++){
+		std::vector<unsigned char> pixels[2];
+		for(int async = 0; async < 2; async++){
+			// Without a cache both paths parse the text; each run leaves the cache written
+			if(!cached){
+				std::error_code error;
+				std::filesystem::remove(cachePath, error);
+			}
+			glFinish();
+			auto start = std::chrono::high_resolution_clock::now();
+			auto sinceStart = [&](){
+				return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0;
+			};
+
+			double firstFrameMs = 0.0;
+			double firstTrianglesMs = 0.0;
+			double fullMeshMs = 0.0;
+			std::vector<double> frameMilliseconds;
+			RenderModel renderModel;
+			VisibleClusters ranges;
+			if(!async){
+				// Today's path: nothing is drawn until the model is loaded, prepared and uploaded
+				if(!loadRenderModel(model, layout, renderModel)){
+					return false;
+				}
+				FrameParameters frameParameters = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+				selectDrawRanges(renderModel, frameParameters, 0, false, ranges);
+				renderFrame(*shaderProgram, frameUniforms, *renderModel.mesh, frameParameters, false, ranges);
+				pixels[async] = readPixels();
+				context.swapBuffers();
+				firstFrameMs = firstTrianglesMs = fullMeshMs = sinceStart();
+				frameMilliseconds.push_back(fullMeshMs);
+			} else {
+				AsyncModelLoader loader(model, layout, true);
+				while(!renderModel.mesh){
+					auto frameStart = std::chrono::high_resolution_clock::now();
+					loader.update(renderModel, uploadBudgetBytes);
+					if(loader.wasError()){
+						return false;
+					}
+					FrameParameters frameParameters = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+					if(renderModel.mesh){
+						selectDrawRanges(renderModel, frameParameters, 0, false, ranges);
+						renderFrame(*shaderProgram, frameUniforms, *renderModel.mesh, frameParameters, false, ranges);
+						pixels[async] = readPixels();
+					} else {
+						renderFrame(*shaderProgram, frameUniforms, loader.getProgressiveMesh(), frameParameters, false);
+					}
+					context.swapBuffers();
+					frameMilliseconds.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - frameStart).count() * 1000.0);
+					if(frameMilliseconds.size() == 1){
+						firstFrameMs = sinceStart();
+					}
+					if(firstTrianglesMs == 0.0 && (renderModel.mesh || loader.getProgressiveMesh())){
+						firstTrianglesMs = sinceStart();
+					}
+					// A pbuffer swap doesn't wait for vsync; without it the frames would take the loader's cores
+					std::this_thread::sleep_until(frameStart + std::chrono::microseconds(16667));
+				}
+				fullMeshMs = sinceStart();
+			}
+			// The loader's thread may still be writing the cache; that happens after the full mesh is shown
+			renderModel.mesh.reset();
+
+			std::cout << (cached ? "cached, " : "uncached, ") << (async ? "async" : "sync") << ": first frame " << firstFrameMs
+				<< " ms, first triangles " << firstTrianglesMs << " ms, full mesh " << fullMeshMs << " ms, "
+				<< frameMilliseconds.size() << " frames (longest " << *std::max_element(frameMilliseconds.begin(), frameMilliseconds.end()) << " ms)\n";
+			json << (first ? "" : ",") << "\n    { \"cached\": " << (cached ? "true" : "false") << ", \"async\": " << (async ? "true" : "false")
+				<< ", \"firstFrameMs\": " << firstFrameMs << ", \"firstTrianglesMs\": " << firstTrianglesMs
+				<< ", \"fullMeshMs\": " << fullMeshMs << ", \"framesWhileLoading\": " << frameMilliseconds.size() << ",\n";
+			writeStats(json, "frameMs", frameMilliseconds, "      ");
+			json << "      \"cacheWritten\": " << (std::filesystem::exists(cachePath) ? "true" : "false") << " }";
+			first = false;
+		}
+
+		// Both paths build the same model, so the finished images must match
+		double differing = differingPixels(pixels[0], pixels[1]);
+		if(differing > 0.0){
+			std::cerr << "Error: async load renders " << differing * 100.0 << "% different pixels" << std::endl;
+			identical = false;
+		}
+	}
+	json << "\n  ]\n}\n";
+
+	shaderProgram.reset();
+	return writeJson(json.str(), jsonPath) && identical;
+}
+
+bool benchmarkHeadlessProgramCache(unsigned int repeats, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+
+	// A directory of its own, so clearing it for the cold runs leaves the application's cache alone
+	const std::string cacheDirectory = std::string(programCacheDirectory) + "/benchmark";
+	GLint formatCount = 0;
+	if(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary){
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"binaryFormats\": " << formatCount << ",\n";
+	json << "  \"repeats\": " << repeats << ",\n";
+	json << "  \"programs\": [";
+
+	const VertexLayout::Type layouts[] = { VertexLayout::Type::SEPARATE, VertexLayout::Type::INTERLEAVED, VertexLayout::Type::PACKED, VertexLayout::Type::QUANTIZED };
+	bool first = true;
+	bool consistent = true;
+	std::vector<double> totals[3];
+	for(VertexLayout::Type layout : layouts){
+		for(int instanced = 0; instanced < 2; instanced++){
+			ShaderData shaderData;
+			if(!readShaderSources(layout, instanced, shaderData)){
+				return false;
+			}
+
+			// Uncached compiles, cold compiles and stores, warm loads what cold stored
+			std::vector<double> milliseconds[3];
+			size_t warmHits = 0;
+			for(unsigned int repeat = 0; repeat < repeats; repeat++){
+				std::error_code error;
+				std::filesystem::remove_all(cacheDirectory, error);
+				size_t uniformCounts[3];
+				for(int pass = 0; pass < 3; pass++){
+					glFinish();
+					auto start = std::chrono::high_resolution_clock::now();
+					ShaderProgram program(shaderData, pass == 0 ? "" : cacheDirectory);
+					glFinish();
+					std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+					if(program.wasError()){
+						return false;
+					}
+					milliseconds[pass].push_back(elapsed.count() * 1000.0);
+					uniformCounts[pass] = program.getUniforms().size();
+					warmHits += pass == 2 && program.wasLoadedFromCache();
+				}
+				// A program from a binary has to expose the same interface as the compiled one
+				if(uniformCounts[1] != uniformCounts[0] || uniformCounts[2] != uniformCounts[0]){
+					consistent = false;
+				}
+			}
+			for(int pass = 0; pass < 3; pass++){
+				totals[pass].push_back(percentile(milliseconds[pass], 50));
+			}
+
+			std::string name = std::string(VertexLayout::name(layout)) + (instanced ? " instanced" : "");
+			std::cout << name << ": compile " << percentile(milliseconds[0], 50) << " ms, cold " << percentile(milliseconds[1], 50)
+				<< " ms, warm " << percentile(milliseconds[2], 50) << " ms (p50), " << warmHits << "/" << repeats << " warm loads hit\n";
+			json << (first ? "" : ",") << "\n    { \"program\": \"" << name << "\", \"warmHits\": " << warmHits << ",\n";
+			writeStats(json, "compileMs", milliseconds[0], "      ");
+			writeStats(json, "coldMs", milliseconds[1], "      ");
+			writeStats(json, "warmMs", milliseconds[2], "      ");
+			json << "      \"sourceBytes\": " << shaderData.vertexShaderCode.size() + shaderData.fragmentShaderCode.size() << " }";
+			first = false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::remove_all(cacheDirectory, error);
+
+	double sums[3] = {};
+	for(int pass = 0; pass < 3; pass++){
+		for(double value : totals[pass]){
+			sums[pass] += value;
+		}
+	}
+	std::cout << "All " << totals[0].size() << " programs: compile " << sums[0] << " ms, cold " << sums[1] << " ms, warm " << sums[2] << " ms\n";
+	json << "\n  ],\n";
+	json << "  \"totalCompileMs\": " << sums[0] << ", \"totalColdMs\": " << sums[1] << ", \"totalWarmMs\": " << sums[2] << "\n";
+	json << "}\n";
+	if(!consistent){
+		std::cerr << "Error: programs loaded from binaries report different uniforms" << std::endl;
+	}
+	return writeJson(json.str(), jsonPath) && consistent;
+}
+
+bool benchmarkHeadlessShading(const std::string& model, unsigned int frameCount, int targetWidth, int targetHeight, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	OffscreenTarget target(targetWidth, targetHeight);
+	if(target.wasError()){
+		return false;
+	}
+	target.bind();
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> uberProgram = loadShaderProgram(layout);
+	if(!uberProgram){
+		return false;
+	}
+	uberProgram->use();
+	FrameUniforms uberUniforms(*uberProgram, ShadingVariant::count);
+	if(uberUniforms.wasError()){
+		return false;
+	}
+	ShadingPrograms variantPrograms(layout);
+	RenderModel renderModel;
+	if(!loadRenderModel(model, layout, renderModel, false)){
+		return false;
+	}
+
+	unsigned int query;
+	glGenQueries(1, &query);
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"width\": " << targetWidth << ", \"height\": " << targetHeight << ",\n";
+	json << "  \"frames\": " << frameCount << ",\n";
+	json << "  \"modes\": [";
+
+	// The modes the keys select: none, gouraud, phong or flat shading, and the z buffer view
+	ShadingVariant modes[5];
+	modes[1].useGouraudShading = true;
+	modes[2].usePhongShading = true;
+	modes[3].useFlatShading = true;
+	modes[4].showZBuffer = true;
+
+	const unsigned int warmupFrames = std::min(3u, frameCount / 10);
+	VisibleClusters ranges;
+	bool first = true;
+	bool identical = true;
+	for(const ShadingVariant& mode : modes){
+		double frameMedian[2];
+		double gpuMedian[2];
+		std::vector<unsigned char> pixels[2];
+		for(int specialized = 0; specialized < 2; specialized++){
+			ShaderProgram* program = specialized ? variantPrograms.getProgram(mode) : uberProgram.get();
+			FrameUniforms* uniforms = specialized ? variantPrograms.getUniforms(mode) : &uberUniforms;
+			if(!program){
+				return false;
+			}
+			std::vector<double> frameMilliseconds;
+			std::vector<double> gpuMilliseconds;
+			for(unsigned int frame = 0; frame < frameCount; frame++){
+				// Close up, so the model fills the target and fragments dominate
+				ViewState view;
+				view.aspectRatio = (float)targetWidth / (float)targetHeight;
+				view.position = glm::vec3(0.0f, 0.0f, -2.0f);
+				view.rotationDegrees = glm::vec3(20.0f, 360.0f * frame / std::max(frameCount, 1u), 0.0f);
+				view.showZBuffer = mode.showZBuffer;
+				view.useGouraudShading = mode.useGouraudShading;
+				view.usePhongShading = mode.usePhongShading;
+				view.useFlatShading = mode.useFlatShading;
+				FrameParameters frameParameters = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+				selectDrawRanges(renderModel, frameParameters, 0, false, ranges);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				glBeginQuery(GL_TIME_ELAPSED, query);
+				renderFrame(*program, *uniforms, *renderModel.mesh, frameParameters, false, ranges);
+				glEndQuery(GL_TIME_ELAPSED);
+				glFinish();
+				std::chrono::duration<double> finished = std::chrono::high_resolution_clock::now() - start;
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+				if(frame == 0){
+					pixels[specialized] = target.readPixels();
+				}
+				if(frame >= warmupFrames){
+					frameMilliseconds.push_back(finished.count() * 1000.0);
+					gpuMilliseconds.push_back(nanoseconds / 1e6);
+				}
+			}
+			frameMedian[specialized] = percentile(frameMilliseconds, 50);
+			gpuMedian[specialized] = percentile(gpuMilliseconds, 50);
+		}
+
+		// Constants instead of uniforms must not change what is drawn
+		double differing = differingPixels(pixels[0], pixels[1]);
+		if(differing > 0.001){
+			std::cerr << "Error: the " << mode.name() << " variant renders " << differing * 100.0 << "% different pixels" << std::endl;
+			identical = false;
+		}
+		std::cout << mode.name() << ": " << frameMedian[1] << " ms specialized vs " << frameMedian[0] << " ms branching (p50 frame), GPU "
+			<< gpuMedian[1] << " vs " << gpuMedian[0] << " ms, " << differing * 100.0 << "% pixels differ\n";
+		json << (first ? "" : ",") << "\n    { \"mode\": \"" << mode.name() << "\", \"frameMsP50\": " << frameMedian[1]
+			<< ", \"branchingFrameMsP50\": " << frameMedian[0] << ", \"gpuMsP50\": " << gpuMedian[1]
+			<< ", \"branchingGpuMsP50\": " << gpuMedian[0] << ", \"differingPixels\": " << differing << " }";
+		first = false;
+	}
+	json << "\n  ]\n}\n";
+	glDeleteQueries(1, &query);
+
+	renderModel.mesh.reset();
+	return writeJson(json.str(), jsonPath) && identical;
+}
+
+bool benchmarkHeadlessIdle(const std::string& model, double phaseSeconds, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> program = loadShaderProgram(layout);
+	if(!program){
+		return false;
+	}
+	program->use();
+	FrameUniforms uniforms(*program);
+	if(uniforms.wasError()){
+		return false;
+	}
+	RenderModel renderModel;
+	if(!loadRenderModel(model, layout, renderModel, false)){
+		return false;
+	}
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"layout\": \"" << VertexLayout::name(layout) << "\",\n";
+	json << "  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"phaseSeconds\": " << phaseSeconds << ",\n";
+	json << "  \"runs\": [";
+
+	// A pbuffer swap doesn't wait for vsync, so both loops sleep to the next 60 Hz tick after a
+	// frame, and a sleep stands in for glfwWaitEventsTimeout when the on demand loop has nothing to draw
+	const auto frameInterval = std::chrono::microseconds(16667);
+	const auto idleTimeout = std::chrono::milliseconds(500);
+	VisibleClusters ranges;
+	bool first = true;
+	bool matching = true;
+	for(int onDemand = 0; onDemand < 2; onDemand++){
+		for(int interacting = 1; interacting >= 0; interacting--){
+			ViewState view;
+			view.aspectRatio = (float)width / (float)height;
+			FrameParameters parameters = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+			unsigned int frames = 0;
+			unsigned long long recomputed = 0;
+			unsigned int tick = 0;
+
+			std::clock_t cpuStart = std::clock();
+			auto wallStart = std::chrono::high_resolution_clock::now();
+			auto phaseEnd = wallStart + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(phaseSeconds));
+			while(std::chrono::high_resolution_clock::now() < phaseEnd){
+				auto frameStart = std::chrono::high_resolution_clock::now();
+
+				// Scripted input: interacting turns the model every tick and switches shading every second
+				unsigned int changes = 0;
+				if(interacting){
+					view.rotationDegrees.y += 1.5f;
+					changes |= VIEW_CHANGE_MODEL;
+					if(tick % 60 == 0){
+						view.usePhongShading = !view.usePhongShading;
+						changes |= VIEW_CHANGE_SHADING;
+					}
+				}
+				tick++;
+
+				if(onDemand){
+					if(changes == 0){
+						std::this_thread::sleep_until(std::min(frameStart + idleTimeout, phaseEnd));
+						continue;
+					}
+					updateFrameParameters(view, renderModel.vertexData.positionDequantization, changes, parameters);
+					recomputed += ((changes & VIEW_CHANGE_MODEL) != 0) + ((changes & VIEW_CHANGE_PROJECTION) != 0) + ((changes & VIEW_CHANGE_SHADING) != 0);
+
+					// The parts left alone must still match a full recompute
+					FrameParameters full = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+					if(memcmp(&full, &parameters, sizeof(FrameParameters)) != 0){
+						matching = false;
+					}
+				} else {
+					// The loop before render on demand: recompute everything and draw every frame
+					parameters = computeFrameParameters(view, renderModel.vertexData.positionDequantization);
+					recomputed += 3;
+				}
+
+				selectDrawRanges(renderModel, parameters, 0, false, ranges);
+				renderFrame(*program, uniforms, *renderModel.mesh, parameters, false, ranges);
+				context.swapBuffers();
+				frames++;
+				std::this_thread::sleep_until(frameStart + frameInterval);
+			}
+			double wallSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - wallStart).count();
+			double cpuPercent = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC / wallSeconds * 100.0;
+
+			const char* loop = onDemand ? "on demand" : "continuous";
+			const char* phase = interacting ? "interacting" : "idle";
+			std::cout << loop << ", " << phase << ": " << cpuPercent << "% CPU, " << frames << " frames, "
+				<< recomputed << " parameter parts recomputed in " << wallSeconds << " s\n";
+			json << (first ? "" : ",") << "\n    { \"loop\": \"" << loop << "\", \"phase\": \"" << phase << "\", \"cpuPercent\": " << cpuPercent
+				<< ", \"frames\": " << frames << ", \"partsRecomputed\": " << recomputed << ", \"seconds\": " << wallSeconds << " }";
+			first = false;
+		}
+	}
+	json << "\n  ]\n}\n";
+
+	if(!matching){
+		std::cerr << "Error: incrementally updated frame parameters differ from a full recompute" << std::endl;
+	}
+	renderModel.mesh.reset();
+	return writeJson(json.str(), jsonPath) && matching;
+}
+
+bool benchmarkHeadlessSoftware(const std::string& model, unsigned int frameCount, int targetWidth, int targetHeight, VertexLayout::Type layout, const std::string& jsonPath){
+	HeadlessContext context;
+	if(context.wasError()){
+		return false;
+	}
+	OffscreenTarget target(targetWidth, targetHeight);
+	if(target.wasError()){
+		return false;
+	}
+	target.bind();
+	glEnable(GL_DEPTH_TEST);
+
+	std::unique_ptr<ShaderProgram> shaderProgram = loadShaderProgram(layout);
+	if(!shaderProgram){
+		return false;
+	}
+	shaderProgram->use();
+	FrameUniforms frameUniforms(*shaderProgram);
+	if(frameUniforms.wasError()){
+		return false;
+	}
+	RenderModel renderModel;
+	if(!loadRenderModel(model, layout, renderModel, false)){
+		return false;
+	}
+	// The software path draws the indexed triangles as read, without the GPU layout's dequantization
+	ObjReader objReader;
+	ObjData mesh;
+	if(!objReader.readObjCached(model, mesh, true)){
+		return false;
+	}
+
+	unsigned int hardwareThreads = resolveThreadCount(0);
+	SoftwareRasterizer rasterizer(targetWidth, targetHeight, hardwareThreads);
+
+	// Close up and turning, as in benchmarkHeadlessShading
+	auto frameView = [&](unsigned int frame, const ShadingVariant& mode){
+		ViewState view;
+		view.aspectRatio = (float)targetWidth / (float)targetHeight;
+		view.position = glm::vec3(0.0f, 0.0f, -2.0f);
+		view.rotationDegrees = glm::vec3(20.0f, 360.0f * frame / std::max(frameCount, 1u), 0.0f);
+		view.showZBuffer = mode.showZBuffer;
+		view.useGouraudShading = mode.useGouraudShading;
+		view.usePhongShading = mode.usePhongShading;
+		view.useFlatShading = mode.useFlatShading;
+		return view;
+	};
+	auto timeSoftware = [&](SoftwareRasterizer& software, const ShadingVariant& mode){
+		std::vector<double> milliseconds;
+		for(unsigned int frame = 0; frame < frameCount; frame++){
+			FrameParameters frameParameters = computeFrameParameters(frameView(frame, mode), glm::mat4(1.0f));
+			auto start = std::chrono::high_resolution_clock::now();
+			software.render(mesh, frameParameters);
+			std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+			milliseconds.push_back(elapsed.count() * 1000.0);
+		}
+		return milliseconds;
+	};
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"model\": \"" << jsonEscape(model) << "\",\n";
+	json << "  \"triangles\": " << mesh.vertexIndices.size() / 3 << ",\n";
+	json << "  \"reference\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	json << "  \"width\": " << targetWidth << ", \"height\": " << targetHeight << ",\n";
+	json << "  \"frames\": " << frameCount << ",\n";
+	json << "  \"threads\": " << hardwareThreads << ",\n";
+	json << "  \"modes\": [";
+
+	ShadingVariant modes[5];
+	modes[1].useGouraudShading = true;
+	modes[2].usePhongShading = true;
+	modes[3].useFlatShading = true;
+	modes[4].showZBuffer = true;
+
+	VisibleClusters ranges;
+	bool first = true;
+	bool matching = true;
+	for(const ShadingVariant& mode : modes){
+		// The first frame through GL is the reference image
+		FrameParameters glParameters = computeFrameParameters(frameView(0, mode), renderModel.vertexData.positionDequantization);
+		selectDrawRanges(renderModel, glParameters, 0, false, ranges);
+		auto start = std::chrono::high_resolution_clock::now();
+		renderFrame(*shaderProgram, frameUniforms, *renderModel.mesh, glParameters, false, ranges);
+		glFinish();
+		std::chrono::duration<double> glElapsed = std::chrono::high_resolution_clock::now() - start;
+		std::vector<unsigned char> reference = target.readPixels();
+
+		rasterizer.render(mesh, computeFrameParameters(frameView(0, mode), glm::mat4(1.0f)));
+		double differing = differingPixels(reference, rasterizer.getPixels());
+		if(differing > 0.01){
+			std::cerr << "Error: the software " << mode.name() << " image differs from GL in " << differing * 100.0 << "% of the pixels, see software-"
+				<< mode.name() << ".ppm and gl-" << mode.name() << ".ppm" << std::endl;
+			writePpm("software-" + mode.name() + ".ppm", rasterizer.getPixels(), targetWidth, targetHeight);
+			writePpm("gl-" + mode.name() + ".ppm", reference, targetWidth, targetHeight);
+			matching = false;
+		}
+
+		std::vector<double> milliseconds = timeSoftware(rasterizer, mode);
+		SoftwareRasterizer::Stats stats = rasterizer.getStats();
+		std::cout << mode.name() << ": " << percentile(milliseconds, 50) << " ms p50 on " << hardwareThreads << " threads (GL reference "
+			<< glElapsed.count() * 1000.0 << " ms), " << differing * 100.0 << "% pixels differ, " << stats.trianglesSetUp << " triangles set up, "
+			<< stats.blocksRejectedByDepth << " of " << stats.blocksTested << " blocks rejected by depth\n";
+		json << (first ? "" : ",") << "\n    { \"mode\": \"" << mode.name() << "\", \"msP50\": " << percentile(milliseconds, 50)
+			<< ", \"msP95\": " << percentile(milliseconds, 95) << ", \"glReferenceMs\": " << glElapsed.count() * 1000.0
+			<< ", \"differingPixels\": " << differing << ", \"trianglesSetUp\": " << stats.trianglesSetUp
+			<< ", \"trianglesClipped\": " << stats.trianglesClipped << ", \"binnedTriangles\": " << stats.binnedTriangles
+			<< ", \"blocksTested\": " << stats.blocksTested << ", \"blocksRejectedByDepth\": " << stats.blocksRejectedByDepth
+			<< ", \"pixelsShaded\": " << stats.pixelsShaded << " }";
+		first = false;
+	}
+	json << "\n  ],\n";
+
+	// Phong on 1, 2, 4, ... threads up to all of them; tiles keep the triangle order, so every
+	// thread count has to give the same image
+	json << "  \"scaling\": [";
+	double oneThread = 0.0;
+	std::vector<unsigned char> oneThreadPixels;
+	first = true;
+	for(unsigned int threads = 1; ; threads = std::min(threads * 2, hardwareThreads)){
+		SoftwareRasterizer software(targetWidth, targetHeight, threads);
+		double median = percentile(timeSoftware(software, modes[2]), 50);
+		if(threads == 1){
+			oneThread = median;
+			oneThreadPixels = software.getPixels();
+		} else if(software.getPixels() != oneThreadPixels){
+			std::cerr << "Error: the software image on " << threads << " threads differs from the one on 1 thread" << std::endl;
+			matching = false;
+		}
+		std::cout << "  " << threads << " threads: " << median << " ms (" << oneThread / median << "x)\n";
+		json << (first ? "" : ",") << "\n    { \"threads\": " << threads << ", \"msP50\": " << median << ", \"speedup\": " << oneThread / median << " }";
+		first = false;
+		if(threads == hardwareThreads){
+			break;
+		}
+	}
+	json << "\n  ]\n}\n";
+
+	renderModel.mesh.reset();
+	return writeJson(json.str(), jsonPath) && matching;
+}
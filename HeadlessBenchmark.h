@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include "VertexLayout.h"
+
+// Renders frameCount frames of a model along a scripted camera path into an offscreen EGL
+// pbuffer (works on Mesa llvmpipe without a GPU or display). Reports per frame CPU submit time,
+// frame time up to the end of the swap and GL_TIME_ELAPSED GPU time, each with mean, p50, p95,
+// p99 and max, as JSON to jsonPath or stdout.
+bool benchmarkHeadlessRender(const std::string& model, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Renders a scene with every GpuScene draw mode: naive per instance draws, one instanced draw
+// per model and one multi draw indirect. scene names ../data/scenes/<scene>.scene, or is a comma
+// separated list of models placed instanceCount times on a grid. Reports draw calls, GL calls and
+// CPU/frame times per mode as JSON, and fails when a mode renders a different image than naive.
+bool benchmarkHeadlessScene(const std::string& scene, unsigned int instanceCount, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Renders a model along a zoomed in camera path (narrow field of view panning over the surface)
+// once drawing every triangle and once drawing only the clusters the BVH finds in the frustum.
+// Reports triangles submitted, cull time and CPU/frame times per pass as JSON, and fails when
+// culling changes the image.
+bool benchmarkHeadlessCulling(const std::string& model, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Builds the model's LOD chain, then renders it turning in front of the camera at several
+// distances, once at full detail and once at the level selectLod picks. Reports the chain's
+// triangle counts and errors, and per distance the level, triangles, frame times and the share of
+// pixels that differ from full detail, as JSON.
+bool benchmarkHeadlessLod(const std::string& model, unsigned int frameCount, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Times loading a model until its first frame, its first triangles and the full mesh are shown,
+// once the synchronous way (loadRenderModel, then draw) and once with AsyncModelLoader drawing
+// while it loads, each without and with a fresh mesh cache. Reports the times and the frames
+// drawn while loading as JSON, and fails when the two paths end in different images.
+bool benchmarkHeadlessLoad(const std::string& model, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Creates every shader program the renderer uses (each layout, plain and instanced) repeats times:
+// compiled without the binary cache, cold (compiled and stored) and warm (loaded from what cold
+// stored). Reports p50 and spread per program and the totals as JSON, and fails when a program
+// loaded from a binary exposes different uniforms. Mesa's own shader cache makes compiles after
+// the first faster; MESA_SHADER_CACHE_DISABLE=true times them from scratch.
+bool benchmarkHeadlessProgramCache(unsigned int repeats, const std::string& jsonPath);
+
+// Renders a model close up into a targetWidth x targetHeight framebuffer, so frames are bound by
+// fragment shading, in each mode the keys select: once with the shader branching on the uploaded
+// flags and once with the ShadingVariant program for the mode. Reports frame (to glFinish) and
+// GPU times per mode as JSON, and fails when a variant renders a different image.
+bool benchmarkHeadlessShading(const std::string& model, unsigned int frameCount, int targetWidth, int targetHeight, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Runs the render loop for phaseSeconds with scripted input (turning the model every frame and
+// switching shading) and for phaseSeconds without input, once the continuous way (every frame
+// recomputes all frame parameters and draws) and once on demand (only changed parts recomputed,
+// nothing drawn without a change). Reports CPU utilization, frames and parameter parts recomputed
+// per loop and phase as JSON, and fails when the incremental parameters differ from a full recompute.
+bool benchmarkHeadlessIdle(const std::string& model, double phaseSeconds, VertexLayout::Type layout, const std::string& jsonPath);
+
+// Renders a model close up into a targetWidth x targetHeight framebuffer with the SoftwareRasterizer
+// in each shading mode, and once through GL as the reference image. Reports the software frame
+// times per mode on all hardware threads and, in Phong, per thread count as JSON, and fails when a
+// mode differs from GL in more than 1% of the pixels (writing both images as PPM).
+bool benchmarkHeadlessSoftware(const std::string& model, unsigned int frameCount, int targetWidth, int targetHeight, VertexLayout::Type layout, const std::string& jsonPath);
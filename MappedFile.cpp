@@ -0,0 +1,106 @@
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "MappedFile.h"
+
+
+// Map the file read-only. An empty file maps to a null view of size 0, which is not an error.
+MappedFile::MappedFile(const std::string& path) {
+	fileData = nullptr;
+	fileSize = 0;
+	errorFlag = false;
+
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(fileHandle == INVALID_HANDLE_VALUE){
+		std::cerr << "Error: Cannot open file " << path << std::endl;
+		errorFlag = true;
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(fileHandle, &size)){
+		std::cerr << "Error: Cannot read size of file " << path << std::endl;
+		errorFlag = true;
+		return;
+	}
+	fileSize = (size_t)size.QuadPart;
+	if(fileSize == 0){
+		return;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mappingHandle == NULL){
+		std::cerr << "Error: Cannot map file " << path << std::endl;
+		errorFlag = true;
+		return;
+	}
+	fileData = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if(fileData == nullptr){
+		std::cerr << "Error: Cannot map file " << path << std::endl;
+		errorFlag = true;
+	}
+#else
+	fileDescriptor = open(path.c_str(), O_RDONLY);
+	if(fileDescriptor < 0){
+		std::cerr << "Error: Cannot open file " << path << std::endl;
+		errorFlag = true;
+		return;
+	}
+
+	struct stat status;
+	if(fstat(fileDescriptor, &status) != 0){
+		std::cerr << "Error: Cannot read size of file " << path << std::endl;
+		errorFlag = true;
+		return;
+	}
+	fileSize = (size_t)status.st_size;
+	if(fileSize == 0){
+		return;
+	}
+
+	void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if(mapping == MAP_FAILED){
+		std::cerr << "Error: Cannot map file " << path << std::endl;
+		errorFlag = true;
+		fileSize = 0;
+		return;
+	}
+	// Parsers walk the file front to back, so let the kernel read ahead aggressively.
+	madvise(mapping, fileSize, MADV_SEQUENTIAL);
+	fileData = (const char*)mapping;
+#endif
+}
+
+MappedFile::~MappedFile(){
+#ifdef _WIN32
+	if(fileData != nullptr){
+		UnmapViewOfFile(fileData);
+	}
+	if(mappingHandle != NULL){
+		CloseHandle(mappingHandle);
+	}
+	if(fileHandle != INVALID_HANDLE_VALUE){
+		CloseHandle(fileHandle);
+	}
+#else
+	if(fileData != nullptr){
+		munmap((void*)fileData, fileSize);
+	}
+	if(fileDescriptor >= 0){
+		close(fileDescriptor);
+	}
+#endif
+}
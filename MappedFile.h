@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+// The mapping lives as long as the object, so views into data() must not outlive it.
+class MappedFile {
+	public:
+		MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool wasError() { return errorFlag; }
+		const char* data() const { return fileData; }
+		size_t size() const { return fileSize; }
+
+	private:
+		const char* fileData;
+		size_t fileSize;
+		bool errorFlag;
+
+#ifdef _WIN32
+		void* fileHandle;
+		void* mappingHandle;
+#else
+		int fileDescriptor;
+#endif
+};
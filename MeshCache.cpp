@@ -0,0 +1,206 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <functional>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "Trace.h"
+
+namespace {
+	const char cacheMagic[8] = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+	// Bump whenever the layout or the parser output changes
+	const uint32_t cacheVersion = 3;
+	const uint32_t byteOrderMark = 0x01020304;
+	const size_t sampleSize = 64 * 1024;
+	const size_t arrayAlignment = 16;
+
+	size_t alignUp(size_t offset){
+		return (offset + arrayAlignment - 1) & ~(arrayAlignment - 1);
+	}
+
+	template <typename T>
+	void writeArray(std::ofstream& out, const std::vector<T>& array, size_t& offset){
+		static const char padding[arrayAlignment] = {};
+		size_t aligned = alignUp(offset);
+		out.write(padding, aligned - offset);
+		out.write((const char*)array.data(), array.size() * sizeof(T));
+		offset = aligned + array.size() * sizeof(T);
+	}
+
+	template <typename T>
+	bool readArray(const MappedFile& file, std::vector<T>& array, uint64_t count, size_t& offset){
+		// count comes from the file, so it is checked before it is multiplied (which could wrap)
+		size_t aligned = alignUp(offset);
+		if(aligned > file.size() || count > (file.size() - aligned) / sizeof(T)){
+			return false;
+		}
+		size_t bytes = (size_t)count * sizeof(T);
+		array.resize((size_t)count);
+		memcpy(array.data(), file.data() + aligned, bytes);
+		offset = aligned + bytes;
+		return true;
+	}
+
+	// Process and thread of the writer, so concurrent stores never share a temporary file
+	std::string writerSuffix(){
+#ifdef _WIN32
+		int processId = _getpid();
+#else
+		int processId = (int)getpid();
+#endif
+		return "." + std::to_string(processId) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	}
+}
+
+// Identify the source without reading all of it: size, mtime and a hash of its head and tail
+MeshCache::MeshCache(const std::string& sourcePath) {
+	this->sourcePath = sourcePath;
+	cachePath = sourcePath + ".meshcache";
+	sourceSize = 0;
+	sourceModified = 0;
+	sourceHash = 0;
+	errorFlag = false;
+
+	std::error_code error;
+	sourceSize = std::filesystem::file_size(sourcePath, error);
+	if(!error){
+		sourceModified = (int64_t)std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+	}
+	if(error){
+		errorFlag = true;
+		return;
+	}
+
+	std::ifstream source(sourcePath, std::ios::binary);
+	std::vector<char> sample(sampleSize);
+	source.read(sample.data(), sample.size());
+	sourceHash = fnv1a64(sample.data(), (size_t)source.gcount());
+	if(sourceSize > sampleSize){
+		source.clear();
+		source.seekg(sourceSize > 2 * sampleSize ? sourceSize - sampleSize : sampleSize);
+		source.read(sample.data(), sample.size());
+		sourceHash = fnv1a64(sample.data(), (size_t)source.gcount(), sourceHash);
+	}
+	if(source.bad()){
+		errorFlag = true;
+	}
+}
+
+void MeshCache::fillHeader(Header& header, const ObjData& data, bool breakIntoTris, bool optimized){
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.byteOrder = byteOrderMark;
+	header.flags = (breakIntoTris ? 1 : 0) | (optimized ? 2 : 0);
+	header.sourceSize = sourceSize;
+	header.sourceModified = sourceModified;
+	header.sourceHash = sourceHash;
+	header.counts[0] = data.vertices.size();
+	header.counts[1] = data.uvs.size();
+	header.counts[2] = data.normals.size();
+	header.counts[3] = data.verticesPerFaceCounts.size();
+	header.counts[4] = data.vertexIndices.size();
+	header.counts[5] = data.uvIndices.size();
+	header.counts[6] = data.normalIndices.size();
+}
+
+bool MeshCache::load(ObjData& outData, bool breakIntoTris, bool optimized){
+	if(errorFlag || !std::filesystem::exists(cachePath)){
+		return false;
+	}
+
+	TraceScope trace("MeshCache::load");
+	MappedFile file(cachePath);
+	if(file.wasError() || file.size() < sizeof(Header)){
+		return false;
+	}
+	trace.setBytes(file.size());
+
+	Header expected;
+	fillHeader(expected, ObjData(), breakIntoTris, optimized);
+	Header header;
+	memcpy(&header, file.data(), sizeof(Header));
+	if(memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+		|| header.version != expected.version
+		|| header.byteOrder != expected.byteOrder
+		|| header.flags != expected.flags
+		|| header.sourceSize != expected.sourceSize
+		|| header.sourceModified != expected.sourceModified
+		|| header.sourceHash != expected.sourceHash){
+		return false;
+	}
+
+	ObjData data;
+	size_t offset = sizeof(Header);
+	if(!readArray(file, data.vertices, header.counts[0], offset)
+		|| !readArray(file, data.uvs, header.counts[1], offset)
+		|| !readArray(file, data.normals, header.counts[2], offset)
+		|| !readArray(file, data.verticesPerFaceCounts, header.counts[3], offset)
+		|| !readArray(file, data.vertexIndices, header.counts[4], offset)
+		|| !readArray(file, data.uvIndices, header.counts[5], offset)
+		|| !readArray(file, data.normalIndices, header.counts[6], offset)){
+		std::cerr << "Warning: Truncated mesh cache " << cachePath << std::endl;
+		return false;
+	}
+
+	outData = std::move(data);
+	return true;
+}
+
+// Write to a temporary file and rename it over the cache so a reader never sees half a file
+bool MeshCache::store(const ObjData& data, bool breakIntoTris, bool optimized){
+	if(errorFlag){
+		return false;
+	}
+
+	TraceScope trace("MeshCache::store");
+	Header header;
+	fillHeader(header, data, breakIntoTris, optimized);
+
+	std::string tempPath = cachePath + writerSuffix() + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if(!out.is_open()){
+			std::cerr << "Warning: Cannot write mesh cache " << cachePath << std::endl;
+			return false;
+		}
+
+		out.write((const char*)&header, sizeof(header));
+		size_t offset = sizeof(header);
+		writeArray(out, data.vertices, offset);
+		writeArray(out, data.uvs, offset);
+		writeArray(out, data.normals, offset);
+		writeArray(out, data.verticesPerFaceCounts, offset);
+		writeArray(out, data.vertexIndices, offset);
+		writeArray(out, data.uvIndices, offset);
+		writeArray(out, data.normalIndices, offset);
+		trace.setBytes(offset);
+
+		if(!out.good()){
+			std::cerr << "Warning: Cannot write mesh cache " << cachePath << std::endl;
+			out.close();
+			std::filesystem::remove(tempPath);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if(error){
+		std::cerr << "Warning: Cannot write mesh cache " << cachePath << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "ObjData.h"
+
+// Binary sidecar of an indexed ObjData, stored next to the source as <file>.meshcache.
+// The header records the source size, modification time and a hash of its first and
+// last 64 KB; any mismatch (or another format version) makes the cache stale.
+// Arrays are stored raw after the header so loading is a straight copy out of the mapping.
+class MeshCache {
+	public:
+		MeshCache(const std::string& sourcePath);
+
+		// False if there is no cache, it is stale, or was written with a different breakIntoTris or
+		// optimized (triangles reordered by ObjReader::optimizeTriangleOrder)
+		bool load(ObjData& outData, bool breakIntoTris, bool optimized = false);
+		bool store(const ObjData& data, bool breakIntoTris, bool optimized = false);
+
+		bool wasError() { return errorFlag; }
+		const std::string& getCachePath() { return cachePath; }
+
+	private:
+		class Header {
+			public:
+				char magic[8];
+				uint32_t version;
+				uint32_t byteOrder;
+				uint32_t flags;
+				uint32_t reserved;
+				uint64_t sourceSize;
+				int64_t sourceModified;
+				uint64_t sourceHash;
+				uint64_t counts[7];
+		};
+
+		std::string sourcePath;
+		std::string cachePath;
+		uint64_t sourceSize;
+		int64_t sourceModified;
+		uint64_t sourceHash;
+		bool errorFlag;
+
+		void fillHeader(Header& header, const ObjData& data, bool breakIntoTris, bool optimized);
+};
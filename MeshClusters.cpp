@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+
+#include "MeshClusters.h"
+#include "Parallel.h"
+#include "MeshOptimizer.h"
+
+namespace {
+	// Spread the low 10 bits of value so there are two zero bits between each
+	uint32_t expandBits(uint32_t value){
+		value = (value * 0x00010001u) & 0xFF0000FFu;
+		value = (value * 0x00000101u) & 0x0F00F00Fu;
+		value = (value * 0x00000011u) & 0xC30C30C3u;
+		value = (value * 0x00000005u) & 0x49249249u;
+		return value;
+	}
+
+	// 30 bit Morton code of a point in [0,1]^3
+	uint32_t mortonCode(const glm::vec3& unit){
+		uint32_t x = (uint32_t)std::min(std::max(unit.x * 1024.0f, 0.0f), 1023.0f);
+		uint32_t y = (uint32_t)std::min(std::max(unit.y * 1024.0f, 0.0f), 1023.0f);
+		uint32_t z = (uint32_t)std::min(std::max(unit.z * 1024.0f, 0.0f), 1023.0f);
+		return (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+	}
+
+	// Depth first; returns the index of the node covering the range
+	unsigned int buildNode(MeshClusters& clusters, unsigned int firstCluster, unsigned int clusterCount){
+		unsigned int index = clusters.nodes.size();
+		clusters.nodes.push_back(ClusterNode());
+		ClusterNode node;
+		node.firstCluster = firstCluster;
+		node.clusterCount = clusterCount;
+		node.right = 0;
+		if(clusterCount == 1){
+			node.min = clusters.clusters[firstCluster].min;
+			node.max = clusters.clusters[firstCluster].max;
+		} else {
+			// Clusters are in Morton order, so each half of the range is spatially coherent
+			unsigned int leftCount = clusterCount / 2;
+			unsigned int left = buildNode(clusters, firstCluster, leftCount);
+			node.right = buildNode(clusters, firstCluster + leftCount, clusterCount - leftCount);
+			node.min = glm::min(clusters.nodes[left].min, clusters.nodes[node.right].min);
+			node.max = glm::max(clusters.nodes[left].max, clusters.nodes[node.right].max);
+		}
+		clusters.nodes[index] = node;
+		return index;
+	}
+
+	enum class Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+	Containment classifyBox(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max){
+		Containment result = Containment::INSIDE;
+		for(const glm::vec4& plane : frustum.planes){
+			// Corner furthest along the plane normal, and the one furthest against it
+			glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+			glm::vec3 negative(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y, plane.z >= 0.0f ? min.z : max.z);
+			if(glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f){
+				return Containment::OUTSIDE;
+			}
+			if(glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f){
+				result = Containment::INTERSECTING;
+			}
+		}
+		return result;
+	}
+
+	bool sphereOutside(const Frustum& frustum, const glm::vec3& center, float radius){
+		for(const glm::vec4& plane : frustum.planes){
+			if(glm::dot(glm::vec3(plane), center) + plane.w < -radius){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void addVisible(const MeshClusters& clusters, unsigned int firstCluster, unsigned int clusterCount, VisibleClusters& visible){
+		const MeshCluster& first = clusters.clusters[firstCluster];
+		const MeshCluster& last = clusters.clusters[firstCluster + clusterCount - 1];
+		unsigned int indexCount = last.firstIndex + last.indexCount - first.firstIndex;
+		if(!visible.counts.empty() && visible.firstIndices.back() + visible.counts.back() == first.firstIndex){
+			visible.counts.back() += indexCount;
+		} else {
+			visible.firstIndices.push_back(first.firstIndex);
+			visible.counts.push_back(indexCount);
+		}
+		visible.triangleCount += indexCount / 3;
+		visible.clusterCount += clusterCount;
+	}
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& clip){
+	// Rows of the matrix; a point is inside when -w <= x, y, z <= w in clip space
+	glm::vec4 rows[4];
+	for(int row = 0; row < 4; row++){
+		rows[row] = glm::vec4(clip[0][row], clip[1][row], clip[2][row], clip[3][row]);
+	}
+	Frustum frustum;
+	for(int axis = 0; axis < 3; axis++){
+		frustum.planes[axis * 2] = rows[3] + rows[axis];
+		frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+	}
+	// Unit normals, so sphere radii can be compared against plane distances
+	for(glm::vec4& plane : frustum.planes){
+		float length = glm::length(glm::vec3(plane));
+		if(length > 0.0f){
+			plane = plane / length;
+		}
+	}
+	return frustum;
+}
+
+void VisibleClusters::clear(){
+	counts.clear();
+	firstIndices.clear();
+	triangleCount = 0;
+	clusterCount = 0;
+	nodesVisited = 0;
+}
+
+void buildMeshClusters(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices, MeshClusters& outClusters,
+	unsigned int maxTriangles, unsigned int threadCount){
+	outClusters.clusters.clear();
+	outClusters.nodes.clear();
+	size_t triangleCount = indices.size() / 3;
+	outClusters.triangleCount = triangleCount;
+	if(triangleCount == 0){
+		return;
+	}
+	maxTriangles = std::max(maxTriangles, 1u);
+
+	glm::vec3 centroidMin(FLT_MAX);
+	glm::vec3 centroidMax(-FLT_MAX);
+	std::vector<glm::vec3> centroids(triangleCount);
+	for(size_t triangle = 0; triangle < triangleCount; triangle++){
+		const unsigned int* corners = &indices[triangle * 3];
+		centroids[triangle] = (positions[corners[0]] + positions[corners[1]] + positions[corners[2]]) / 3.0f;
+		centroidMin = glm::min(centroidMin, centroids[triangle]);
+		centroidMax = glm::max(centroidMax, centroids[triangle]);
+	}
+
+	// Morton code in the high 32 bits, triangle in the low, so one sort orders both
+	glm::vec3 extent = glm::max(centroidMax - centroidMin, glm::vec3(FLT_MIN));
+	std::vector<uint64_t> keys(triangleCount);
+	parallelForRange(triangleCount, 65536, threadCount, [&](size_t begin, size_t end){
+		for(size_t triangle = begin; triangle < end; triangle++){
+			keys[triangle] = ((uint64_t)mortonCode((centroids[triangle] - centroidMin) / extent) << 32) | triangle;
+		}
+	});
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<unsigned int> sortedIndices(indices.size());
+	parallelForRange(triangleCount, 65536, threadCount, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			size_t triangle = keys[i] & 0xFFFFFFFFu;
+			sortedIndices[i * 3] = indices[triangle * 3];
+			sortedIndices[i * 3 + 1] = indices[triangle * 3 + 1];
+			sortedIndices[i * 3 + 2] = indices[triangle * 3 + 2];
+		}
+	});
+	indices.swap(sortedIndices);
+
+	// Morton order keeps a cluster's triangles close in space but not in vertex cache order, so
+	// each cluster is reordered on its own (optimizeVertexCache over its local vertex numbers)
+	size_t clusterCount = (triangleCount + maxTriangles - 1) / maxTriangles;
+	parallelFor(clusterCount, threadCount, [&](size_t clusterIndex){
+		size_t firstIndex = clusterIndex * maxTriangles * 3;
+		size_t endIndex = std::min<size_t>((clusterIndex + 1) * maxTriangles, triangleCount) * 3;
+		std::vector<unsigned int> vertices(indices.begin() + firstIndex, indices.begin() + endIndex);
+		std::sort(vertices.begin(), vertices.end());
+		vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+		std::vector<unsigned int> local(endIndex - firstIndex);
+		for(size_t i = firstIndex; i < endIndex; i++){
+			local[i - firstIndex] = (unsigned int)(std::lower_bound(vertices.begin(), vertices.end(), indices[i]) - vertices.begin());
+		}
+
+		std::vector<unsigned int> triangleOrder;
+		std::vector<unsigned int> runStarts;
+		optimizeVertexCache(local, vertices.size(), triangleOrder, runStarts);
+		for(size_t i = 0; i < triangleOrder.size(); i++){
+			for(size_t c = 0; c < 3; c++){
+				indices[firstIndex + i * 3 + c] = vertices[local[triangleOrder[i] * 3 + c]];
+			}
+		}
+	});
+
+	outClusters.clusters.resize(clusterCount);
+	parallelFor(clusterCount, threadCount, [&](size_t clusterIndex){
+		MeshCluster& cluster = outClusters.clusters[clusterIndex];
+		size_t firstTriangle = clusterIndex * maxTriangles;
+		size_t endTriangle = std::min(firstTriangle + maxTriangles, triangleCount);
+		cluster.firstIndex = firstTriangle * 3;
+		cluster.indexCount = (endTriangle - firstTriangle) * 3;
+		cluster.min = glm::vec3(FLT_MAX);
+		cluster.max = glm::vec3(-FLT_MAX);
+		for(size_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i++){
+			cluster.min = glm::min(cluster.min, positions[indices[i]]);
+			cluster.max = glm::max(cluster.max, positions[indices[i]]);
+		}
+		// Sphere around the box centre, shrunk to the furthest vertex
+		cluster.center = (cluster.min + cluster.max) * 0.5f;
+		float radiusSquared = 0.0f;
+		for(size_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i++){
+			glm::vec3 offset = positions[indices[i]] - cluster.center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		cluster.radius = std::sqrt(radiusSquared);
+	});
+
+	outClusters.nodes.reserve(clusterCount * 2 - 1);
+	buildNode(outClusters, 0, clusterCount);
+}
+
+void cullClusters(const MeshClusters& clusters, const Frustum& frustum, VisibleClusters& outVisible){
+	outVisible.clear();
+	if(clusters.nodes.empty()){
+		return;
+	}
+
+	// Depth first, left before right, so visible ranges come out in index order and merge
+	unsigned int stack[64];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while(stackSize > 0){
+		const ClusterNode& node = clusters.nodes[stack[--stackSize]];
+		outVisible.nodesVisited++;
+
+		Containment containment = classifyBox(frustum, node.min, node.max);
+		if(containment == Containment::OUTSIDE){
+			continue;
+		}
+		if(containment == Containment::INSIDE){
+			addVisible(clusters, node.firstCluster, node.clusterCount, outVisible);
+			continue;
+		}
+		if(node.clusterCount == 1){
+			const MeshCluster& cluster = clusters.clusters[node.firstCluster];
+			if(!sphereOutside(frustum, cluster.center, cluster.radius)){
+				addVisible(clusters, node.firstCluster, 1, outVisible);
+			}
+			continue;
+		}
+		unsigned int left = (unsigned int)(&node - clusters.nodes.data()) + 1;
+		stack[stackSize++] = node.right;
+		stack[stackSize++] = left;
+	}
+}
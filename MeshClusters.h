@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// A run of triangles that are close together: indexCount indices from firstIndex of the
+// reordered index buffer, with their bounding box and bounding sphere
+class MeshCluster {
+	public:
+		unsigned int firstIndex;
+		unsigned int indexCount;
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 center;
+		float radius;
+};
+
+// BVH node over the clusters firstCluster .. firstCluster + clusterCount. Nodes are stored depth
+// first: an inner node's left child follows it, right is the index of the other one. Leaves hold
+// a single cluster.
+class ClusterNode {
+	public:
+		glm::vec3 min;
+		glm::vec3 max;
+		unsigned int firstCluster;
+		unsigned int clusterCount;
+		unsigned int right;
+};
+
+class MeshClusters {
+	public:
+		std::vector<MeshCluster> clusters;
+		std::vector<ClusterNode> nodes;
+		size_t triangleCount = 0;
+};
+
+// The six planes (xyz normal pointing inside, w distance) of a clip matrix's view volume, in the
+// space the matrix transforms from
+class Frustum {
+	public:
+		glm::vec4 planes[6];
+
+		static Frustum fromMatrix(const glm::mat4& clip);
+};
+
+// Index ranges to draw, adjacent visible clusters merged into one range
+class VisibleClusters {
+	public:
+		std::vector<int> counts;
+		std::vector<unsigned int> firstIndices;
+		size_t triangleCount = 0;
+		size_t clusterCount = 0;
+		size_t nodesVisited = 0;
+
+		void clear();
+};
+
+// Sort the triangles by the Morton code of their centroids, cut the order into clusters of up to
+// maxTriangles and build the BVH over them. The indices are reordered in place so every cluster
+// is one contiguous range, its triangles in vertex cache order (optimizeVertexCache).
+void buildMeshClusters(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices, MeshClusters& outClusters,
+	unsigned int maxTriangles = 128, unsigned int threadCount = 0);
+
+// Walk the BVH against the frustum: every node's box is classified first. Subtrees entirely inside
+// are taken without further tests, subtrees outside are skipped, and the cluster of a straddling
+// leaf is kept unless its bounding sphere is outside
+void cullClusters(const MeshClusters& clusters, const Frustum& frustum, VisibleClusters& outVisible);
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+namespace {
+	const unsigned int noVertex = ~0u;
+
+	// FIFO of vertex ids as time stamps: a vertex is cached while fewer than cacheSize others
+	// entered after it. Flushing moves the clock on instead of clearing the stamps.
+	class FifoCache {
+		public:
+			FifoCache(size_t vertexCount, unsigned int cacheSize) : enteredAt(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+			// True on a miss, which puts the vertex in the cache
+			bool access(unsigned int vertex){
+				if(time - enteredAt[vertex] > cacheSize){
+					enteredAt[vertex] = time++;
+					return true;
+				}
+				return false;
+			}
+			size_t age(unsigned int vertex) const { return time - enteredAt[vertex]; }
+			void flush() { time += cacheSize + 1; }
+
+		private:
+			std::vector<size_t> enteredAt;
+			size_t cacheSize;
+			size_t time;
+	};
+
+	// Twice the signed area of (a, b, p); positive when p is left of a->b
+	float edgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p){
+		return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	}
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize){
+	VertexCacheStats stats;
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	for(unsigned int index : indices){
+		if(index >= vertexCount){
+			continue;
+		}
+		stats.misses += cache.access(index) ? 1 : 0;
+		if(!referenced[index]){
+			referenced[index] = true;
+			referencedCount++;
+		}
+	}
+	stats.acmr = indices.size() >= 3 ? (float)stats.misses / (indices.size() / 3) : 0.0f;
+	stats.atvr = referencedCount > 0 ? (float)stats.misses / referencedCount : 0.0f;
+	return stats;
+}
+
+OverdrawStats analyzeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions){
+	const int resolution = 256;
+	OverdrawStats stats;
+	glm::vec3 min(FLT_MAX);
+	glm::vec3 max(-FLT_MAX);
+	for(unsigned int index : indices){
+		min = glm::min(min, positions[index]);
+		max = glm::max(max, positions[index]);
+	}
+	float extent = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+	if(indices.size() < 3 || extent <= 0.0f){
+		return stats;
+	}
+	float scale = resolution * 0.999f / extent;
+
+	std::vector<float> depth(resolution * resolution);
+	for(int view = 0; view < 6; view++){
+		// Looking down one axis from either side; the other two span the image
+		int axis = view / 2;
+		float direction = view % 2 == 0 ? 1.0f : -1.0f;
+		int uAxis = (axis + 1) % 3;
+		int vAxis = (axis + 2) % 3;
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+		for(size_t i = 0; i + 2 < indices.size(); i += 3){
+			glm::vec2 corners[3];
+			float depths[3];
+			for(int c = 0; c < 3; c++){
+				glm::vec3 p = positions[indices[i + c]] - min;
+				corners[c] = glm::vec2(p[uAxis], p[vAxis]) * scale;
+				depths[c] = direction * p[axis];
+			}
+			float area = edgeFunction(corners[0], corners[1], corners[2]);
+			if(area == 0.0f){
+				continue;
+			}
+			if(area < 0.0f){
+				std::swap(corners[1], corners[2]);
+				std::swap(depths[1], depths[2]);
+				area = -area;
+			}
+
+			int x0 = std::max(0, (int)std::floor(std::min(corners[0].x, std::min(corners[1].x, corners[2].x))));
+			int y0 = std::max(0, (int)std::floor(std::min(corners[0].y, std::min(corners[1].y, corners[2].y))));
+			int x1 = std::min(resolution - 1, (int)std::ceil(std::max(corners[0].x, std::max(corners[1].x, corners[2].x))));
+			int y1 = std::min(resolution - 1, (int)std::ceil(std::max(corners[0].y, std::max(corners[1].y, corners[2].y))));
+			for(int y = y0; y <= y1; y++){
+				for(int x = x0; x <= x1; x++){
+					glm::vec2 center(x + 0.5f, y + 0.5f);
+					float w0 = edgeFunction(corners[1], corners[2], center);
+					float w1 = edgeFunction(corners[2], corners[0], center);
+					float w2 = edgeFunction(corners[0], corners[1], center);
+					if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f){
+						continue;
+					}
+					float z = (w0 * depths[0] + w1 * depths[1] + w2 * depths[2]) / area;
+					float& stored = depth[y * resolution + x];
+					if(z < stored){
+						stored = z;
+						stats.pixelsShaded++;
+					}
+				}
+			}
+		}
+		for(float stored : depth){
+			stats.pixelsCovered += stored != FLT_MAX ? 1 : 0;
+		}
+	}
+	stats.overdraw = stats.pixelsCovered > 0 ? (float)stats.pixelsShaded / stats.pixelsCovered : 0.0f;
+	return stats;
+}
+
+void optimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& outTriangleOrder,
+	std::vector<unsigned int>& outClusterStarts, unsigned int cacheSize){
+	size_t triangleCount = indices.size() / 3;
+	outTriangleOrder.clear();
+	outClusterStarts.clear();
+	outTriangleOrder.reserve(triangleCount);
+
+	// Triangles using each vertex, and how many of them are still to be emitted
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for(size_t i = 0; i < triangleCount * 3; i++){
+		offsets[indices[i] + 1]++;
+	}
+	for(size_t v = 0; v < vertexCount; v++){
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> liveTriangles(vertexCount);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for(size_t i = 0; i < triangleCount * 3; i++){
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+		}
+	}
+	for(size_t v = 0; v < vertexCount; v++){
+		liveTriangles[v] = offsets[v + 1] - offsets[v];
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	size_t cursor = 0;
+	unsigned int fan = noVertex;
+	bool jumped = true;
+	while(true){
+		if(fan == noVertex){
+			// Restart at the next vertex in index order with triangles left
+			while(cursor < vertexCount && liveTriangles[cursor] == 0){
+				cursor++;
+			}
+			if(cursor == vertexCount){
+				break;
+			}
+			fan = (unsigned int)cursor;
+			jumped = true;
+		}
+		if(jumped){
+			outClusterStarts.push_back((unsigned int)outTriangleOrder.size());
+			jumped = false;
+		}
+
+		candidates.clear();
+		for(unsigned int k = offsets[fan]; k < offsets[fan + 1]; k++){
+			unsigned int triangle = adjacency[k];
+			if(emitted[triangle]){
+				continue;
+			}
+			for(int c = 0; c < 3; c++){
+				unsigned int vertex = indices[triangle * 3 + c];
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				cache.access(vertex);
+			}
+			emitted[triangle] = true;
+			outTriangleOrder.push_back(triangle);
+		}
+
+		// The candidate that stays cached while its remaining fan is emitted, the oldest first
+		unsigned int next = noVertex;
+		long long bestPriority = -1;
+		for(unsigned int vertex : candidates){
+			if(liveTriangles[vertex] == 0){
+				continue;
+			}
+			long long priority = 0;
+			if(cache.age(vertex) + 2 * liveTriangles[vertex] <= cacheSize){
+				priority = (long long)cache.age(vertex);
+			}
+			if(priority > bestPriority){
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+		// Dead end: the most recently used vertex that still has triangles
+		while(next == noVertex && !deadEnds.empty()){
+			unsigned int vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if(liveTriangles[vertex] > 0){
+				next = vertex;
+			}
+		}
+		fan = next;
+	}
+}
+
+void optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, std::vector<unsigned int>& triangleOrder,
+	const std::vector<unsigned int>& clusterStarts, float threshold, unsigned int cacheSize){
+	size_t triangleCount = triangleOrder.size();
+	if(triangleCount == 0){
+		return;
+	}
+
+	// Cut each run where the ACMR since the last cut is within threshold of the whole run's
+	FifoCache cache(positions.size(), cacheSize);
+	auto triangleMisses = [&](unsigned int triangle){
+		size_t misses = 0;
+		for(int c = 0; c < 3; c++){
+			misses += cache.access(indices[triangle * 3 + c]) ? 1 : 0;
+		}
+		return misses;
+	};
+	std::vector<size_t> starts;
+	for(size_t cluster = 0; cluster < clusterStarts.size(); cluster++){
+		size_t begin = clusterStarts[cluster];
+		size_t end = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : triangleCount;
+		cache.flush();
+		size_t runMisses = 0;
+		for(size_t i = begin; i < end; i++){
+			runMisses += triangleMisses(triangleOrder[i]);
+		}
+		float runAcmr = (float)runMisses / std::max<size_t>(end - begin, 1);
+
+		cache.flush();
+		starts.push_back(begin);
+		size_t misses = 0;
+		for(size_t i = begin; i < end; i++){
+			misses += triangleMisses(triangleOrder[i]);
+			size_t triangles = i + 1 - starts.back();
+			if(i + 1 < end && misses <= threshold * runAcmr * triangles){
+				starts.push_back(i + 1);
+				cache.flush();
+				misses = 0;
+			}
+		}
+	}
+
+	// How far each cut faces out of the mesh: its area weighted normal against the offset of
+	// its centroid from the mesh centroid
+	size_t clusterCount = starts.size();
+	std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> areas(clusterCount, 0.0f);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for(size_t cluster = 0; cluster < clusterCount; cluster++){
+		size_t end = cluster + 1 < clusterCount ? starts[cluster + 1] : triangleCount;
+		glm::vec3 unweighted(0.0f);
+		for(size_t i = starts[cluster]; i < end; i++){
+			const unsigned int* corners = &indices[triangleOrder[i] * 3];
+			const glm::vec3& a = positions[corners[0]];
+			const glm::vec3& b = positions[corners[1]];
+			const glm::vec3& c = positions[corners[2]];
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+			glm::vec3 center = (a + b + c) / 3.0f;
+			centroids[cluster] += center * area;
+			unweighted += center;
+			normals[cluster] += normal;
+			areas[cluster] += area;
+		}
+		meshCentroid += centroids[cluster];
+		meshArea += areas[cluster];
+		centroids[cluster] = areas[cluster] > 0.0f ? centroids[cluster] / areas[cluster] : unweighted / (float)(end - starts[cluster]);
+	}
+	if(meshArea > 0.0f){
+		meshCentroid /= meshArea;
+	}
+
+	std::vector<float> outwardness(clusterCount, 0.0f);
+	for(size_t cluster = 0; cluster < clusterCount; cluster++){
+		float length = glm::length(normals[cluster]);
+		if(length > 0.0f){
+			outwardness[cluster] = glm::dot(centroids[cluster] - meshCentroid, normals[cluster] / length);
+		}
+	}
+	std::vector<unsigned int> clusterOrder(clusterCount);
+	for(size_t cluster = 0; cluster < clusterCount; cluster++){
+		clusterOrder[cluster] = (unsigned int)cluster;
+	}
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](unsigned int a, unsigned int b){ return outwardness[a] > outwardness[b]; });
+
+	std::vector<unsigned int> reordered;
+	reordered.reserve(triangleCount);
+	for(unsigned int cluster : clusterOrder){
+		size_t end = cluster + 1 < clusterCount ? starts[cluster + 1] : triangleCount;
+		reordered.insert(reordered.end(), triangleOrder.begin() + starts[cluster], triangleOrder.begin() + end);
+	}
+	triangleOrder.swap(reordered);
+}
+
+void optimizeVertexFetch(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& outRemap){
+	outRemap.assign(vertexCount, noVertex);
+	unsigned int nextVertex = 0;
+	for(unsigned int index : indices){
+		if(index < vertexCount && outRemap[index] == noVertex){
+			outRemap[index] = nextVertex++;
+		}
+	}
+	for(size_t v = 0; v < vertexCount; v++){
+		if(outRemap[v] == noVertex){
+			outRemap[v] = nextVertex++;
+		}
+	}
+}
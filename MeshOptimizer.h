@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// Post-transform vertex cache behaviour of an index buffer, simulated as a FIFO of cacheSize
+// vertices. ACMR is misses per triangle (0.5 at best on a large regular mesh, 3 at worst), ATVR
+// misses per referenced vertex (1 at best).
+class VertexCacheStats {
+	public:
+		size_t misses = 0;
+		float acmr = 0.0f;
+		float atvr = 0.0f;
+};
+
+// Fragments that pass the depth test per covered pixel (1 at best), drawing the triangles in
+// order with a software rasterizer along the six axis directions, without back face culling
+class OverdrawStats {
+	public:
+		size_t pixelsCovered = 0;
+		size_t pixelsShaded = 0;
+		float overdraw = 0.0f;
+};
+
+// Metrics of the same mesh before and after an optimization pass
+class MeshOptimizationStats {
+	public:
+		VertexCacheStats cacheBefore;
+		VertexCacheStats cacheAfter;
+		OverdrawStats overdrawBefore;
+		OverdrawStats overdrawAfter;
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+OverdrawStats analyzeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions);
+
+// Tipsify (Sander, Nehab and Barczak 2007): fans around the vertex most likely to still be in a
+// cache of cacheSize, jumping to a recently used vertex with triangles left at a dead end.
+// outTriangleOrder lists the triangles of indices in the new order; outClusterStarts has the
+// positions in it where the walk had to jump, which start runs that share no cached vertices.
+void optimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& outTriangleOrder,
+	std::vector<unsigned int>& outClusterStarts, unsigned int cacheSize = 16);
+
+// Reorders the runs of a vertex cache optimized triangleOrder so the ones facing out of the mesh
+// are drawn first and hide what is behind them. Runs are cut further where their ACMR so far is
+// within threshold of the whole run's, so the cache hit rate drops by at most that factor.
+void optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, std::vector<unsigned int>& triangleOrder,
+	const std::vector<unsigned int>& clusterStarts, float threshold = 1.05f, unsigned int cacheSize = 16);
+
+// New vertex numbers in order of first use by indices, so vertex fetches walk the buffer forward.
+// Unreferenced vertices follow in their old order.
+void optimizeVertexFetch(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& outRemap);
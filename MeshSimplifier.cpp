@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <queue>
+#include <cmath>
+#include <cstdint>
+
+#include "MeshSimplifier.h"
+#include "Bounds.h"
+
+namespace {
+	// Sum of squared distances to a set of planes: p^T A p + 2 b.p + c with A symmetric, stored
+	// as xx xy xz yy yz zz, b, c
+	class Quadric {
+		public:
+			double a[6] = { 0, 0, 0, 0, 0, 0 };
+			double b[3] = { 0, 0, 0 };
+			double c = 0;
+
+			void addPlane(const glm::vec3& normal, double distance, double weight){
+				double x = normal.x, y = normal.y, z = normal.z;
+				a[0] += weight * x * x; a[1] += weight * x * y; a[2] += weight * x * z;
+				a[3] += weight * y * y; a[4] += weight * y * z; a[5] += weight * z * z;
+				b[0] += weight * distance * x; b[1] += weight * distance * y; b[2] += weight * distance * z;
+				c += weight * distance * distance;
+			}
+
+			void add(const Quadric& other){
+				for(int i = 0; i < 6; i++){
+					a[i] += other.a[i];
+				}
+				for(int i = 0; i < 3; i++){
+					b[i] += other.b[i];
+				}
+				c += other.c;
+			}
+
+			double evaluate(const glm::vec3& point) const {
+				double x = point.x, y = point.y, z = point.z;
+				double result = a[0] * x * x + a[3] * y * y + a[5] * z * z
+					+ 2.0 * (a[1] * x * y + a[2] * x * z + a[4] * y * z)
+					+ 2.0 * (b[0] * x + b[1] * y + b[2] * z) + c;
+				return std::max(result, 0.0);
+			}
+	};
+
+	// Moving position from onto position to; versions detect entries made stale by later collapses
+	class Collapse {
+		public:
+			double cost;
+			double error;
+			unsigned int from;
+			unsigned int to;
+			unsigned int fromVersion;
+			unsigned int toVersion;
+
+			bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	// Part of an edge's squared length added to its cost, so among equally cheap collapses (a flat
+	// region costs nothing) short edges go first instead of everything piling onto one vertex
+	const double lengthWeight = 1e-6;
+
+	// Boundary edges get planes through them perpendicular to their face, weighted heavily so
+	// open borders keep their outline
+	const double boundaryWeight = 10.0;
+
+	class Simplifier {
+		public:
+			Simplifier(const ObjData& data);
+			void run(std::vector<LodLevel>& outLevels, float reduction, size_t minTriangles);
+
+		private:
+			const ObjData& data;
+			bool hasNormals;
+			bool hasUvs;
+			double attributeWeight;
+			float diagonal;
+
+			// Welded vertices sharing a position form one position vertex with several wedges
+			std::vector<glm::vec3> positions;
+			std::vector<unsigned int> positionOf;
+			std::vector<std::vector<unsigned int>> wedges;
+			std::vector<Quadric> quadrics;
+			std::vector<unsigned int> versions;
+			std::vector<char> removed;
+
+			std::vector<unsigned int> corners;
+			std::vector<char> alive;
+			std::vector<std::vector<unsigned int>> positionTriangles;
+			size_t liveTriangles;
+
+			std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+			std::vector<unsigned int> neighbourScratch;
+			std::vector<unsigned int> otherNeighbourScratch;
+			std::vector<unsigned int> wedgeMap;
+
+			double attributeDistance(unsigned int a, unsigned int b) const;
+			double attributeCost(unsigned int from, unsigned int to) const;
+			void pushEdge(unsigned int a, unsigned int b);
+			void gatherNeighbours(unsigned int position, std::vector<unsigned int>& outNeighbours);
+			bool containsPosition(unsigned int triangle, unsigned int position) const;
+			bool collapse(const Collapse& candidate);
+	};
+
+	Simplifier::Simplifier(const ObjData& data) : data(data) {
+		size_t vertexCount = data.vertices.size();
+		hasNormals = data.normals.size() == vertexCount;
+		hasUvs = data.uvs.size() == vertexCount;
+
+		Bounds bounds = computeBounds(data.vertices);
+		diagonal = glm::length(bounds.max - bounds.min);
+		// An attribute difference of 1 costs like being 2% of the diagonal off the surface
+		attributeWeight = 0.02 * diagonal * 0.02 * diagonal;
+
+		// Group equal positions by sorting instead of hashing floats
+		std::vector<unsigned int> order(vertexCount);
+		for(size_t i = 0; i < vertexCount; i++){
+			order[i] = i;
+		}
+		auto less = [&](unsigned int a, unsigned int b){
+			const glm::vec3& p = data.vertices[a];
+			const glm::vec3& q = data.vertices[b];
+			return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+		};
+		std::sort(order.begin(), order.end(), less);
+		positionOf.resize(vertexCount);
+		for(size_t i = 0; i < vertexCount; i++){
+			if(i == 0 || less(order[i - 1], order[i])){
+				positions.push_back(data.vertices[order[i]]);
+				wedges.emplace_back();
+			}
+			positionOf[order[i]] = positions.size() - 1;
+			wedges.back().push_back(order[i]);
+		}
+
+		size_t positionCount = positions.size();
+		quadrics.resize(positionCount);
+		versions.assign(positionCount, 0);
+		removed.assign(positionCount, 0);
+		positionTriangles.resize(positionCount);
+
+		corners = data.vertexIndices;
+		size_t triangleCount = corners.size() / 3;
+		alive.assign(triangleCount, 1);
+		liveTriangles = 0;
+
+		// Edges as (low position, high position, triangle) to find borders and unique edges
+		std::vector<std::pair<uint64_t, unsigned int>> edges;
+		edges.reserve(triangleCount * 3);
+		for(size_t triangle = 0; triangle < triangleCount; triangle++){
+			unsigned int p[3] = { positionOf[corners[triangle * 3]], positionOf[corners[triangle * 3 + 1]], positionOf[corners[triangle * 3 + 2]] };
+			if(p[0] == p[1] || p[1] == p[2] || p[2] == p[0]){
+				alive[triangle] = 0;
+				continue;
+			}
+			liveTriangles++;
+
+			glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			float length = glm::length(normal);
+			if(length > 0.0f){
+				normal = normal / length;
+				double distance = -glm::dot(normal, positions[p[0]]);
+				for(int corner = 0; corner < 3; corner++){
+					quadrics[p[corner]].addPlane(normal, distance, 1.0);
+				}
+			}
+			for(int corner = 0; corner < 3; corner++){
+				positionTriangles[p[corner]].push_back(triangle);
+				unsigned int a = std::min(p[corner], p[(corner + 1) % 3]);
+				unsigned int b = std::max(p[corner], p[(corner + 1) % 3]);
+				edges.push_back({ ((uint64_t)a << 32) | b, (unsigned int)triangle });
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for(size_t i = 0; i < edges.size(); ){
+			size_t end = i + 1;
+			while(end < edges.size() && edges[end].first == edges[i].first){
+				end++;
+			}
+			unsigned int a = (unsigned int)(edges[i].first >> 32);
+			unsigned int b = (unsigned int)(edges[i].first & 0xFFFFFFFFu);
+			if(end - i == 1){
+				unsigned int triangle = edges[i].second;
+				const glm::vec3& p0 = positions[positionOf[corners[triangle * 3]]];
+				const glm::vec3& p1 = positions[positionOf[corners[triangle * 3 + 1]]];
+				const glm::vec3& p2 = positions[positionOf[corners[triangle * 3 + 2]]];
+				glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+				glm::vec3 borderNormal = glm::cross(positions[b] - positions[a], faceNormal);
+				float length = glm::length(borderNormal);
+				if(length > 0.0f){
+					borderNormal = borderNormal / length;
+					double distance = -glm::dot(borderNormal, positions[a]);
+					quadrics[a].addPlane(borderNormal, distance, boundaryWeight);
+					quadrics[b].addPlane(borderNormal, distance, boundaryWeight);
+				}
+			}
+			i = end;
+		}
+		for(size_t i = 0; i < edges.size(); i++){
+			if(i == 0 || edges[i].first != edges[i - 1].first){
+				pushEdge((unsigned int)(edges[i].first >> 32), (unsigned int)(edges[i].first & 0xFFFFFFFFu));
+			}
+		}
+	}
+
+	double Simplifier::attributeDistance(unsigned int a, unsigned int b) const {
+		double distance = 0.0;
+		if(hasNormals){
+			glm::vec3 difference = data.normals[a] - data.normals[b];
+			distance += glm::dot(difference, difference);
+		}
+		if(hasUvs){
+			glm::vec2 difference = data.uvs[a] - data.uvs[b];
+			distance += glm::dot(difference, difference);
+		}
+		return distance;
+	}
+
+	// Every wedge of from takes the closest wedge of to
+	double Simplifier::attributeCost(unsigned int from, unsigned int to) const {
+		if(!hasNormals && !hasUvs){
+			return 0.0;
+		}
+		double cost = 0.0;
+		for(unsigned int wedge : wedges[from]){
+			double closest = 1e30;
+			for(unsigned int target : wedges[to]){
+				closest = std::min(closest, attributeDistance(wedge, target));
+			}
+			cost += closest;
+		}
+		return cost * attributeWeight;
+	}
+
+	// Queue the cheaper direction of the edge
+	void Simplifier::pushEdge(unsigned int a, unsigned int b){
+		Quadric quadric = quadrics[a];
+		quadric.add(quadrics[b]);
+		double errorAtA = quadric.evaluate(positions[a]);
+		double errorAtB = quadric.evaluate(positions[b]);
+		glm::vec3 edge = positions[b] - positions[a];
+		double length = lengthWeight * glm::dot(edge, edge);
+		double costAtA = errorAtA + length + attributeCost(b, a);
+		double costAtB = errorAtB + length + attributeCost(a, b);
+		if(costAtA < costAtB){
+			heap.push({ costAtA, errorAtA, b, a, versions[b], versions[a] });
+		} else {
+			heap.push({ costAtB, errorAtB, a, b, versions[a], versions[b] });
+		}
+	}
+
+	bool Simplifier::containsPosition(unsigned int triangle, unsigned int position) const {
+		return positionOf[corners[triangle * 3]] == position || positionOf[corners[triangle * 3 + 1]] == position
+			|| positionOf[corners[triangle * 3 + 2]] == position;
+	}
+
+	void Simplifier::gatherNeighbours(unsigned int position, std::vector<unsigned int>& outNeighbours){
+		outNeighbours.clear();
+		for(unsigned int triangle : positionTriangles[position]){
+			if(!alive[triangle]){
+				continue;
+			}
+			for(int corner = 0; corner < 3; corner++){
+				unsigned int neighbour = positionOf[corners[triangle * 3 + corner]];
+				if(neighbour != position){
+					outNeighbours.push_back(neighbour);
+				}
+			}
+		}
+		std::sort(outNeighbours.begin(), outNeighbours.end());
+		outNeighbours.erase(std::unique(outNeighbours.begin(), outNeighbours.end()), outNeighbours.end());
+	}
+
+	bool Simplifier::collapse(const Collapse& candidate){
+		unsigned int from = candidate.from;
+		unsigned int to = candidate.to;
+
+		// Link condition: the two ends may only share the neighbours opposite the edge, or the
+		// surface pinches into a non manifold one
+		unsigned int sharedTriangles = 0;
+		for(unsigned int triangle : positionTriangles[from]){
+			if(alive[triangle] && containsPosition(triangle, to)){
+				sharedTriangles++;
+			}
+		}
+		if(sharedTriangles == 0){
+			return false;
+		}
+		gatherNeighbours(from, neighbourScratch);
+		gatherNeighbours(to, otherNeighbourScratch);
+		size_t common = 0;
+		for(size_t i = 0, j = 0; i < neighbourScratch.size() && j < otherNeighbourScratch.size(); ){
+			if(neighbourScratch[i] == otherNeighbourScratch[j]){
+				common++;
+				i++;
+				j++;
+			} else if(neighbourScratch[i] < otherNeighbourScratch[j]){
+				i++;
+			} else {
+				j++;
+			}
+		}
+		if(common != sharedTriangles){
+			return false;
+		}
+
+		// No remaining triangle may turn over or collapse to a sliver
+		for(unsigned int triangle : positionTriangles[from]){
+			if(!alive[triangle] || containsPosition(triangle, to)){
+				continue;
+			}
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for(int corner = 0; corner < 3; corner++){
+				unsigned int position = positionOf[corners[triangle * 3 + corner]];
+				before[corner] = positions[position];
+				after[corner] = position == from ? positions[to] : positions[position];
+			}
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if(glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter)
+				|| glm::length(normalAfter) <= 1e-12f * diagonal * diagonal){
+				return false;
+			}
+		}
+
+		// Corners at from switch to the closest wedge at to
+		for(unsigned int wedge : wedges[from]){
+			unsigned int best = wedges[to][0];
+			double closest = 1e30;
+			for(unsigned int target : wedges[to]){
+				double distance = attributeDistance(wedge, target);
+				if(distance < closest){
+					closest = distance;
+					best = target;
+				}
+			}
+			wedgeMap[wedge] = best;
+		}
+		for(unsigned int triangle : positionTriangles[from]){
+			if(!alive[triangle]){
+				continue;
+			}
+			if(containsPosition(triangle, to)){
+				alive[triangle] = 0;
+				liveTriangles--;
+				continue;
+			}
+			for(int corner = 0; corner < 3; corner++){
+				unsigned int& vertex = corners[triangle * 3 + corner];
+				if(positionOf[vertex] == from){
+					vertex = wedgeMap[vertex];
+				}
+			}
+			positionTriangles[to].push_back(triangle);
+		}
+
+		std::vector<unsigned int>& toTriangles = positionTriangles[to];
+		toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&](unsigned int triangle){ return !alive[triangle]; }), toTriangles.end());
+		std::vector<unsigned int>().swap(positionTriangles[from]);
+		quadrics[to].add(quadrics[from]);
+		removed[from] = 1;
+		versions[to]++;
+
+		gatherNeighbours(to, neighbourScratch);
+		for(unsigned int neighbour : neighbourScratch){
+			pushEdge(neighbour, to);
+		}
+		return true;
+	}
+
+	void Simplifier::run(std::vector<LodLevel>& outLevels, float reduction, size_t minTriangles){
+		wedgeMap.resize(data.vertices.size());
+		double maxError = 0.0;
+		double target = liveTriangles * reduction;
+		while(!heap.empty() && target >= minTriangles){
+			Collapse candidate = heap.top();
+			heap.pop();
+			if(removed[candidate.from] || removed[candidate.to]
+				|| versions[candidate.from] != candidate.fromVersion || versions[candidate.to] != candidate.toVersion){
+				continue;
+			}
+			if(!collapse(candidate)){
+				continue;
+			}
+			maxError = std::max(maxError, candidate.error);
+
+			if(liveTriangles <= target){
+				LodLevel level;
+				level.indices.reserve(liveTriangles * 3);
+				for(size_t triangle = 0; triangle < alive.size(); triangle++){
+					if(alive[triangle]){
+						level.indices.insert(level.indices.end(), &corners[triangle * 3], &corners[triangle * 3 + 3]);
+					}
+				}
+				level.error = (float)std::sqrt(maxError);
+				level.relativeError = diagonal > 0.0f ? level.error / diagonal : 0.0f;
+				outLevels.push_back(std::move(level));
+				target *= reduction;
+			}
+		}
+	}
+}
+
+void buildLodChain(const ObjData& data, std::vector<LodLevel>& outLevels, float reduction, size_t minTriangles){
+	outLevels.clear();
+	if(data.vertexIndices.size() / 3 * reduction < minTriangles || reduction <= 0.0f || reduction >= 1.0f){
+		return;
+	}
+	Simplifier simplifier(data);
+	simplifier.run(outLevels, reduction, minTriangles);
+}
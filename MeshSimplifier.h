@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+#include "ObjData.h"
+
+// One level of detail: triangles over the vertices of the full detail mesh
+class LodLevel {
+	public:
+		std::vector<unsigned int> indices;
+		// Distance bound from the collapsed vertices to the original surface's planes (the square
+		// root of the largest quadric error so far), in model units and relative to the diagonal
+		float error = 0.0f;
+		float relativeError = 0.0f;
+};
+
+// Quadric error metric simplification of welded ObjData by half edge collapses: a vertex moves
+// onto a neighbour, so every level reuses the original vertices (and can share their buffers).
+// Vertices at one position with different normals/uvs (seams) collapse together, each taking the
+// target's closest normal/uv, whose difference is added to the cost; boundary edges are held in
+// place by extra quadrics; collapses that would flip a triangle or pinch the surface are skipped.
+// One pass snapshots a level every time the triangle count halves (reduction), stopping below
+// minTriangles or when nothing more can collapse. outLevels does not include the full mesh.
+void buildLodChain(const ObjData& data, std::vector<LodLevel>& outLevels, float reduction = 0.5f, size_t minTriangles = 1000);
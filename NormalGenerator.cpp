@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "NormalGenerator.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+	const size_t minRange = 1 << 14;
+
+	glm::vec3 normalizeOrZero(const glm::vec3& v){
+		float length = glm::length(v);
+		return length > 0.0f ? v / length : glm::vec3(0.0f);
+	}
+
+	// Unit normal of a triangle and the weight of its face at each corner: the angle there, or
+	// twice the area for every corner
+	glm::vec3 triangleNormal(const std::vector<glm::vec3>& positions, const unsigned int* corners, NormalOptions::Weighting weighting, float* outWeights){
+		const glm::vec3& a = positions[corners[0]];
+		const glm::vec3& b = positions[corners[1]];
+		const glm::vec3& c = positions[corners[2]];
+		glm::vec3 cross = glm::cross(b - a, c - a);
+		float area = glm::length(cross);
+		if(outWeights){
+			if(weighting == NormalOptions::Weighting::AREA){
+				outWeights[0] = outWeights[1] = outWeights[2] = area;
+			} else {
+				glm::vec3 edges[3] = { b - a, c - b, a - c };
+				float lengths[3] = { glm::length(edges[0]), glm::length(edges[1]), glm::length(edges[2]) };
+				for(int corner = 0; corner < 3; corner++){
+					// Between the edge leaving the corner and the reversed edge arriving at it
+					const int arriving = (corner + 2) % 3;
+					float product = lengths[corner] * lengths[arriving];
+					float cosine = product > 0.0f ? std::clamp(-glm::dot(edges[corner], edges[arriving]) / product, -1.0f, 1.0f) : 1.0f;
+					outWeights[corner] = std::acos(cosine);
+				}
+			}
+		}
+		return area > 0.0f ? cross / area : glm::vec3(0.0f);
+	}
+
+	// Ranges of [0, count) for parallelFor, as parallelForRange splits them
+	size_t rangeCountFor(size_t count, unsigned int threadCount){
+		return std::max<size_t>(1, std::min<size_t>(resolveThreadCount(threadCount) * 4, count / minRange));
+	}
+}
+
+bool generateNormals(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const NormalOptions& options,
+		std::vector<glm::vec3>& outNormals, std::vector<unsigned int>& outNormalIndices){
+	TraceScope trace("generateNormals");
+	const size_t cornerCount = indices.size() - indices.size() % 3;
+	const size_t vertexCount = positions.size();
+	trace.setTriangles(cornerCount / 3);
+	outNormalIndices.resize(cornerCount);
+	std::atomic<bool> valid(true);
+
+	if(options.mode == NormalOptions::Mode::FLAT){
+		outNormals.resize(cornerCount / 3);
+		parallelForRange(cornerCount / 3, minRange, options.threadCount, [&](size_t begin, size_t end){
+			for(size_t triangle = begin; triangle < end; triangle++){
+				if(std::max({ indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2] }) >= vertexCount){
+					valid = false;
+					return;
+				}
+				outNormals[triangle] = triangleNormal(positions, &indices[triangle * 3], options.weighting, nullptr);
+				for(size_t corner = triangle * 3; corner < triangle * 3 + 3; corner++){
+					outNormalIndices[corner] = (unsigned int)triangle;
+				}
+			}
+		});
+		return valid;
+	}
+
+	// Corners of each vertex, by counting sort: count, prefix sum, then place
+	std::vector<std::atomic<unsigned int>> counts(vertexCount);
+	parallelForRange(cornerCount, minRange, options.threadCount, [&](size_t begin, size_t end){
+		for(size_t corner = begin; corner < end; corner++){
+			if(indices[corner] >= vertexCount){
+				valid = false;
+				return;
+			}
+			counts[indices[corner]].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+	if(!valid){
+		return false;
+	}
+
+	// Each face once, rather than once per corner in the gather
+	std::vector<glm::vec3> faceNormals(cornerCount / 3);
+	std::vector<float> cornerWeights(cornerCount);
+	parallelForRange(cornerCount / 3, minRange, options.threadCount, [&](size_t begin, size_t end){
+		for(size_t triangle = begin; triangle < end; triangle++){
+			faceNormals[triangle] = triangleNormal(positions, &indices[triangle * 3], options.weighting, &cornerWeights[triangle * 3]);
+		}
+	});
+	const size_t vertexRanges = rangeCountFor(vertexCount, options.threadCount);
+	std::vector<size_t> offsets(vertexCount + 1);
+	std::vector<size_t> rangeTotals(vertexRanges + 1, 0);
+	parallelFor(vertexRanges, options.threadCount, [&](size_t range){
+		size_t total = 0;
+		for(size_t vertex = vertexCount * range / vertexRanges; vertex < vertexCount * (range + 1) / vertexRanges; vertex++){
+			total += counts[vertex].load(std::memory_order_relaxed);
+		}
+		rangeTotals[range + 1] = total;
+	});
+	for(size_t range = 0; range < vertexRanges; range++){
+		rangeTotals[range + 1] += rangeTotals[range];
+	}
+	parallelFor(vertexRanges, options.threadCount, [&](size_t range){
+		size_t offset = rangeTotals[range];
+		for(size_t vertex = vertexCount * range / vertexRanges; vertex < vertexCount * (range + 1) / vertexRanges; vertex++){
+			offsets[vertex] = offset;
+			offset += counts[vertex].load(std::memory_order_relaxed);
+			counts[vertex].store(0, std::memory_order_relaxed);
+		}
+	});
+	offsets[vertexCount] = cornerCount;
+	std::vector<unsigned int> vertexCorners(cornerCount);
+	parallelForRange(cornerCount, minRange, options.threadCount, [&](size_t begin, size_t end){
+		for(size_t corner = begin; corner < end; corner++){
+			unsigned int vertex = indices[corner];
+			vertexCorners[offsets[vertex] + counts[vertex].fetch_add(1, std::memory_order_relaxed)] = (unsigned int)corner;
+		}
+	});
+
+	// Each range of vertices gathers the normals of its own corners. Corner lists are sorted first,
+	// as the placement above ran in whatever order the threads got to them.
+	const bool creases = options.creaseAngleDegrees < 180.0f;
+	const float creaseCosine = std::cos(glm::radians(std::min(options.creaseAngleDegrees, 180.0f)));
+	std::vector<std::vector<glm::vec3>> rangeNormals(vertexRanges);
+	parallelFor(vertexRanges, options.threadCount, [&](size_t range){
+		std::vector<glm::vec3>& normals = rangeNormals[range];
+		std::vector<glm::vec3> contributions;
+		for(size_t vertex = vertexCount * range / vertexRanges; vertex < vertexCount * (range + 1) / vertexRanges; vertex++){
+			unsigned int* corners = vertexCorners.data() + offsets[vertex];
+			size_t cornersHere = offsets[vertex + 1] - offsets[vertex];
+			if(cornersHere == 0){
+				continue;
+			}
+			std::sort(corners, corners + cornersHere);
+			contributions.resize(cornersHere);
+			for(size_t i = 0; i < cornersHere; i++){
+				contributions[i] = faceNormals[corners[i] / 3] * cornerWeights[corners[i]];
+			}
+
+			// Usually every face at a vertex is within the crease angle of every other, which gives
+			// each corner the same sum as well
+			bool smooth = true;
+			for(size_t i = 0; i < cornersHere && smooth && creases; i++){
+				const glm::vec3& face = faceNormals[corners[i] / 3];
+				for(size_t j = i + 1; j < cornersHere && smooth; j++){
+					smooth = glm::dot(face, faceNormals[corners[j] / 3]) >= creaseCosine;
+				}
+			}
+			if(smooth){
+				glm::vec3 sum(0.0f);
+				for(size_t i = 0; i < cornersHere; i++){
+					sum += contributions[i];
+				}
+				for(size_t i = 0; i < cornersHere; i++){
+					outNormalIndices[corners[i]] = (unsigned int)normals.size();
+				}
+				normals.push_back(normalizeOrZero(sum));
+				continue;
+			}
+
+			// A degenerate corner has no side of a crease and takes every face
+			size_t firstNormal = normals.size();
+			for(size_t i = 0; i < cornersHere; i++){
+				const glm::vec3& face = faceNormals[corners[i] / 3];
+				const bool degenerate = face == glm::vec3(0.0f);
+				glm::vec3 sum(0.0f);
+				for(size_t j = 0; j < cornersHere; j++){
+					if(degenerate || glm::dot(face, faceNormals[corners[j] / 3]) >= creaseCosine){
+						sum += contributions[j];
+					}
+				}
+				glm::vec3 normal = normalizeOrZero(sum);
+				size_t shared = firstNormal;
+				while(shared < normals.size() && memcmp(&normals[shared], &normal, sizeof(glm::vec3)) != 0){
+					shared++;
+				}
+				if(shared == normals.size()){
+					normals.push_back(normal);
+				}
+				outNormalIndices[corners[i]] = (unsigned int)shared;
+			}
+		}
+	});
+
+	// Ranges' normals concatenated in order, and their local indices offset to match
+	std::vector<size_t> normalOffsets(vertexRanges + 1, 0);
+	for(size_t range = 0; range < vertexRanges; range++){
+		normalOffsets[range + 1] = normalOffsets[range] + rangeNormals[range].size();
+	}
+	outNormals.resize(normalOffsets[vertexRanges]);
+	parallelFor(vertexRanges, options.threadCount, [&](size_t range){
+		std::copy(rangeNormals[range].begin(), rangeNormals[range].end(), outNormals.begin() + normalOffsets[range]);
+		unsigned int offset = (unsigned int)normalOffsets[range];
+		size_t firstCorner = offsets[vertexCount * range / vertexRanges];
+		size_t endCorner = offsets[vertexCount * (range + 1) / vertexRanges];
+		for(size_t i = firstCorner; i < endCorner; i++){
+			outNormalIndices[vertexCorners[i]] += offset;
+		}
+	});
+	return true;
+}
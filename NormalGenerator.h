@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// How generateNormals combines the face normals around a vertex
+class NormalOptions {
+	public:
+		enum class Mode { SMOOTH, FLAT };
+		enum class Weighting { AREA, ANGLE };
+
+		Mode mode = Mode::SMOOTH;
+		Weighting weighting = Weighting::ANGLE;
+		// Faces at a vertex whose normals differ by more than this are not averaged together,
+		// so the vertex gets one normal per side of a hard edge; 180 never splits
+		float creaseAngleDegrees = 60.0f;
+		// Workers, 0 = all hardware threads
+		unsigned int threadCount = 0;
+};
+
+// Normals for the triangles of indices (3 per triangle, into positions), indexed per corner:
+// corner i's normal is outNormals[outNormalIndices[i]]. FLAT gives every triangle its own face
+// normal. SMOOTH gives each corner the normalized sum of the face normals at its vertex that are
+// within the crease angle of its own face, weighted by area or by the face's angle at the vertex;
+// corners of a vertex with the same result share one normal. Degenerate triangles add nothing,
+// and a corner left with nothing gets a zero normal.
+// The triangles at each vertex are gathered from an adjacency list built by a counting sort, so
+// no two threads ever add to the same normal and the result is the same for any thread count.
+// Returns false on an index out of range of positions.
+bool generateNormals(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const NormalOptions& options,
+	std::vector<glm::vec3>& outNormals, std::vector<unsigned int>& outNormalIndices);
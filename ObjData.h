@@ -1,15 +1,43 @@
 #pragma once
 #include <vector>
+#include <memory>
+#include <memory_resource>
 #include <glm/glm.hpp>
 
-class ObjData {
-		public:
-			std::vector<glm::vec3> vertices;
-			std::vector<glm::vec2> uvs;
-			std::vector<glm::vec3> normals;
-
-			std::vector<unsigned int> verticesPerFaceCounts;
-			std::vector<unsigned int> vertexIndices;
-			std::vector<unsigned int> uvIndices;
-			std::vector<unsigned int> normalIndices;
-};
\ No newline at end of file
+// Indexed data as read from an .obj uses one index array per attribute. Separate triangles
+// (indexedToSeparateTriangles) have one attribute entry per corner and no indices. Welded data
+// (separateTrianglesToIndexed) has unified attribute arrays all indexed by vertexIndices.
+// The arrays allocate through Allocator: ObjData from the heap, PmrObjData from the
+// std::pmr::memory_resource it is constructed with, such as the parser's arena for one chunk.
+template <template <typename> class Allocator>
+class BasicObjData {
+	public:
+		template <typename T>
+		using Array = std::vector<T, Allocator<T>>;
+
+		BasicObjData() = default;
+		explicit BasicObjData(const Allocator<char>& allocator)
+			: vertices(allocator), uvs(allocator), normals(allocator), verticesPerFaceCounts(allocator),
+			vertexIndices(allocator), uvIndices(allocator), normalIndices(allocator) {}
+
+		Array<glm::vec3> vertices;
+		Array<glm::vec2> uvs;
+		Array<glm::vec3> normals;
+
+		Array<unsigned int> verticesPerFaceCounts;
+		Array<unsigned int> vertexIndices;
+		Array<unsigned int> uvIndices;
+		Array<unsigned int> normalIndices;
+};
+
+typedef BasicObjData<std::allocator> ObjData;
+typedef BasicObjData<std::pmr::polymorphic_allocator> PmrObjData;
+
+// Bytes held by the arrays of data
+template <template <typename> class Allocator>
+size_t objDataBytes(const BasicObjData<Allocator>& data){
+	return data.vertices.size() * sizeof(glm::vec3)
+		+ data.uvs.size() * sizeof(glm::vec2)
+		+ data.normals.size() * sizeof(glm::vec3)
+		+ (data.verticesPerFaceCounts.size() + data.vertexIndices.size() + data.uvIndices.size() + data.normalIndices.size()) * sizeof(unsigned int);
+}
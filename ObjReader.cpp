@@ -4,25 +4,108 @@
 #include <filesystem>
 #include <sstream>
 #include <set>
+#include <charconv>
+#include <atomic>
+#include <cstring>
+#include <cfloat>
+#include <type_traits>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "ObjReader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "MeshCache.h"
+#include "Hash.h"
+#include "Bounds.h"
+#include "Trace.h"
 
 
 // Parse Wavefront .obj file
 // https://en.wikipedia.org/wiki/Wavefront_.obj_file
-void ObjReader::readObjAsIndexed(std::string objName, ObjData& outData, bool breakIntoTris){
-	
+bool ObjReader::readObjAsIndexed(std::string objName, ObjData& outData, bool breakIntoTris, Parser parser){
+	return readObjFile(objPath(objName), outData, breakIntoTris, parser);
+}
+
+bool ObjReader::readObjCached(std::string objName, ObjData& outData, bool breakIntoTris){
+	return readObjFileCached(objPath(objName), outData, breakIntoTris);
+}
+
+bool ObjReader::readObjFile(const std::string& targetFile, ObjData& outData, bool breakIntoTris, Parser parser){
+	TraceScope trace("ObjReader::readObjAsIndexed");
+
+	bool read;
+	if(parser == Parser::STREAM){
+		read = readObjStream(targetFile, outData, breakIntoTris);
+	} else {
+		read = readObjMapped(targetFile, outData, breakIntoTris, parser == Parser::PARALLEL ? threadCount : 1);
+	}
+	if(read && breakIntoTris){
+		trace.setTriangles(outData.vertexIndices.size() / 3);
+	}
+	return read;
+}
+
+bool ObjReader::readObjFileCached(const std::string& targetFile, ObjData& outData, bool breakIntoTris){
+	TraceScope trace("ObjReader::readObjCached");
+	cachedLoadStats = CachedLoadStats();
+	MeshCache cache(targetFile);
+	if(cache.load(outData, breakIntoTris, breakIntoTris)){
+		trace.setTriangles(breakIntoTris ? outData.vertexIndices.size() / 3 : 0);
+		return true;
+	}
+
+	if(!readObjFile(targetFile, outData, breakIntoTris)){
+		return false;
+	}
+	if(breakIntoTris){
+		cachedLoadStats.parsed = true;
+		NormalOptions options;
+		options.threadCount = threadCount;
+		cachedLoadStats.generatedNormals = generateMissingNormals(outData, options);
+		cachedLoadStats.triangleOrder = optimizeTriangleOrder(outData);
+	}
+	// Failing to write the cache (read-only data directory) only costs the next launch a parse
+	cache.store(outData, breakIntoTris, breakIntoTris);
+	trace.setTriangles(breakIntoTris ? outData.vertexIndices.size() / 3 : 0);
+	return true;
+}
 
-	std::string targetFile("../data/objects/" + objName + ".obj");
+void printCachedLoadStats(std::ostream& out, const ObjReader::CachedLoadStats& stats){
+	if(!stats.parsed){
+		return;
+	}
+	if(stats.generatedNormals > 0){
+		out << "Generated normals for " << stats.generatedNormals << " corners\n";
+	}
+	const MeshOptimizationStats& order = stats.triangleOrder;
+	out << "Optimized triangle order: ACMR " << order.cacheBefore.acmr << " -> " << order.cacheAfter.acmr
+		<< ", ATVR " << order.cacheBefore.atvr << " -> " << order.cacheAfter.atvr << "\n";
+}
+
+std::string ObjReader::objPath(const std::string& objName){
+	return "../data/objects/" + objName + ".obj";
+}
+
+// Original reader: one stringstream per line and per face token
+bool ObjReader::readObjStream(const std::string& targetFile, ObjData& outData, bool breakIntoTris){
 	std::ifstream inStream(targetFile);
+	if(!inStream.is_open()){
+		std::cerr << "Error: Cannot open file " << targetFile << std::endl;
+		return false;
+	}
 
 	std::string currentLine;
 	std::string token;
 	std::string partialToken;
 	std::string delimiter("/");
 
+	// Faces go through the same storeFace as the mapped reader, without the per line Face vectors
+	std::vector<std::unique_ptr<Fragment>> fragments;
+	fragments.emplace_back(new Fragment(memoryResource));
+	PmrObjData& data = fragments[0]->data;
+	AttributeList faceScratch(memoryResource);
+
 	int verticesPerFaceCount;
 	while (getline(inStream, currentLine)) {
 		// Output the text from the file
@@ -38,7 +121,7 @@ void ObjReader::readObjAsIndexed(std::string objName, ObjData& outData, bool bre
 			vertex.y = std::stof(token);
 			currentLineStream >> token;
 			vertex.z = std::stof(token);
-			outData.vertices.push_back(vertex);
+			data.vertices.push_back(vertex);
 			
 		} else if(token.compare("vt") == 0){
 			glm::vec2 uv;
@@ -46,7 +129,7 @@ void ObjReader::readObjAsIndexed(std::string objName, ObjData& outData, bool bre
 			uv.x = std::stof(token);
 			currentLineStream >> token;
 			uv.y = std::stof(token);
-			outData.uvs.push_back(uv);
+			data.uvs.push_back(uv);
 
 		} else if(token.compare("vn") == 0){
 			glm::vec3 normal;
@@ -56,79 +139,636 @@ void ObjReader::readObjAsIndexed(std::string objName, ObjData& outData, bool bre
 			normal.y = std::stof(token);
 			currentLineStream >> token;
 			normal.z = std::stof(token);
-			outData.normals.push_back(normal);
+			data.normals.push_back(normal);
 
 		} else if(token.compare("f") == 0){
-			std::vector<Face> allFaces;
-
-			Face readInFace;
+			faceScratch.clear();
 			while(currentLineStream >> token){
 				Attribute attribute;
 				parseVertexAttribute(token, attribute);
-				readInFace.attributes.push_back(attribute);
-				
-				
+				faceScratch.push_back(attribute);
 			}
-			
-			
+			storeFace(faceScratch, *fragments[0], breakIntoTris);
+		}
+	}
+
+	PolygonList polygons(memoryResource);
+	mergeFragments(fragments, outData, polygons, 1);
+	triangulatePolygons(outData, polygons, 1);
+
+	// Close the file
+	inStream.close(); 
+	
+
+	return true;
+}
+
+// Zero-copy reader: maps the file and tokenizes it in place.
+// The file is cut into line aligned chunks parsed independently, then merged in file order,
+// so the result doesn't depend on the number of workers.
+bool ObjReader::readObjMapped(const std::string& targetFile, ObjData& outData, bool breakIntoTris, unsigned int workers){
+	TraceScope trace("ObjReader::readObjMapped");
+	MappedFile file(targetFile);
+	if(file.wasError()){
+		return false;
+	}
+	trace.setBytes(file.size());
+
+	// Small chunks aren't worth a thread
+	const size_t minChunkSize = 1 << 20;
+	workers = resolveThreadCount(workers);
+	size_t chunkCount = 1;
+	if(workers > 1){
+		chunkCount = std::max<size_t>(1, std::min<size_t>(workers * 4, file.size() / minChunkSize));
+	}
+
+	// Chunk i starts after the first newline at or past i * size / chunkCount
+	const char* begin = file.data();
+	const char* end = file.data() + file.size();
+	std::vector<const char*> boundaries(chunkCount + 1, end);
+	boundaries[0] = begin;
+	for(size_t i = 1; i < chunkCount; i++){
+		const char* nominal = std::max(begin + file.size() * i / chunkCount, boundaries[i - 1]);
+		const char* newline = (const char*)memchr(nominal, '\n', end - nominal);
+		boundaries[i] = newline == nullptr ? end : newline + 1;
+	}
+
+	// Each chunk is counted first, so its arrays are allocated once at their final size
+	std::vector<std::unique_ptr<Fragment>> fragments(chunkCount);
+	parallelFor(chunkCount, workers, [&](size_t i){
+		TraceScope chunkTrace("ObjReader::parseObjRange");
+		chunkTrace.setBytes(boundaries[i + 1] - boundaries[i]);
+		fragments[i].reset(new Fragment(memoryResource, scanObjRange(boundaries[i], boundaries[i + 1], breakIntoTris)));
+		AttributeList faceScratch(memoryResource);
+		parseObjRange(boundaries[i], boundaries[i + 1], *fragments[i], breakIntoTris, faceScratch);
+	});
+
+	PolygonList polygons(memoryResource);
+	mergeFragments(fragments, outData, polygons, workers);
+	triangulatePolygons(outData, polygons, workers);
+	return true;
+}
+
+// Append the fragments to outData in order. Offsets of every array are prefix sums of the
+// fragment sizes; relative indices are shifted by the number of elements before their chunk.
+// The polygons of all fragments are collected in outPolygons, pointing into outData.
+void ObjReader::mergeFragments(std::vector<std::unique_ptr<Fragment>>& fragments, ObjData& outData, PolygonList& outPolygons, unsigned int workers){
+	TraceScope trace("ObjReader::mergeFragments");
+
+	class Offsets {
+		public:
+			size_t vertices, uvs, normals, faces, indices, polygons;
+	};
+
+	std::vector<Offsets> offsets(fragments.size() + 1);
+	offsets[0] = { outData.vertices.size(), outData.uvs.size(), outData.normals.size(), outData.verticesPerFaceCounts.size(), outData.vertexIndices.size(), 0 };
+	for(size_t i = 0; i < fragments.size(); i++){
+		const PmrObjData& data = fragments[i]->data;
+		offsets[i + 1].vertices = offsets[i].vertices + data.vertices.size();
+		offsets[i + 1].uvs = offsets[i].uvs + data.uvs.size();
+		offsets[i + 1].normals = offsets[i].normals + data.normals.size();
+		offsets[i + 1].faces = offsets[i].faces + data.verticesPerFaceCounts.size();
+		offsets[i + 1].indices = offsets[i].indices + data.vertexIndices.size();
+		offsets[i + 1].polygons = offsets[i].polygons + fragments[i]->polygons.size();
+	}
+
+	const Offsets& total = offsets.back();
+	outData.vertices.resize(total.vertices);
+	outData.uvs.resize(total.uvs);
+	outData.normals.resize(total.normals);
+	outData.verticesPerFaceCounts.resize(total.faces);
+	outData.vertexIndices.resize(total.indices);
+	outData.uvIndices.resize(total.indices);
+	outData.normalIndices.resize(total.indices);
+	outPolygons.resize(total.polygons);
+
+	parallelFor(fragments.size(), workers, [&](size_t i){
+		Fragment& fragment = *fragments[i];
+		const PmrObjData& data = fragment.data;
+		const Offsets& offset = offsets[i];
+
+		std::copy(data.vertices.begin(), data.vertices.end(), outData.vertices.begin() + offset.vertices);
+		std::copy(data.uvs.begin(), data.uvs.end(), outData.uvs.begin() + offset.uvs);
+		std::copy(data.normals.begin(), data.normals.end(), outData.normals.begin() + offset.normals);
+		std::copy(data.verticesPerFaceCounts.begin(), data.verticesPerFaceCounts.end(), outData.verticesPerFaceCounts.begin() + offset.faces);
+		std::copy(data.vertexIndices.begin(), data.vertexIndices.end(), outData.vertexIndices.begin() + offset.indices);
+		std::copy(data.uvIndices.begin(), data.uvIndices.end(), outData.uvIndices.begin() + offset.indices);
+		std::copy(data.normalIndices.begin(), data.normalIndices.end(), outData.normalIndices.begin() + offset.indices);
+
+		for(size_t position : fragment.relativeVertexIndices){
+			outData.vertexIndices[offset.indices + position] += offset.vertices;
+		}
+		for(size_t position : fragment.relativeUvIndices){
+			outData.uvIndices[offset.indices + position] += offset.uvs;
+		}
+		for(size_t position : fragment.relativeNormalIndices){
+			outData.normalIndices[offset.indices + position] += offset.normals;
+		}
+		for(size_t i = 0; i < fragment.polygons.size(); i++){
+			outPolygons[offset.polygons + i] = { offset.indices + fragment.polygons[i].firstCorner, fragment.polygons[i].cornerCount };
+		}
+
+		// Release the fragment as soon as it's merged to keep the peak down
+		fragments[i].reset();
+	});
+}
+
+namespace {
+	inline bool isBlank(char c){
+		return c == ' ' || c == '\t' || c == '\r';
+	}
 
-			if(breakIntoTris){
-				breakFaceIntoTris(readInFace, allFaces);
-			} else{
-				allFaces.push_back(readInFace);
+	inline const char* skipBlanks(const char* p, const char* end){
+		while(p < end && isBlank(*p)){
+			p++;
+		}
+		return p;
+	}
+
+	// Next whitespace separated token of the line, or an empty view at the end of the line
+	inline std::string_view nextToken(const char*& p, const char* end){
+		p = skipBlanks(p, end);
+		const char* start = p;
+		while(p < end && !isBlank(*p)){
+			p++;
+		}
+		return std::string_view(start, p - start);
+	}
+
+	// Same values as std::stof, which also accepts a leading '+'
+	inline float toFloat(std::string_view token){
+		if(!token.empty() && token[0] == '+'){
+			token.remove_prefix(1);
+		}
+		float value = 0.0f;
+		std::from_chars(token.data(), token.data() + token.size(), value);
+		return value;
+	}
+
+	inline int toInt(std::string_view token){
+		if(!token.empty() && token[0] == '+'){
+			token.remove_prefix(1);
+		}
+		int value = 0;
+		std::from_chars(token.data(), token.data() + token.size(), value);
+		return value;
+	}
+}
+
+ObjReader::Fragment::Fragment(std::pmr::memory_resource* resource)
+	: data(resource), relativeVertexIndices(resource), relativeUvIndices(resource), relativeNormalIndices(resource), polygons(resource) {
+}
+
+ObjReader::Fragment::Fragment(std::pmr::memory_resource* resource, const RecordCounts& counts)
+	: arena(new std::pmr::monotonic_buffer_resource(
+		counts.vertices * sizeof(glm::vec3) + counts.uvs * sizeof(glm::vec2) + counts.normals * sizeof(glm::vec3)
+		+ (counts.faces + counts.corners * 3) * sizeof(unsigned int) + counts.polygons * sizeof(Polygon)
+		// Alignment of each array, the arena's own bookkeeping and the first few relative indices
+		+ 4096, resource)),
+	data(arena.get()), relativeVertexIndices(arena.get()), relativeUvIndices(arena.get()), relativeNormalIndices(arena.get()), polygons(arena.get()) {
+	data.vertices.reserve(counts.vertices);
+	data.uvs.reserve(counts.uvs);
+	data.normals.reserve(counts.normals);
+	data.verticesPerFaceCounts.reserve(counts.faces);
+	data.vertexIndices.reserve(counts.corners);
+	data.uvIndices.reserve(counts.corners);
+	data.normalIndices.reserve(counts.corners);
+	polygons.reserve(counts.polygons);
+}
+
+ObjReader::TriangulationScratch::TriangulationScratch(std::pmr::memory_resource* resource)
+	: corners(resource), projected(resource), remaining(resource), triangles(resource) {
+}
+
+// Count the records parseObjRange will store for [begin, end): the keyword of every line and
+// the corners of every face, without converting any numbers
+ObjReader::RecordCounts ObjReader::scanObjRange(const char* begin, const char* end, bool breakIntoTris){
+	RecordCounts counts;
+	const char* lineStart = begin;
+	while(lineStart < end){
+		const char* lineEnd = (const char*)memchr(lineStart, '\n', end - lineStart);
+		if(lineEnd == nullptr){
+			lineEnd = end;
+		}
+
+		const char* p = lineStart;
+		std::string_view keyword = nextToken(p, lineEnd);
+		if(keyword == "v"){
+			counts.vertices++;
+		} else if(keyword == "vt"){
+			counts.uvs++;
+		} else if(keyword == "vn"){
+			counts.normals++;
+		} else if(keyword == "f"){
+			size_t cornerCount = 0;
+			while(!nextToken(p, lineEnd).empty()){
+				cornerCount++;
+			}
+			if(!breakIntoTris){
+				counts.faces++;
+				counts.corners += cornerCount;
+			} else if(cornerCount >= 3){
+				counts.faces += cornerCount - 2;
+				counts.corners += 3 * (cornerCount - 2);
+				counts.polygons += cornerCount > 4;
 			}
+		}
 
-			// Store
-			for(Face& currentFace : allFaces){
-				
+		lineStart = lineEnd + 1;
+	}
+	return counts;
+}
 
-				for(Attribute& currentAttribute : currentFace.attributes){
-					// Subtract 1 from final since obj is 1 indexed and arrays are 0 indexed. 
-					// OpenGL matches arrays starting from index 0.
-					outData.vertexIndices.push_back(currentAttribute.vertexIndex-1);
-					outData.uvIndices.push_back(currentAttribute.uvIndex-1);
-					outData.normalIndices.push_back(currentAttribute.normalIndex-1);
-					
-				}
+// Parse the records in [begin, end). Lines are split on '\n' and tokens are views into the mapping,
+// so nothing is allocated apart from the output arrays (once, when they were reserved from counts).
+void ObjReader::parseObjRange(const char* begin, const char* end, Fragment& outFragment, bool breakIntoTris, AttributeList& faceScratch){
+	PmrObjData& outData = outFragment.data;
+
+	// Negative indices count back from the end of the list read so far (-1 is the last element).
+	// Resolved against this chunk's counts here, the merge adds the counts of earlier chunks.
+	auto resolveRelative = [](unsigned int& index, size_t count, unsigned char bit, unsigned char& mask){
+		int value = (int)index;
+		if(value < 0){
+			index = (unsigned int)(count + value + 1);
+			mask |= bit;
+		}
+	};
+
+	const char* lineStart = begin;
+	while(lineStart < end){
+		const char* lineEnd = (const char*)memchr(lineStart, '\n', end - lineStart);
+		if(lineEnd == nullptr){
+			lineEnd = end;
+		}
+
+		const char* p = lineStart;
+		std::string_view keyword = nextToken(p, lineEnd);
+
+		if(keyword == "v"){
+			glm::vec3 vertex;
+			vertex.x = toFloat(nextToken(p, lineEnd));
+			vertex.y = toFloat(nextToken(p, lineEnd));
+			vertex.z = toFloat(nextToken(p, lineEnd));
+			outData.vertices.push_back(vertex);
+
+		} else if(keyword == "vt"){
+			glm::vec2 uv;
+			uv.x = toFloat(nextToken(p, lineEnd));
+			uv.y = toFloat(nextToken(p, lineEnd));
+			outData.uvs.push_back(uv);
+
+		} else if(keyword == "vn"){
+			glm::vec3 normal;
+			normal.x = toFloat(nextToken(p, lineEnd));
+			normal.y = toFloat(nextToken(p, lineEnd));
+			normal.z = toFloat(nextToken(p, lineEnd));
+			outData.normals.push_back(normal);
 
-				outData.verticesPerFaceCounts.push_back(currentFace.attributes.size());
-				
+		} else if(keyword == "f"){
+			faceScratch.clear();
+			for(std::string_view token = nextToken(p, lineEnd); !token.empty(); token = nextToken(p, lineEnd)){
+				Attribute attribute;
+				parseVertexAttribute(token, attribute);
+				resolveRelative(attribute.vertexIndex, outData.vertices.size(), 1, attribute.relativeMask);
+				resolveRelative(attribute.uvIndex, outData.uvs.size(), 2, attribute.relativeMask);
+				resolveRelative(attribute.normalIndex, outData.normals.size(), 4, attribute.relativeMask);
+				faceScratch.push_back(attribute);
 			}
+			storeFace(faceScratch, outFragment, breakIntoTris);
 		}
+
+		lineStart = lineEnd + 1;
 	}
+}
 
-	// Close the file
-	inStream.close(); 
-	
+// Store a face with 0 based indices, split into triangles if asked. Quads always use the same
+// diagonal; larger polygons keep their corners in the slots of their triangles until
+// triangulatePolygons, because their positions may be in an earlier chunk.
+void ObjReader::storeFace(const AttributeList& attributes, Fragment& outFragment, bool breakIntoTris){
+	static const unsigned int quadTriangles[6] = {0, 2, 3, 0, 1, 2};
+	PmrObjData& outData = outFragment.data;
+
+	auto store = [&](const Attribute& attribute){
+		if(attribute.relativeMask != 0){
+			size_t position = outData.vertexIndices.size();
+			if(attribute.relativeMask & 1){
+				outFragment.relativeVertexIndices.push_back(position);
+			}
+			if(attribute.relativeMask & 2){
+				outFragment.relativeUvIndices.push_back(position);
+			}
+			if(attribute.relativeMask & 4){
+				outFragment.relativeNormalIndices.push_back(position);
+			}
+		}
+		outData.vertexIndices.push_back(attribute.vertexIndex-1);
+		outData.uvIndices.push_back(attribute.uvIndex-1);
+		outData.normalIndices.push_back(attribute.normalIndex-1);
+	};
 
-	return;
+	if(!breakIntoTris){
+		for(const Attribute& attribute : attributes){
+			store(attribute);
+		}
+		outData.verticesPerFaceCounts.push_back(attributes.size());
+	} else if(attributes.size() == 3){
+		for(const Attribute& attribute : attributes){
+			store(attribute);
+		}
+		outData.verticesPerFaceCounts.push_back(3);
+	} else if(attributes.size() == 4){
+		// Fan from the first corner, last triangle first
+		for(int i = 0; i < 6; i++){
+			store(attributes[quadTriangles[i]]);
+			if(i % 3 == 2){
+				outData.verticesPerFaceCounts.push_back(3);
+			}
+		}
+	} else if(attributes.size() > 4){
+		const size_t triangleCount = attributes.size() - 2;
+		outFragment.polygons.push_back({ outData.vertexIndices.size(), (unsigned int)attributes.size() });
+		for(const Attribute& attribute : attributes){
+			store(attribute);
+		}
+		size_t slots = outData.vertexIndices.size() + triangleCount * 3 - attributes.size();
+		outData.vertexIndices.resize(slots);
+		outData.uvIndices.resize(slots);
+		outData.normalIndices.resize(slots);
+		outData.verticesPerFaceCounts.resize(outData.verticesPerFaceCounts.size() + triangleCount, 3);
+	}
 }
 
-void ObjReader::indexedToSeparateTriangles(const ObjData& inData, ObjData& outData){
+// Split the stored polygons in place. Each worker has its own scratch, so after the first few
+// faces nothing is allocated.
+template <typename Data>
+void ObjReader::triangulatePolygons(Data& data, const PolygonList& polygons, unsigned int workers){
+	TraceScope trace("ObjReader::triangulatePolygons");
+	parallelForRange(polygons.size(), 1 << 12, workers, [&](size_t begin, size_t end){
+		TriangulationScratch scratch(memoryResource);
+		for(size_t i = begin; i < end; i++){
+			breakFaceIntoTris(data, polygons[i], scratch);
+		}
+	});
+}
 
-	
-	for(int i = 0; i < inData.vertexIndices.size(); i++){
-		unsigned int vertexIndex = inData.vertexIndices[i];
-		const glm::vec3& vert = inData.vertices[vertexIndex];
-		outData.vertices.push_back(vert);	
+// Expand indexed data into one position (and normal/uv when the file has them) per corner.
+// All indices are validated in a first pass, so the gather itself can't fail. Outputs are sized
+// once and filled in parallel over index ranges. Corners of faces written without a normal or uv
+// (stored as index 0-1) get a zero vector. Returns false on an out of range index.
+bool ObjReader::indexedToSeparateTriangles(const ObjData& inData, ObjData& outData){
+	TraceScope trace("ObjReader::indexedToSeparateTriangles");
+	const size_t cornerCount = inData.vertexIndices.size();
+	const bool hasNormals = !inData.normals.empty();
+	const bool hasUvs = !inData.uvs.empty();
+	const size_t minRange = 1 << 16;
+	const unsigned int missing = (unsigned int)-1;
+
+	if(inData.uvIndices.size() != cornerCount || inData.normalIndices.size() != cornerCount){
+		std::cerr << "Error: Reading Obj File" << std::endl;
+		return false;
 	}
 
-	
-	/**/for (int i = 0; i < inData.normalIndices.size(); i++) {
-		try {
-			unsigned int normalIndex = inData.normalIndices.at(i);
-			const glm::vec3& normal = inData.normals.at(normalIndex);
-			outData.normals.push_back(normal);	
+	// Bounds check
+	std::atomic<bool> valid(true);
+	parallelForRange(cornerCount, minRange, threadCount, [&](size_t begin, size_t end){
+		const size_t vertexCount = inData.vertices.size();
+		const size_t normalCount = inData.normals.size();
+		const size_t uvCount = inData.uvs.size();
+		bool rangeValid = true;
+		for(size_t i = begin; i < end; i++){
+			rangeValid &= inData.vertexIndices[i] < vertexCount;
+			rangeValid &= !hasNormals || inData.normalIndices[i] < normalCount || inData.normalIndices[i] == missing;
+			rangeValid &= !hasUvs || inData.uvIndices[i] < uvCount || inData.uvIndices[i] == missing;
 		}
-		catch(...) {
-			std::cerr << "Error: Reading Obj File" << std::endl;
-			exit(1);
+		if(!rangeValid){
+			valid = false;
 		}
+	});
+	if(!valid){
+		std::cerr << "Error: Reading Obj File" << std::endl;
+		return false;
 	}
+
+	outData.vertices.resize(cornerCount);
+	outData.normals.resize(hasNormals ? cornerCount : 0);
+	outData.uvs.resize(hasUvs ? cornerCount : 0);
+
+	// Gather
+	parallelForRange(cornerCount, minRange, threadCount, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			outData.vertices[i] = inData.vertices[inData.vertexIndices[i]];
+		}
+		if(hasNormals){
+			for(size_t i = begin; i < end; i++){
+				unsigned int normalIndex = inData.normalIndices[i];
+				outData.normals[i] = normalIndex == missing ? glm::vec3(0.0f) : inData.normals[normalIndex];
+			}
+		}
+		if(hasUvs){
+			for(size_t i = begin; i < end; i++){
+				unsigned int uvIndex = inData.uvIndices[i];
+				outData.uvs[i] = uvIndex == missing ? glm::vec2(0.0f) : inData.uvs[uvIndex];
+			}
+		}
+	});
+	trace.setBytes(cornerCount * sizeof(glm::vec3) + outData.normals.size() * sizeof(glm::vec3) + outData.uvs.size() * sizeof(glm::vec2));
+	trace.setTriangles(cornerCount / 3);
+	return true;
 }
 
+// Weld identical corners of a separate-triangle mesh (as made by indexedToSeparateTriangles).
+// Corners with bitwise equal position, normal and uv become one vertex; outData gets the unique
+// vertices (and normals/uvs when the input has them) plus one vertexIndices entry per corner,
+// which indexes all attribute arrays. Open addressing over corner ids keeps it to one pass.
+void ObjReader::separateTrianglesToIndexed(const ObjData& inData, ObjData& outData){
+	const size_t cornerCount = inData.vertices.size();
+	const bool hasNormals = inData.normals.size() == cornerCount;
+	const bool hasUvs = inData.uvs.size() == cornerCount;
+
+	outData.vertices.clear();
+	outData.normals.clear();
+	outData.uvs.clear();
+	outData.verticesPerFaceCounts.clear();
+	outData.uvIndices.clear();
+	outData.normalIndices.clear();
+	outData.vertexIndices.resize(cornerCount);
+
+	auto cornerHash = [&](size_t corner){
+		uint64_t hash = fnv1a64(&inData.vertices[corner], sizeof(glm::vec3));
+		if(hasNormals){
+			hash = fnv1a64(&inData.normals[corner], sizeof(glm::vec3), hash);
+		}
+		if(hasUvs){
+			hash = fnv1a64(&inData.uvs[corner], sizeof(glm::vec2), hash);
+		}
+		return hash;
+	};
+
+	// Compares a corner against an already emitted unique vertex
+	auto sameCorner = [&](size_t corner, unsigned int vertex){
+		return memcmp(&inData.vertices[corner], &outData.vertices[vertex], sizeof(glm::vec3)) == 0
+			&& (!hasNormals || memcmp(&inData.normals[corner], &outData.normals[vertex], sizeof(glm::vec3)) == 0)
+			&& (!hasUvs || memcmp(&inData.uvs[corner], &outData.uvs[vertex], sizeof(glm::vec2)) == 0);
+	};
+
+	// Table of unique vertex ids, at most half full
+	size_t tableSize = 16;
+	while(tableSize < cornerCount * 2){
+		tableSize *= 2;
+	}
+	const unsigned int emptySlot = ~0u;
+	std::vector<unsigned int> table(tableSize, emptySlot);
+
+	for(size_t corner = 0; corner < cornerCount; corner++){
+		size_t slot = cornerHash(corner) & (tableSize - 1);
+		while(table[slot] != emptySlot && !sameCorner(corner, table[slot])){
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if(table[slot] == emptySlot){
+			table[slot] = (unsigned int)outData.vertices.size();
+			outData.vertices.push_back(inData.vertices[corner]);
+			if(hasNormals){
+				outData.normals.push_back(inData.normals[corner]);
+			}
+			if(hasUvs){
+				outData.uvs.push_back(inData.uvs[corner]);
+			}
+		}
+		outData.vertexIndices[corner] = table[slot];
+	}
+}
+
+size_t ObjReader::generateMissingNormals(ObjData& data, const NormalOptions& options){
+	const unsigned int missing = (unsigned int)-1;
+	const size_t cornerCount = data.vertexIndices.size();
+	size_t missingCount = 0;
+	if(data.normals.empty()){
+		missingCount = cornerCount;
+	} else {
+		for(unsigned int normalIndex : data.normalIndices){
+			missingCount += normalIndex == missing;
+		}
+	}
+	if(missingCount == 0 || data.normalIndices.size() != cornerCount){
+		return 0;
+	}
+
+	std::vector<glm::vec3> normals;
+	std::vector<unsigned int> normalIndices;
+	if(!generateNormals(data.vertices, data.vertexIndices, options, normals, normalIndices)){
+		return 0;
+	}
+	if(missingCount == cornerCount){
+		data.normals = std::move(normals);
+		data.normalIndices = std::move(normalIndices);
+		return cornerCount;
+	}
+	// Only some faces lack normals: the generated ones their corners use go after the file's, in
+	// order of first use, and the rest are dropped
+	std::vector<unsigned int> remap(normals.size(), missing);
+	for(size_t corner = 0; corner < cornerCount; corner++){
+		if(data.normalIndices[corner] != missing){
+			continue;
+		}
+		unsigned int generated = normalIndices[corner];
+		if(remap[generated] == missing){
+			remap[generated] = (unsigned int)data.normals.size();
+			data.normals.push_back(normals[generated]);
+		}
+		data.normalIndices[corner] = remap[generated];
+	}
+	return missingCount;
+}
+
+MeshOptimizationStats ObjReader::optimizeTriangleOrder(ObjData& data, bool measureOverdraw){
+	TraceScope trace("ObjReader::optimizeTriangleOrder");
+	MeshOptimizationStats stats;
+	const size_t cornerCount = data.vertexIndices.size();
+	if(cornerCount < 3 || data.verticesPerFaceCounts.size() * 3 != cornerCount
+		|| data.uvIndices.size() != cornerCount || data.normalIndices.size() != cornerCount){
+		return stats;
+	}
+	trace.setTriangles(cornerCount / 3);
+
+	// Number the distinct v/vt/vn triples the way welding will, open addressing as in separateTrianglesToIndexed
+	std::vector<unsigned int> corners(cornerCount);
+	std::vector<glm::vec3> positions;
+	{
+		size_t tableSize = 16;
+		while(tableSize < cornerCount * 2){
+			tableSize *= 2;
+		}
+		const unsigned int emptySlot = ~0u;
+		std::vector<unsigned int> table(tableSize, emptySlot);
+		std::vector<size_t> firstCorners;
+		auto sameTriple = [&](size_t a, size_t b){
+			return data.vertexIndices[a] == data.vertexIndices[b] && data.uvIndices[a] == data.uvIndices[b] && data.normalIndices[a] == data.normalIndices[b];
+		};
+		for(size_t corner = 0; corner < cornerCount; corner++){
+			unsigned int triple[3] = { data.vertexIndices[corner], data.uvIndices[corner], data.normalIndices[corner] };
+			size_t slot = fnv1a64(triple, sizeof(triple)) & (tableSize - 1);
+			while(table[slot] != emptySlot && !sameTriple(corner, firstCorners[table[slot]])){
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if(table[slot] == emptySlot){
+				table[slot] = (unsigned int)firstCorners.size();
+				firstCorners.push_back(corner);
+				positions.push_back(data.vertices[data.vertexIndices[corner]]);
+			}
+			corners[corner] = table[slot];
+		}
+	}
+
+	stats.cacheBefore = analyzeVertexCache(corners, positions.size());
+	if(measureOverdraw){
+		stats.overdrawBefore = analyzeOverdraw(corners, positions);
+	}
+
+	std::vector<unsigned int> triangleOrder;
+	std::vector<unsigned int> clusterStarts;
+	optimizeVertexCache(corners, positions.size(), triangleOrder, clusterStarts);
+	optimizeOverdraw(corners, positions, triangleOrder, clusterStarts);
 
+	auto permuteTriangles = [&](std::vector<unsigned int>& array){
+		std::vector<unsigned int> reordered(cornerCount);
+		for(size_t i = 0; i < triangleOrder.size(); i++){
+			for(size_t c = 0; c < 3; c++){
+				reordered[i * 3 + c] = array[triangleOrder[i] * 3 + c];
+			}
+		}
+		array.swap(reordered);
+	};
+	permuteTriangles(data.vertexIndices);
+	permuteTriangles(data.uvIndices);
+	permuteTriangles(data.normalIndices);
+
+	// Each attribute array in order of first use; missing uv/normal indices (0-1) stay as they are
+	auto reorderAttribute = [&](auto& attribute, std::vector<unsigned int>& attributeIndices){
+		std::vector<unsigned int> remap;
+		optimizeVertexFetch(attributeIndices, attribute.size(), remap);
+		std::remove_reference_t<decltype(attribute)> reordered(attribute.size());
+		for(size_t i = 0; i < attribute.size(); i++){
+			reordered[remap[i]] = attribute[i];
+		}
+		attribute.swap(reordered);
+		for(unsigned int& index : attributeIndices){
+			if(index < remap.size()){
+				index = remap[index];
+			}
+		}
+	};
+	reorderAttribute(data.vertices, data.vertexIndices);
+	reorderAttribute(data.uvs, data.uvIndices);
+	reorderAttribute(data.normals, data.normalIndices);
 
+	permuteTriangles(corners);
+	stats.cacheAfter = analyzeVertexCache(corners, positions.size());
+	if(measureOverdraw){
+		stats.overdrawAfter = analyzeOverdraw(corners, positions);
+	}
+	return stats;
+}
 
 // Scale down object to [-1,-1] and [1,1] bounds
 void ObjReader::scaleToClipCoords(ObjData& data){
@@ -138,20 +778,47 @@ void ObjReader::scaleToClipCoords(ObjData& data){
 	if(data.vertices.size() == 0){
 		return;
 	}
+	TraceScope trace("ObjReader::scaleToClipCoords");
+	trace.setBytes(data.vertices.size() * sizeof(glm::vec3));
 
-	// Find min and max distance
-	float maxDistance = glm::length(data.vertices[0]);
-	for(glm::vec3& vert : data.vertices){
-		float distance = glm::length(vert);
-		if(distance > maxDistance){
-			maxDistance = distance;
-		}
+	// Find max distance
+	Bounds bounds = computeBounds(data.vertices, threadCount);
+	if(bounds.maxDistance == 0.0f){
+		return;
 	}
 
-	// Manual CPU clip coord scale
-	glm::mat4 ortho = glm::ortho(-maxDistance, maxDistance, -maxDistance, maxDistance, -maxDistance, maxDistance);
-	for(glm::vec3& vert : data.vertices){
-		vert = ortho * glm::vec4(vert, 1);
+	// glm::ortho(-d, d, -d, d, -d, d) only scales: x/d, y/d and -z/d. Apply that directly
+	// instead of a full matrix multiply per vertex; the results are bit-identical.
+	float scale = 1.0f / bounds.maxDistance;
+	scalePositions(data.vertices, glm::vec3(scale, scale, -scale), threadCount);
+}
+
+// Parse #vertex_index/#texture_index/#normal_index from a view into the mapped file
+void ObjReader::parseVertexAttribute(std::string_view token, Attribute& outAttribute){
+	int i = 0;
+	while(i < 3){
+		size_t slash = token.find('/');
+		std::string_view partialToken = token.substr(0, slash);
+
+		if(partialToken.length() > 0){
+			unsigned int value = toInt(partialToken);
+
+			if(i == 0){ // Vertex
+				outAttribute.vertexIndex = value;
+			} else if(i == 1){ // Texture/UV
+				outAttribute.uvIndex = value;
+			} else if(i == 2){ // Normal
+				outAttribute.normalIndex = value;
+			}
+		}
+
+		if(slash == std::string_view::npos){
+			break;
+		}
+		token.remove_prefix(slash + 1);
+
+		// Next attribute in vertex
+		i++;
 	}
 }
 
@@ -180,27 +847,150 @@ void ObjReader::parseVertexAttribute(std::string& token, Attribute& outAttribute
 	}
 }
 
-void ObjReader::breakFaceIntoTris(const Face& face, std::vector<Face>& outFaces){
-	if(face.attributes.size() == 3){
-		// Triangles have 3 vertices. Just return that.
-		outFaces.push_back(face);
-	} else if(face.attributes.size() == 4) {
-		// Quads have 4 vertices
-		// Break into 2 triangles.
-		// Points 1, 2, 3 in first triangle
-		// Points 1, 3, 4 in second triangle.  
-		Face face1;
-		Face face2;
+namespace {
+	inline float cross2(const glm::vec2& a, const glm::vec2& b){
+		return a.x * b.y - a.y * b.x;
+	}
+
+	// Inside, on or within tolerance of the edges of the counter clockwise triangle abc
+	inline bool inTriangle(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, float tolerance){
+		return cross2(b - a, p - a) >= -tolerance && cross2(c - b, p - b) >= -tolerance && cross2(a - c, p - c) >= -tolerance;
+	}
+}
+
+// Triangulate a polygon stored by storeFace. Convex polygons are split as a fan from the first
+// corner like quads; concave ones are ear clipped in the plane of the polygon. Triangles keep
+// the winding of the face. Polygons with unknown or degenerate positions fall back to the fan.
+template <typename Data>
+void ObjReader::breakFaceIntoTris(Data& data, const Polygon& polygon, TriangulationScratch& scratch){
+	const unsigned int n = polygon.cornerCount;
+	const size_t first = polygon.firstCorner;
+
+	AttributeList& corners = scratch.corners;
+	corners.resize(n);
+	bool knownPositions = true;
+	for(unsigned int i = 0; i < n; i++){
+		corners[i].vertexIndex = data.vertexIndices[first + i];
+		corners[i].uvIndex = data.uvIndices[first + i];
+		corners[i].normalIndex = data.normalIndices[first + i];
+		knownPositions &= corners[i].vertexIndex < data.vertices.size();
+	}
+
+	std::pmr::vector<unsigned int>& triangles = scratch.triangles;
+	triangles.clear();
+	auto fan = [&](){
+		for(unsigned int i = n - 2; i >= 1; i--){
+			triangles.push_back(0);
+			triangles.push_back(i);
+			triangles.push_back(i + 1);
+		}
+	};
+
+	// Newell's normal, then project onto the plane of its largest component so the polygon
+	// is counter clockwise in 2D
+	glm::vec3 normal(0.0f);
+	if(knownPositions){
+		for(unsigned int i = 0; i < n; i++){
+			const glm::vec3& a = data.vertices[corners[i].vertexIndex];
+			const glm::vec3& b = data.vertices[corners[(i + 1) % n].vertexIndex];
+			normal.x += (a.y - b.y) * (a.z + b.z);
+			normal.y += (a.z - b.z) * (a.x + b.x);
+			normal.z += (a.x - b.x) * (a.y + b.y);
+		}
+	}
+	glm::vec3 magnitude = glm::abs(normal);
+	int axis = magnitude.x > magnitude.y ? (magnitude.x > magnitude.z ? 0 : 2) : (magnitude.y > magnitude.z ? 1 : 2);
+
+	if(!knownPositions || normal[axis] == 0.0f){
+		fan();
+	} else {
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		if(normal[axis] < 0.0f){
+			std::swap(u, v);
+		}
 
-		face1.attributes.push_back(face.attributes[0]);
-		face1.attributes.push_back(face.attributes[2]);
-		face1.attributes.push_back(face.attributes[3]);
-		
-		face2.attributes.push_back(face.attributes[0]);
-		face2.attributes.push_back(face.attributes[1]);
-		face2.attributes.push_back(face.attributes[2]);
+		// Relative to the first corner to keep the precision of far away polygons
+		std::pmr::vector<glm::vec2>& projected = scratch.projected;
+		projected.resize(n);
+		const glm::vec3& origin = data.vertices[corners[0].vertexIndex];
+		glm::vec2 extent(0.0f);
+		for(unsigned int i = 0; i < n; i++){
+			glm::vec3 position = data.vertices[corners[i].vertexIndex] - origin;
+			projected[i] = glm::vec2(position[u], position[v]);
+			extent = glm::max(extent, glm::vec2(fabs(projected[i].x), fabs(projected[i].y)));
+		}
+
+		bool convex = true;
+		for(unsigned int i = 0; i < n && convex; i++){
+			const glm::vec2& a = projected[(i + n - 1) % n];
+			const glm::vec2& b = projected[i];
+			const glm::vec2& c = projected[(i + 1) % n];
+			convex = cross2(b - a, c - b) >= 0.0f;
+		}
+
+		if(convex){
+			fan();
+		} else {
+			// Ear clipping: cut off a convex corner whose triangle contains no other corner.
+			// Corners that are collinear with an edge up to rounding count as inside, so that
+			// straight runs of corners don't leave slivers. If a full lap finds no ear (self
+			// intersecting or degenerate input) the current corner is cut anyway so the polygon
+			// still produces n - 2 triangles.
+			// The tolerance is a distance from the edge scaled by the polygon size, since the
+			// cross products are edge length times distance. Far from the origin it has to cover
+			// the float spacing of the positions.
+			const float size = std::max(extent.x, extent.y);
+			const float magnitude = std::max(fabs(origin.x), std::max(fabs(origin.y), fabs(origin.z)));
+			const float tolerance = size * (1e-5f * size + 8.0f * FLT_EPSILON * magnitude);
+			std::pmr::vector<unsigned int>& remaining = scratch.remaining;
+			remaining.resize(n);
+			for(unsigned int i = 0; i < n; i++){
+				remaining[i] = i;
+			}
+
+			size_t current = 0;
+			size_t misses = 0;
+			while(remaining.size() > 3){
+				const size_t count = remaining.size();
+				current %= count;
+				unsigned int a = remaining[(current + count - 1) % count];
+				unsigned int b = remaining[current];
+				unsigned int c = remaining[(current + 1) % count];
+
+				bool ear = cross2(projected[b] - projected[a], projected[c] - projected[b]) > 0.0f;
+				for(size_t j = 0; j < count && ear; j++){
+					unsigned int other = remaining[j];
+					const glm::vec2& p = projected[other];
+					if(other != a && other != b && other != c && p != projected[a] && p != projected[b] && p != projected[c]){
+						ear = !inTriangle(p, projected[a], projected[b], projected[c], tolerance);
+					}
+				}
 
-		outFaces.push_back(face1);
-		outFaces.push_back(face2);
+				if(ear || misses >= count){
+					triangles.push_back(a);
+					triangles.push_back(b);
+					triangles.push_back(c);
+					remaining.erase(remaining.begin() + current);
+					misses = 0;
+				} else {
+					current++;
+					misses++;
+				}
+			}
+			triangles.push_back(remaining[0]);
+			triangles.push_back(remaining[1]);
+			triangles.push_back(remaining[2]);
+		}
+	}
+
+	for(size_t i = 0; i < triangles.size(); i++){
+		const Attribute& corner = corners[triangles[i]];
+		data.vertexIndices[first + i] = corner.vertexIndex;
+		data.uvIndices[first + i] = corner.uvIndex;
+		data.normalIndices[first + i] = corner.normalIndex;
 	}
 }
+
+// The streaming reader splits the polygons of each window in its fragment
+template void ObjReader::triangulatePolygons<PmrObjData>(PmrObjData& data, const PolygonList& polygons, unsigned int workers);
@@ -1,28 +1,172 @@
 #pragma once
 #include <string>
+#include <ostream>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include "ObjData.h"
+#include "MeshOptimizer.h"
+#include "NormalGenerator.h"
 
 class ObjReader {
 	public:
-		void readObjAsIndexed(std::string objName, ObjData& outData, bool breakIntoTris);
-		void indexedToSeparateTriangles(const ObjData& inData, ObjData& outData);
+		// STREAM is the original getline/stringstream reader, MAPPED walks a memory mapped file
+		// without allocating per line or token, PARALLEL splits the mapped file into line aligned
+		// chunks parsed on setThreadCount() workers. MAPPED and PARALLEL give bit-identical ObjData.
+		enum class Parser { STREAM, MAPPED, PARALLEL };
+
+		bool readObjAsIndexed(std::string objName, ObjData& outData, bool breakIntoTris, Parser parser = Parser::PARALLEL);
+		// Same result as readObjAsIndexed, but served from the binary sidecar when it is fresh.
+		// A text parse rewrites the sidecar. With breakIntoTris the triangles also go through
+		// generateMissingNormals and optimizeTriangleOrder before the sidecar is written, so those
+		// costs are paid once.
+		bool readObjCached(std::string objName, ObjData& outData, bool breakIntoTris);
+		// The same two for a file path, where the ones above take a model name in ../data/objects
+		bool readObjFile(const std::string& targetFile, ObjData& outData, bool breakIntoTris, Parser parser = Parser::PARALLEL);
+		bool readObjFileCached(const std::string& targetFile, ObjData& outData, bool breakIntoTris);
+
+		// What the last readObjCached did to the triangles after a text parse; everything stays zero
+		// when it was served from the sidecar or without breakIntoTris. The steps' times are in the trace.
+		class CachedLoadStats {
+			public:
+				bool parsed = false;
+				// Corners generateMissingNormals gave a normal
+				size_t generatedNormals = 0;
+				MeshOptimizationStats triangleOrder;
+		};
+		CachedLoadStats getCachedLoadStats() { return cachedLoadStats; }
+
+		// Memory accounting of readObjStreaming. peakBytes counts the read window, the retained
+		// v/vt/vn arrays, face indices and the batch handed to the consumer.
+		class StreamStats {
+			public:
+				size_t peakBytes = 0;
+				size_t triangles = 0;
+				size_t batches = 0;
+		};
+		// Returns false to stop the read, e.g. when the load was cancelled
+		typedef std::function<bool(const ObjData& batch)> BatchConsumer;
+
+		// Bounded memory loading: reads the file in fixed size windows and passes the triangles of
+		// each window to consumer as separate triangles (vertices, plus normals/uvs when the file
+		// has them), an empty batch for a window without faces. Only the v/vt/vn records are kept for the whole load. Fails if those would
+		// push the footprint over memoryCeiling bytes. A consumer stopping the read is not a failure.
+		bool readObjStreaming(std::string objName, size_t memoryCeiling, const BatchConsumer& consumer, StreamStats& outStats);
+
+		bool indexedToSeparateTriangles(const ObjData& inData, ObjData& outData);
 		void separateTrianglesToIndexed(const ObjData& inData, ObjData& outData);
 		void scaleToClipCoords(ObjData& data);
 
+		// Triangulated data (breakIntoTris) only: generateNormals for the corners the file gives no
+		// normal, which is all of them for the many scanned models without vn records. Normals in
+		// the file are kept. Returns the number of corners that got one.
+		size_t generateMissingNormals(ObjData& data, const NormalOptions& options = NormalOptions());
+
+		// Triangulated data (breakIntoTris) only: reorders the triangles for the post-transform
+		// vertex cache (optimizeVertexCache), then runs of them for overdraw (optimizeOverdraw),
+		// then the v/vt/vn arrays in order of first use. A vertex is a distinct v/vt/vn triple,
+		// as it becomes after welding. Overdraw is only measured with measureOverdraw, as it takes
+		// a software rasterization of the mesh before and after.
+		MeshOptimizationStats optimizeTriangleOrder(ObjData& data, bool measureOverdraw = false);
+
+		// File of a model name: ../data/objects/<objName>.obj
+		static std::string objPath(const std::string& objName);
+
+		// Workers used by the PARALLEL parser, 0 = all hardware threads
+		void setThreadCount(unsigned int count) { threadCount = count; }
+		// Where the parser's temporaries come from: each chunk of the file is parsed into an arena
+		// of its exact size taken from resource, which gets it back whole after the merge. The
+		// face and triangulation scratch come from it too. A RecyclingResource shared by the loads
+		// of a long running process lets them reuse it.
+		void setMemoryResource(std::pmr::memory_resource* resource) { memoryResource = resource; }
+
 	private:
 		class Attribute{
 			public:
-				unsigned int vertexIndex;
-				unsigned int uvIndex;
-				unsigned int normalIndex;
+				unsigned int vertexIndex = 0;
+				unsigned int uvIndex = 0;
+				unsigned int normalIndex = 0;
 
+				// Bits 0/1/2 set when the vertex/uv/normal index was negative (relative to the end of the list)
+				unsigned char relativeMask = 0;
 		};
 
-		class Face {
+		// A face of 5 or more corners waiting to be triangulated. It owns the 3 * (cornerCount - 2)
+		// index slots starting at firstCorner; the first cornerCount hold its corners in file order.
+		class Polygon {
 			public:
-				std::vector<Attribute> attributes;
+				size_t firstCorner;
+				unsigned int cornerCount;
 		};
 
+		// Corners of the face being stored, reused from face to face
+		typedef std::pmr::vector<Attribute> AttributeList;
+
+		// Reused by breakFaceIntoTris so triangulating a face doesn't allocate once it has grown
+		class TriangulationScratch {
+			public:
+				TriangulationScratch(std::pmr::memory_resource* resource);
+
+				AttributeList corners;
+				std::pmr::vector<glm::vec2> projected;
+				std::pmr::vector<unsigned int> remaining;
+				std::pmr::vector<unsigned int> triangles;
+		};
+
+		typedef std::pmr::vector<Polygon> PolygonList;
+
+		// Records in a range of the file, counted by scanObjRange before it is parsed. Corners and
+		// faces are as stored, after splitting into triangles if asked.
+		class RecordCounts {
+			public:
+				size_t vertices = 0;
+				size_t uvs = 0;
+				size_t normals = 0;
+				size_t faces = 0;
+				size_t corners = 0;
+				size_t polygons = 0;
+		};
+
+		// Output of parsing one chunk of the file. Relative indices can only be resolved once the
+		// counts of the preceding chunks are known, so their positions are kept for the merge.
+		// Polygons need every position for the split, so they are triangulated after the merge.
+		// With counts, the arrays are reserved at their final size in an arena holding exactly that
+		// much; without, they grow in resource itself (the streaming reader reuses them per window).
+		class Fragment {
+			public:
+				Fragment(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+				Fragment(std::pmr::memory_resource* resource, const RecordCounts& counts);
+
+				Fragment(const Fragment&) = delete;
+				Fragment& operator=(const Fragment&) = delete;
+
+				std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+				PmrObjData data;
+				std::pmr::vector<size_t> relativeVertexIndices;
+				std::pmr::vector<size_t> relativeUvIndices;
+				std::pmr::vector<size_t> relativeNormalIndices;
+				PolygonList polygons;
+		};
+
+		unsigned int threadCount = 0;
+		CachedLoadStats cachedLoadStats;
+		std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource();
+
+		bool readObjStream(const std::string& targetFile, ObjData& outData, bool breakIntoTris);
+		bool readObjMapped(const std::string& targetFile, ObjData& outData, bool breakIntoTris, unsigned int workers);
+		RecordCounts scanObjRange(const char* begin, const char* end, bool breakIntoTris);
+		void parseObjRange(const char* begin, const char* end, Fragment& outFragment, bool breakIntoTris, AttributeList& faceScratch);
+		void mergeFragments(std::vector<std::unique_ptr<Fragment>>& fragments, ObjData& outData, PolygonList& outPolygons, unsigned int workers);
+		// For the merged ObjData, and for a PmrObjData fragment in the streaming reader
+		template <typename Data>
+		void triangulatePolygons(Data& data, const PolygonList& polygons, unsigned int workers);
+		void parseVertexAttribute(std::string_view token, Attribute& outAttribute);
 		void parseVertexAttribute(std::string& token, Attribute& outAttribute);
-		void breakFaceIntoTris(const Face& face, std::vector<Face>& outFaces);
-};
\ No newline at end of file
+		void storeFace(const AttributeList& attributes, Fragment& outFragment, bool breakIntoTris);
+		template <typename Data>
+		void breakFaceIntoTris(Data& data, const Polygon& polygon, TriangulationScratch& scratch);
+};
+
+// One line per step a text parse of readObjCached took, nothing after a sidecar read
+void printCachedLoadStats(std::ostream& out, const ObjReader::CachedLoadStats& stats);
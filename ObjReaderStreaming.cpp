@@ -0,0 +1,181 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+
+#include "ObjReader.h"
+#include "Trace.h"
+
+namespace {
+	template <typename T, typename Allocator>
+	size_t capacityBytes(const std::vector<T, Allocator>& array){
+		return array.capacity() * sizeof(T);
+	}
+
+	template <template <typename> class Allocator>
+	size_t capacityBytes(const BasicObjData<Allocator>& data){
+		return capacityBytes(data.vertices) + capacityBytes(data.uvs) + capacityBytes(data.normals)
+			+ capacityBytes(data.verticesPerFaceCounts) + capacityBytes(data.vertexIndices)
+			+ capacityBytes(data.uvIndices) + capacityBytes(data.normalIndices);
+	}
+}
+
+// Parse the file one window at a time. Faces of a window are flattened into a batch and handed
+// to the consumer before the next window is read, so only the v/vt/vn arrays grow with the file.
+bool ObjReader::readObjStreaming(std::string objName, size_t memoryCeiling, const BatchConsumer& consumer, StreamStats& outStats){
+	TraceScope trace("ObjReader::readObjStreaming");
+	std::string targetFile = objPath(objName);
+	std::ifstream inStream(targetFile, std::ios::binary);
+	if(!inStream.is_open()){
+		std::cerr << "Error: Cannot open file " << targetFile << std::endl;
+		return false;
+	}
+
+	// A window produces at most ~20 bytes of batch per byte of text (one quad per 10 bytes of "f"
+	// lines becomes 6 corners), so 1/64 of the budget for text leaves about half for v/vt/vn.
+	const size_t windowSize = std::clamp<size_t>(memoryCeiling / 64, 64 * 1024, 16 * 1024 * 1024);
+	const unsigned int missing = (unsigned int)-1;
+
+	std::vector<char> window(windowSize);
+	Fragment fragment(memoryResource);
+	ObjData batch;
+	AttributeList faceScratch(memoryResource);
+	outStats = StreamStats();
+
+	auto footprint = [&](){
+		return capacityBytes(window) + capacityBytes(fragment.data) + capacityBytes(batch)
+			+ capacityBytes(faceScratch) + capacityBytes(fragment.relativeVertexIndices)
+			+ capacityBytes(fragment.relativeUvIndices) + capacityBytes(fragment.relativeNormalIndices)
+			+ capacityBytes(fragment.polygons);
+	};
+	auto notePeak = [&](size_t bytes){
+		outStats.peakBytes = std::max(outStats.peakBytes, bytes);
+	};
+	auto exceeded = [&](){
+		std::cerr << "Error: " << targetFile << " needs more than the " << memoryCeiling << " byte memory ceiling" << std::endl;
+		return false;
+	};
+
+	// The retained arrays grow in controlled steps before each window, so push_back never reallocates
+	// behind our back. Old and new buffers coexist during a reallocation, which counts towards the peak.
+	auto reserveHeadroom = [&](auto& array, size_t headroom){
+		size_t needed = array.size() + headroom;
+		if(needed <= array.capacity()){
+			return true;
+		}
+		size_t newCapacity = std::max(needed, array.capacity() + array.capacity() / 4);
+		size_t transient = footprint() + newCapacity * sizeof(array[0]);
+		if(transient > memoryCeiling){
+			return false;
+		}
+		notePeak(transient);
+		array.reserve(newCapacity);
+		return true;
+	};
+
+	size_t carried = 0;
+	uint64_t bytesRead = 0;
+	while(true){
+		inStream.read(window.data() + carried, window.size() - carried);
+		size_t filled = carried + (size_t)inStream.gcount();
+		bytesRead += (uint64_t)inStream.gcount();
+		bool endOfFile = !inStream;
+		if(filled == 0){
+			break;
+		}
+
+		// Parse whole lines only; the tail is carried into the next window
+		const char* begin = window.data();
+		const char* parseEnd = begin + filled;
+		if(!endOfFile){
+			while(parseEnd > begin && parseEnd[-1] != '\n'){
+				parseEnd--;
+			}
+			if(parseEnd == begin){
+				// A single line longer than the window
+				if(footprint() + window.size() * 2 > memoryCeiling){
+					return exceeded();
+				}
+				window.resize(window.size() * 2);
+				carried = filled;
+				continue;
+			}
+		}
+
+		// Shortest records are "v 0 0 0\n", "vt 0 0\n" and "vn 0 0 0\n"
+		size_t textBytes = parseEnd - begin;
+		if(!reserveHeadroom(fragment.data.vertices, textBytes / 8)
+			|| !reserveHeadroom(fragment.data.uvs, textBytes / 7)
+			|| !reserveHeadroom(fragment.data.normals, textBytes / 9)){
+			return exceeded();
+		}
+
+		fragment.data.verticesPerFaceCounts.clear();
+		fragment.data.vertexIndices.clear();
+		fragment.data.uvIndices.clear();
+		fragment.data.normalIndices.clear();
+		fragment.polygons.clear();
+		parseObjRange(begin, parseEnd, fragment, true, faceScratch);
+		// Every earlier vertex is in this fragment, so relative indices are already final
+		// and polygons can be split right away
+		fragment.relativeVertexIndices.clear();
+		fragment.relativeUvIndices.clear();
+		fragment.relativeNormalIndices.clear();
+		triangulatePolygons(fragment.data, fragment.polygons, 1);
+
+		// Flatten this window's triangles. Corners of faces written without a normal or uv (stored as
+		// index 0-1) get a zero vector, as in indexedToSeparateTriangles.
+		const PmrObjData& indexed = fragment.data;
+		const size_t cornerCount = indexed.vertexIndices.size();
+		if(cornerCount > 0){
+			const bool hasNormals = !indexed.normals.empty();
+			const bool hasUvs = !indexed.uvs.empty();
+			batch.vertices.resize(cornerCount);
+			batch.normals.resize(hasNormals ? cornerCount : 0);
+			batch.uvs.resize(hasUvs ? cornerCount : 0);
+			for(size_t corner = 0; corner < cornerCount; corner++){
+				unsigned int vertexIndex = indexed.vertexIndices[corner];
+				unsigned int normalIndex = indexed.normalIndices[corner];
+				unsigned int uvIndex = indexed.uvIndices[corner];
+				if(vertexIndex >= indexed.vertices.size()
+					|| (hasNormals && normalIndex != missing && normalIndex >= indexed.normals.size())
+					|| (hasUvs && uvIndex != missing && uvIndex >= indexed.uvs.size())){
+					std::cerr << "Error: Reading Obj File" << std::endl;
+					return false;
+				}
+				batch.vertices[corner] = indexed.vertices[vertexIndex];
+				if(hasNormals){
+					batch.normals[corner] = normalIndex == missing ? glm::vec3(0.0f) : indexed.normals[normalIndex];
+				}
+				if(hasUvs){
+					batch.uvs[corner] = uvIndex == missing ? glm::vec2(0.0f) : indexed.uvs[uvIndex];
+				}
+			}
+
+			notePeak(footprint());
+			if(footprint() > memoryCeiling){
+				return exceeded();
+			}
+			outStats.triangles += cornerCount / 3;
+			outStats.batches++;
+			if(!consumer(batch)){
+				break;
+			}
+		} else if(!consumer(ObjData())){
+			// Windows of only v/vt/vn records pass an empty batch, so the read can stop there too
+			break;
+		}
+		notePeak(footprint());
+
+		carried = (begin + filled) - parseEnd;
+		memmove(window.data(), parseEnd, carried);
+		if(endOfFile){
+			break;
+		}
+	}
+
+	trace.setBytes(bytesRead);
+	trace.setTriangles(outStats.triangles);
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Number of workers to use when the caller asks for 0 (= all hardware threads)
+inline unsigned int resolveThreadCount(unsigned int threadCount){
+	if(threadCount == 0){
+		threadCount = std::thread::hardware_concurrency();
+	}
+	return std::max(threadCount, 1u);
+}
+
+// Run fn(i) for i in [0, count) on up to threadCount workers (0 = all hardware threads).
+// Workers pull the next index from a shared counter, so uneven items balance out.
+// The calling thread is one of the workers; with one worker nothing is spawned.
+template <typename Fn>
+void parallelFor(size_t count, unsigned int threadCount, Fn fn){
+	unsigned int workerCount = (unsigned int)std::min<size_t>(resolveThreadCount(threadCount), count);
+	if(workerCount <= 1){
+		for(size_t i = 0; i < count; i++){
+			fn(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	auto work = [&](){
+		for(size_t i = next++; i < count; i = next++){
+			fn(i);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(workerCount - 1);
+	for(unsigned int i = 1; i < workerCount; i++){
+		workers.emplace_back(work);
+	}
+	work();
+	for(std::thread& worker : workers){
+		worker.join();
+	}
+}
+
+// Split [0, count) into contiguous ranges of at least minRange items and run fn(begin, end) on each in parallel
+template <typename Fn>
+void parallelForRange(size_t count, size_t minRange, unsigned int threadCount, Fn fn){
+	unsigned int workerCount = resolveThreadCount(threadCount);
+	size_t rangeCount = std::max<size_t>(1, std::min<size_t>(workerCount * 4, count / std::max<size_t>(minRange, 1)));
+	parallelFor(rangeCount, workerCount, [&](size_t range){
+		size_t begin = count * range / rangeCount;
+		size_t end = count * (range + 1) / rangeCount;
+		fn(begin, end);
+	});
+}
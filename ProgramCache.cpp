@@ -0,0 +1,134 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <vector>
+
+#include "ProgramCache.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "Trace.h"
+
+namespace {
+	const char cacheMagic[8] = {'G', 'L', 'P', 'R', 'O', 'G', 'B', 'N'};
+	// Bump whenever the file layout changes
+	const uint32_t cacheVersion = 1;
+
+	std::string glString(GLenum name){
+		const GLubyte* value = glGetString(name);
+		return value ? std::string((const char*)value) : std::string();
+	}
+}
+
+ProgramCache::ProgramCache(const std::string& directory, const ShaderData& data) {
+	this->directory = directory;
+	GLint formatCount = 0;
+	if(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary){
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+	supported = formatCount > 0;
+
+	// A separator between the parts, so moving text from one to the next changes the key
+	const char separator = 0;
+	key = fnv1a64(data.vertexShaderCode);
+	key = fnv1a64(&separator, 1, key);
+	key = fnv1a64(data.fragmentShaderCode, key);
+	for(GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }){
+		key = fnv1a64(&separator, 1, key);
+		key = fnv1a64(glString(name), key);
+	}
+
+	std::ostringstream path;
+	path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".programbinary";
+	cachePath = path.str();
+}
+
+bool ProgramCache::load(unsigned int program){
+	if(!supported || !std::filesystem::exists(cachePath)){
+		return false;
+	}
+
+	TraceScope trace("ProgramCache::load");
+	MappedFile file(cachePath);
+	if(file.wasError() || file.size() < sizeof(Header)){
+		return false;
+	}
+	trace.setBytes(file.size());
+	Header header;
+	memcpy(&header, file.data(), sizeof(Header));
+	if(memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0
+		|| header.version != cacheVersion
+		|| header.key != key
+		|| header.length != file.size() - sizeof(Header)){
+		return false;
+	}
+
+	// Drivers may refuse binaries from an older build of themselves even with the same strings
+	glProgramBinary(program, header.format, file.data() + sizeof(Header), (GLsizei)header.length);
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if(!success){
+		std::cerr << "Warning: Driver rejected program binary " << cachePath << std::endl;
+		std::error_code error;
+		std::filesystem::remove(cachePath, error);
+		return false;
+	}
+	return true;
+}
+
+// Write to a temporary file and rename it over the cache so a reader never sees half a file
+bool ProgramCache::store(unsigned int program){
+	if(!supported){
+		return false;
+	}
+
+	TraceScope trace("ProgramCache::store");
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0){
+		return false;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	trace.setBytes(length);
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.format = format;
+	header.key = key;
+	header.length = (uint64_t)length;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if(!out.is_open()){
+			std::cerr << "Warning: Cannot write program binary " << cachePath << std::endl;
+			return false;
+		}
+		out.write((const char*)&header, sizeof(header));
+		out.write(binary.data(), length);
+		if(!out.good()){
+			std::cerr << "Warning: Cannot write program binary " << cachePath << std::endl;
+			out.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, cachePath, error);
+	if(error){
+		std::cerr << "Warning: Cannot write program binary " << cachePath << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
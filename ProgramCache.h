@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "ShaderData.h"
+
+// Linked program binaries (glGetProgramBinary) stored as <directory>/<key>.programbinary. The key
+// hashes both shader sources with the GL vendor, renderer and version strings, so an edited
+// shader or another driver misses instead of handing the driver a binary it may not take.
+// Needs a current GL context with GL_ARB_get_program_binary (core in 4.1) and at least one
+// binary format; without them every load misses and store does nothing.
+class ProgramCache {
+	public:
+		ProgramCache(const std::string& directory, const ShaderData& data);
+
+		// False if there is no binary for the key, or the driver rejects it (the file is removed)
+		bool load(unsigned int program);
+		// program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+		bool store(unsigned int program);
+
+		bool isSupported() { return supported; }
+		const std::string& getCachePath() { return cachePath; }
+
+	private:
+		class Header {
+			public:
+				char magic[8];
+				uint32_t version;
+				uint32_t format;
+				uint64_t key;
+				uint64_t length;
+		};
+
+		std::string directory;
+		std::string cachePath;
+		uint64_t key;
+		bool supported;
+};
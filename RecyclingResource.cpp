@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <new>
+
+#include "RecyclingResource.h"
+
+RecyclingResource::RecyclingResource(size_t cacheLimit, std::pmr::memory_resource* upstream)
+	: cacheLimit(cacheLimit), upstream(upstream) {
+}
+
+RecyclingResource::~RecyclingResource(){
+	release();
+}
+
+void RecyclingResource::release(){
+	std::lock_guard<std::mutex> lock(mutex);
+	for(auto& block : cached){
+		upstream->deallocate(block.second, block.first, blockAlignment);
+	}
+	cached.clear();
+	stats.cachedBytes = 0;
+}
+
+RecyclingResource::Stats RecyclingResource::getStats(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void* RecyclingResource::do_allocate(size_t bytes, size_t alignment){
+	if(alignment > blockAlignment){
+		throw std::bad_alloc();
+	}
+	bytes = std::max<size_t>(bytes, 1);
+	std::lock_guard<std::mutex> lock(mutex);
+	auto fit = cached.lower_bound(bytes);
+	void* block;
+	size_t blockBytes;
+	if(fit != cached.end() && fit->first / 2 <= bytes){
+		block = fit->second;
+		blockBytes = fit->first;
+		cached.erase(fit);
+		stats.cachedBytes -= blockBytes;
+		stats.reusedAllocations++;
+	} else {
+		block = upstream->allocate(bytes, blockAlignment);
+		blockBytes = bytes;
+		stats.upstreamAllocations++;
+	}
+	live[block] = blockBytes;
+	stats.liveBytes += blockBytes;
+	return block;
+}
+
+void RecyclingResource::do_deallocate(void* block, size_t, size_t){
+	std::lock_guard<std::mutex> lock(mutex);
+	auto handedOut = live.find(block);
+	size_t blockBytes = handedOut->second;
+	live.erase(handedOut);
+	stats.liveBytes -= blockBytes;
+	if(stats.cachedBytes + blockBytes <= cacheLimit){
+		cached.emplace(blockBytes, block);
+		stats.cachedBytes += blockBytes;
+	} else {
+		upstream->deallocate(block, blockBytes, blockAlignment);
+	}
+}
+
+bool RecyclingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
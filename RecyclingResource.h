@@ -0,0 +1,48 @@
+#pragma once
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <memory_resource>
+#include <cstddef>
+
+// Upstream for short lived arenas that are made again and again, such as the parser's per chunk
+// arenas when model after model is loaded. Blocks given back are kept, up to cacheLimit bytes,
+// and handed out again for a request of at least half their size, so repeated loads reuse memory
+// that is already mapped instead of going back to the system allocator. Thread safe.
+class RecyclingResource : public std::pmr::memory_resource {
+	public:
+		class Stats {
+			public:
+				// Requests served by the upstream resource and from kept blocks
+				size_t upstreamAllocations = 0;
+				size_t reusedAllocations = 0;
+				size_t liveBytes = 0;
+				size_t cachedBytes = 0;
+		};
+
+		RecyclingResource(size_t cacheLimit = 1024 * 1024 * 1024, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+		~RecyclingResource();
+
+		RecyclingResource(const RecyclingResource&) = delete;
+		RecyclingResource& operator=(const RecyclingResource&) = delete;
+
+		// Gives the kept blocks back to upstream
+		void release();
+		Stats getStats();
+
+	private:
+		// Every block has the alignment of operator new, so any block fits any ordinary request
+		static const size_t blockAlignment = alignof(std::max_align_t);
+
+		size_t cacheLimit;
+		std::pmr::memory_resource* upstream;
+		std::mutex mutex;
+		// Kept blocks by size, and the size of each block handed out (at least what was asked)
+		std::multimap<size_t, void*> cached;
+		std::unordered_map<void*, size_t> live;
+		Stats stats;
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* block, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
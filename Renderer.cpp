@@ -0,0 +1,497 @@
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Renderer.h"
+#include "ShaderReader.h"
+#include "ObjReader.h"
+#include "MeshSimplifier.h"
+#include "Bounds.h"
+#include "AsyncModelLoader.h"
+#include "Trace.h"
+#include "SoftwareRasterizer.h"
+
+namespace {
+	void set_vec3_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, glm::vec3 const& v) {
+		int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
+		if (position == -1) {
+			std::cerr << "Error: Cannot find uniform variable: " << uniform_name << std::endl;
+			exit(1);
+		}
+		glUniform3fv(position, 1, &v[0]);
+	}
+
+	void set_boolean_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, bool v) {
+		int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
+		if (position == -1) {
+			std::cerr << "Error: Cannot find uniform variable: " << uniform_name << std::endl;
+			exit(1);
+		}
+		glUniform1i(position, (int)v);
+	}
+
+	void set_float_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, float v) {
+		int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
+		if (position == -1) {
+			std::cerr << "Error: Cannot find uniform variable: " << uniform_name << std::endl;
+			exit(1);
+		}
+		glUniform1f(position, v);
+	}
+
+	void set_mat4_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, glm::mat4 const& m) {
+		int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
+		glUniformMatrix4fv(position, 1, GL_FALSE, &m[0][0]);
+	}
+
+	// The original upload: every uniform is looked up by name and set, changed or not.
+	// Kept for --uniforms legacy to compare against FrameUniforms. Returns the GL calls made.
+	unsigned int upload_frame_parameters_legacy(ShaderProgram &shaderProgram, FrameParameters const& parameters) {
+		set_mat4_uniform(shaderProgram, "model", parameters.model);
+		set_mat4_uniform(shaderProgram, "view", parameters.view);
+		set_mat4_uniform(shaderProgram, "projection", parameters.projection);
+		glm::mat3 normalMatrix = parameters.getNormalMatrix();
+		int normalMatrixPosition = glGetUniformLocation(shaderProgram.getID(), "normalMatrix");
+		glUniformMatrix3fv(normalMatrixPosition, 1, GL_FALSE, &normalMatrix[0][0]);
+
+		set_boolean_uniform(shaderProgram, "showZBuffer", parameters.showZBuffer);
+		set_vec3_uniform(shaderProgram, "lightPosition", parameters.lightPosition);
+		set_vec3_uniform(shaderProgram, "viewerPosition", parameters.viewerPosition);
+		set_vec3_uniform(shaderProgram, "lightColor", parameters.lightColor);
+		set_vec3_uniform(shaderProgram, "objectColor", parameters.objectColor);
+		set_boolean_uniform(shaderProgram, "useGouraudShading", parameters.useGouraudShading);
+		set_boolean_uniform(shaderProgram, "usePhongShading", parameters.usePhongShading);
+		set_boolean_uniform(shaderProgram, "useFlatShading", parameters.useFlatShading);
+		set_float_uniform(shaderProgram, "shininess", parameters.shininess);
+		return 13 * 2;
+	}
+}
+
+FrameParameters computeFrameParameters(const ViewState& view, const glm::mat4& positionDequantization){
+	// View Matrix
+	glm::vec3 viewerPosition = glm::vec3(0.0);
+	glm::vec3 viewerCenter = glm::vec3(0.0, 0.0, -1.0);
+	glm::vec3 viewerUp = glm::vec3(0.0, 1.0, 0.0);
+
+	FrameParameters parameters;
+	parameters.view = glm::lookAt(viewerPosition, viewerCenter, viewerUp);
+
+	// Lighting
+	parameters.lightPosition = glm::vec3(0.0, 3.0, -3.0);
+	parameters.lightColor = glm::vec3(1.0);
+	parameters.objectColor = glm::vec3(1.0, 0.0, 0.0); // RED COLOR
+	parameters.shininess = 32;
+	parameters.viewerPosition = viewerPosition;
+
+	updateFrameParameters(view, positionDequantization, VIEW_CHANGE_ALL, parameters);
+	return parameters;
+}
+
+void updateFrameParameters(const ViewState& view, const glm::mat4& positionDequantization, unsigned int changes, FrameParameters& parameters){
+	if (changes & VIEW_CHANGE_MODEL) {
+		// Create model transform
+		glm::mat4 modelMatrix(1.0f);
+		float x_rotate = view.rotationDegrees.x * 3.142 / 180;
+		float y_rotate = view.rotationDegrees.y * 3.142 / 180;
+		float z_rotate = view.rotationDegrees.z * 3.142 / 180;
+
+		modelMatrix = glm::translate(modelMatrix, view.position)
+			* glm::rotate(modelMatrix, x_rotate, glm::vec3(1.f, 0.f, 0.f))
+			* glm::rotate(modelMatrix, y_rotate, glm::vec3(0.f, 1.f, 0.f))
+			* glm::rotate(modelMatrix, z_rotate, glm::vec3(0.f, 0.f, 1.f))
+			* glm::scale(modelMatrix, view.scale);
+
+		// Quantized layouts store positions in [0,1] of the bounding box; the model matrix scales them back.
+		parameters.model = modelMatrix * positionDequantization;
+		// Normal Matrix for Gouraud and Phong shading
+		parameters.setNormalMatrix(glm::mat3(glm::transpose(glm::inverse(modelMatrix))));
+	}
+	if (changes & VIEW_CHANGE_PROJECTION) {
+		parameters.projection = glm::perspective(glm::radians(view.fovy), view.aspectRatio, view.nearPlane, view.farPlane);
+	}
+	if (changes & VIEW_CHANGE_SHADING) {
+		parameters.showZBuffer = view.showZBuffer;
+		parameters.useGouraudShading = view.useGouraudShading;
+		parameters.usePhongShading = view.usePhongShading;
+		parameters.useFlatShading = view.useFlatShading;
+	}
+}
+
+namespace {
+	// .obj files are indexed triangle structures, the steps after reading start from separate triangles
+	bool readSeparateTriangles(const std::string& name, ObjData& outData){
+		ObjReader objReader;
+		ObjData objData;
+		if (!objReader.readObjCached(name, objData, true)) {
+			std::cout << "Failed to read object " << name << "\n";
+			return false;
+		}
+		printCachedLoadStats(std::cout, objReader.getCachedLoadStats());
+		if (!objReader.indexedToSeparateTriangles(objData, outData)) {
+			std::cout << "Invalid indices in object " << name << "\n";
+			return false;
+		}
+		return true;
+	}
+}
+
+void buildSceneModel(const ObjData& separateTriangles, VertexLayout::Type layout, SceneModel& outModel, ObjData* outWelded){
+	TraceScope trace("buildSceneModel");
+	size_t numVertices = separateTriangles.vertices.size();
+
+	// Weld identical corners back together so shared vertices are uploaded (and transformed) once
+	ObjReader objReader;
+	ObjData weldedObjData;
+	objReader.separateTrianglesToIndexed(separateTriangles, weldedObjData);
+
+	// Convert to the chosen vertex layout; the VAO is configured from the layout's descriptor
+	buildVertexBuffers(weldedObjData, layout, outModel.vertexData);
+	outModel.indices = weldedObjData.vertexIndices;
+
+	// Indices are uploaded in 16 bits when every vertex fits
+	bool shortIndices = outModel.vertexData.vertexCount <= 0xFFFF;
+	size_t separateBytes = numVertices * (sizeof(glm::vec3) + sizeof(glm::vec3));
+	size_t uploadBytes = outModel.vertexData.bytes() + outModel.indices.size() * (shortIndices ? sizeof(unsigned short) : sizeof(unsigned int));
+	trace.setBytes(uploadBytes);
+	trace.setTriangles(outModel.indices.size() / 3);
+	std::cout << "Welded " << numVertices << " corners into " << weldedObjData.vertices.size() << " vertices ("
+		<< (numVertices > 0 ? 100.0 * weldedObjData.vertices.size() / numVertices : 0.0) << "%), "
+		<< VertexLayout::name(layout) << " layout, "
+		<< (shortIndices ? "16" : "32") << " bit indices, "
+		<< separateBytes / 1024 << " KB -> " << uploadBytes / 1024 << " KB\n";
+	if (layout == VertexLayout::Type::PACKED || layout == VertexLayout::Type::QUANTIZED) {
+		QuantizationReport report = measureQuantizationError(weldedObjData, outModel.vertexData);
+		std::cout << "Quantization: " << report.bytesPerVertexBefore << " -> " << report.bytesPerVertexAfter << " bytes/vertex, "
+			<< "max position error " << report.maxPositionError << " (" << report.maxPositionErrorRelative * 100.0f << "% of diagonal), "
+			<< "max normal error " << report.maxNormalErrorDegrees << " degrees\n";
+	}
+	if (outWelded) {
+		*outWelded = std::move(weldedObjData);
+	}
+}
+
+bool loadSceneModel(const std::string& name, VertexLayout::Type layout, SceneModel& outModel){
+	ObjData separateTriangles;
+	if (!readSeparateTriangles(name, separateTriangles)) {
+		return false;
+	}
+	buildSceneModel(separateTriangles, layout, outModel);
+	return true;
+}
+
+bool loadSceneModels(AssetManager& assets, const std::vector<std::string>& names, VertexLayout::Type layout, std::vector<SceneModel>& outModels){
+	std::vector<std::string> paths;
+	for (const std::string& name : names) {
+		paths.push_back(ObjReader::objPath(name));
+	}
+	std::vector<MeshHandle> meshes = assets.loadBatch(paths);
+
+	ObjReader objReader;
+	outModels.assign(names.size(), SceneModel());
+	for (size_t i = 0; i < names.size(); i++) {
+		if (!meshes[i]) {
+			std::cout << "Failed to read object " << names[i] << "\n";
+			return false;
+		}
+		ObjData separateTriangles;
+		if (!objReader.indexedToSeparateTriangles(meshes[i]->data, separateTriangles)) {
+			std::cout << "Invalid indices in object " << names[i] << "\n";
+			return false;
+		}
+		buildSceneModel(separateTriangles, layout, outModels[i]);
+	}
+	return true;
+}
+
+void prepareRenderModel(const ObjData& separateTriangles, VertexLayout::Type layout, bool buildLods, PreparedModel& outModel){
+	ObjData weldedObjData;
+	buildSceneModel(separateTriangles, layout, outModel.model, &weldedObjData);
+	std::vector<unsigned int>& indices = outModel.model.indices;
+
+	// Spatially coherent runs of triangles, so what is off screen can be skipped as a whole
+	{
+		TraceScope trace("buildMeshClusters");
+		trace.setTriangles(indices.size() / 3);
+		buildMeshClusters(weldedObjData.vertices, indices, outModel.clusters);
+	}
+	Bounds bounds = computeBounds(weldedObjData.vertices);
+	outModel.boundingCenter = (bounds.min + bounds.max) * 0.5f;
+	outModel.boundingRadius = glm::length(bounds.max - bounds.min) * 0.5f;
+
+	// Coarser levels index the same vertices, so they follow the full mesh in the index buffer
+	outModel.lods.assign(1, { 0, (unsigned int)indices.size(), 0.0f });
+	if (buildLods) {
+		TraceScope trace("buildLodChain");
+		trace.setTriangles(indices.size() / 3);
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<LodLevel> levels;
+		buildLodChain(weldedObjData, levels);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		for (const LodLevel& level : levels) {
+			outModel.lods.push_back({ (unsigned int)indices.size(), (unsigned int)level.indices.size(), level.error });
+			indices.insert(indices.end(), level.indices.begin(), level.indices.end());
+		}
+		std::cout << "LOD chain: " << levels.size() << " levels in " << elapsed.count() * 1000.0 << " ms";
+		for (const LodLevel& level : levels) {
+			std::cout << ", " << level.indices.size() / 3 << " (" << level.relativeError * 100.0f << "%)";
+		}
+		std::cout << " triangles (error % of diagonal)\n";
+	}
+}
+
+void uploadRenderModel(PreparedModel& prepared, RenderModel& outModel){
+	TraceScope trace("uploadRenderModel");
+	outModel.mesh.reset(new GpuMesh(prepared.model.vertexData, prepared.model.indices));
+	outModel.vertexData = std::move(prepared.model.vertexData);
+	outModel.clusters = std::move(prepared.clusters);
+	outModel.lods = std::move(prepared.lods);
+	outModel.boundingCenter = prepared.boundingCenter;
+	outModel.boundingRadius = prepared.boundingRadius;
+	prepared.model.indices.clear();
+}
+
+bool loadRenderModel(const std::string& name, VertexLayout::Type layout, RenderModel& outModel, bool buildLods){
+	ObjData separateTriangles;
+	if (!readSeparateTriangles(name, separateTriangles)) {
+		return false;
+	}
+	PreparedModel prepared;
+	prepareRenderModel(separateTriangles, layout, buildLods, prepared);
+	uploadRenderModel(prepared, outModel);
+	return true;
+}
+
+unsigned int selectLod(const RenderModel& model, const FrameParameters& parameters, float fovyDegrees, float viewportHeight, float pixelError){
+	// Distance to the nearest point of the bounding sphere; a camera inside it gets full detail
+	glm::mat4 modelMatrix = parameters.model * glm::inverse(model.vertexData.positionDequantization);
+	glm::vec4 center = parameters.view * modelMatrix * glm::vec4(model.boundingCenter, 1.0f);
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float distance = -center.z - model.boundingRadius * scale;
+	if (distance <= 0.0f) {
+		return 0;
+	}
+
+	// Pixels covered by one model unit at that distance
+	float pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(fovyDegrees) * 0.5f) * distance) * scale;
+	for (unsigned int lod = model.lods.size() - 1; lod > 0; lod--) {
+		if (model.lods[lod].error * pixelsPerUnit <= pixelError) {
+			return lod;
+		}
+	}
+	return 0;
+}
+
+void selectDrawRanges(const RenderModel& model, const FrameParameters& parameters, unsigned int lod, bool culling, VisibleClusters& outRanges){
+	TraceScope trace("selectDrawRanges");
+	if (lod == 0 && culling) {
+		cullRenderModel(model, parameters, outRanges);
+		return;
+	}
+	// Coarse levels are small enough to draw whole
+	const RenderLod& level = model.lods[std::min<size_t>(lod, model.lods.size() - 1)];
+	outRanges.clear();
+	outRanges.firstIndices.push_back(level.firstIndex);
+	outRanges.counts.push_back(level.indexCount);
+	outRanges.triangleCount = level.indexCount / 3;
+}
+
+void cullRenderModel(const RenderModel& model, const FrameParameters& parameters, VisibleClusters& outVisible){
+	// parameters.model includes the dequantization; the clusters are from before it
+	glm::mat4 modelMatrix = parameters.model * glm::inverse(model.vertexData.positionDequantization);
+	cullClusters(model.clusters, Frustum::fromMatrix(parameters.projection * parameters.view * modelMatrix), outVisible);
+}
+
+bool readShaderSources(VertexLayout::Type layout, bool instanced, ShaderData& outData, const std::vector<std::string>& defines){
+	// Choose shader
+	std::string vertexShader = "shader";
+	std::string fragmentShader = "shader";
+
+	auto vertex = ("../data/shaders/" + vertexShader + ".vs");
+	auto frag = ("../data/shaders/" + fragmentShader + ".fs");
+	ShaderReader shaderReader(vertex.c_str(), frag.c_str(), defines);
+	shaderReader.read(outData);
+	if(shaderReader.wasError()){
+		std::cout << "Failed to read shader data. \n";
+		return false;
+	}
+
+	// Quantized normals are octahedral encoded and have to be decoded by the vertex shader
+	std::string& source = outData.vertexShaderCode;
+	size_t version = source.find("#version");
+	size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version) + 1;
+	if (layout == VertexLayout::Type::QUANTIZED) {
+		source.insert(insertAt, octahedralDecodeGLSL());
+	}
+	if (instanced) {
+		source.insert(insertAt, instancingGLSL());
+	}
+	return true;
+}
+
+std::unique_ptr<ShaderProgram> loadShaderProgram(VertexLayout::Type layout, bool instanced, bool binaryCache,
+	const std::vector<std::string>& defines){
+	auto start = std::chrono::high_resolution_clock::now();
+	ShaderData shaderData;
+	if(!readShaderSources(layout, instanced, shaderData, defines)){
+		return nullptr;
+	}
+
+	std::unique_ptr<ShaderProgram> shaderProgram(new ShaderProgram(shaderData, binaryCache ? programCacheDirectory : ""));
+	if(shaderProgram->wasError()){
+		std::cout << "Failed to compile and link program \n";
+		return nullptr;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Shader program " << (shaderProgram->wasLoadedFromCache() ? "loaded from binary cache" : "compiled")
+		<< " in " << elapsed.count() * 1000.0 << " ms\n";
+	return shaderProgram;
+}
+
+ShadingVariant ShadingVariant::of(const ViewState& view){
+	ShadingVariant variant;
+	variant.showZBuffer = view.showZBuffer;
+	variant.useGouraudShading = view.useGouraudShading;
+	variant.usePhongShading = view.usePhongShading;
+	variant.useFlatShading = view.useFlatShading;
+	return variant;
+}
+
+unsigned int ShadingVariant::index() const {
+	return (showZBuffer ? 1 : 0) | (useGouraudShading ? 2 : 0) | (usePhongShading ? 4 : 0) | (useFlatShading ? 8 : 0);
+}
+
+std::vector<std::string> ShadingVariant::defines() const {
+	auto constant = [](bool value){ return value ? " true" : " false"; };
+	return {
+		"SHADING_VARIANT",
+		std::string("SHADING_ZBUFFER") + constant(showZBuffer),
+		std::string("SHADING_GOURAUD") + constant(useGouraudShading),
+		std::string("SHADING_PHONG") + constant(usePhongShading),
+		std::string("SHADING_FLAT") + constant(useFlatShading)
+	};
+}
+
+std::string ShadingVariant::name() const {
+	std::string name = useGouraudShading ? "gouraud" : usePhongShading ? "phong" : useFlatShading ? "flat" : "object color";
+	if (useGouraudShading + usePhongShading + useFlatShading > 1) {
+		name = "mixed";
+	}
+	return showZBuffer ? name + " + z buffer" : name;
+}
+
+ShadingPrograms::ShadingPrograms(VertexLayout::Type layout){
+	this->layout = layout;
+}
+
+bool ShadingPrograms::build(unsigned int index, const ShadingVariant& variant){
+	if (programs[index]) {
+		return true;
+	}
+	if (failed[index]) {
+		return false;
+	}
+	programs[index] = loadShaderProgram(layout, false, true, variant.defines());
+	if (programs[index]) {
+		programs[index]->use();
+		uniforms[index].reset(new FrameUniforms(*programs[index], index));
+		if (!uniforms[index]->wasError()) {
+			return true;
+		}
+		std::cout << "Failed to find the frame uniforms of the " << variant.name() << " variant\n";
+	}
+	programs[index].reset();
+	uniforms[index].reset();
+	failed[index] = true;
+	return false;
+}
+
+ShaderProgram* ShadingPrograms::getProgram(const ShadingVariant& variant){
+	unsigned int index = variant.index();
+	return build(index, variant) ? programs[index].get() : nullptr;
+}
+
+FrameUniforms* ShadingPrograms::getUniforms(const ShadingVariant& variant){
+	unsigned int index = variant.index();
+	return build(index, variant) ? uniforms[index].get() : nullptr;
+}
+
+namespace {
+	unsigned int beginFrame(ShaderProgram& program, FrameUniforms& uniforms, const FrameParameters& parameters, bool legacyUniforms){
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Bind the program first, uniforms are set on the program in use.
+		// Only parameters that changed since the last frame are sent.
+		program.use();
+		unsigned int calls = 3;
+		if (legacyUniforms) {
+			calls += upload_frame_parameters_legacy(program, parameters);
+		} else {
+			calls += uniforms.upload(parameters);
+		}
+		return calls;
+	}
+}
+
+unsigned int renderFrame(ShaderProgram& program, FrameUniforms& uniforms, GpuMesh& mesh, const FrameParameters& parameters, bool legacyUniforms,
+	const VisibleClusters& ranges){
+	TraceScope trace("renderFrame");
+	trace.setTriangles(ranges.triangleCount);
+	unsigned int calls = beginFrame(program, uniforms, parameters, legacyUniforms);
+
+	// Draw using GPU buffer data
+	mesh.draw(ranges);
+	return calls + 2;
+}
+
+unsigned int renderFrame(ShaderProgram& program, FrameUniforms& uniforms, ProgressiveMesh* mesh, const FrameParameters& parameters, bool legacyUniforms){
+	TraceScope trace("renderFrame");
+	unsigned int calls = beginFrame(program, uniforms, parameters, legacyUniforms);
+	if (!mesh) {
+		return calls;
+	}
+	trace.setTriangles(mesh->getVertexCount() / 3);
+	mesh->draw();
+	return calls + 2;
+}
+
+bool renderSoftwareImage(const std::string& name, const ViewState& view, int width, int height, const std::string& imagePath,
+	const std::string& referencePath){
+	ObjReader objReader;
+	ObjData mesh;
+	if (!objReader.readObjCached(name, mesh, true)) {
+		return false;
+	}
+	ViewState imageView = view;
+	imageView.aspectRatio = (float)width / (float)height;
+
+	SoftwareRasterizer rasterizer(width, height);
+	auto start = std::chrono::high_resolution_clock::now();
+	rasterizer.render(mesh, computeFrameParameters(imageView, glm::mat4(1.0f)));
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Rendered " << mesh.vertexIndices.size() / 3 << " triangles at " << width << "x" << height << " in "
+		<< elapsed.count() * 1000.0 << " ms on " << rasterizer.getThreadCount() << " threads\n";
+	if (!writePpm(imagePath, rasterizer.getPixels(), width, height)) {
+		return false;
+	}
+	if (referencePath.empty()) {
+		return true;
+	}
+
+	std::vector<unsigned char> reference;
+	int referenceWidth = 0;
+	int referenceHeight = 0;
+	if (!readPpm(referencePath, reference, referenceWidth, referenceHeight)) {
+		return false;
+	}
+	if (referenceWidth != width || referenceHeight != height) {
+		std::cerr << "Error: " << referencePath << " is " << referenceWidth << "x" << referenceHeight << ", not " << width << "x" << height << std::endl;
+		return false;
+	}
+	double differing = differingPixels(reference, rasterizer.getPixels());
+	std::cout << differing * 100.0 << "% of the pixels differ from " << referencePath << "\n";
+	return differing <= 0.01;
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <glm/glm.hpp>
+#include "ShaderProgram.h"
+#include "FrameUniforms.h"
+#include "VertexLayout.h"
+#include "GpuMesh.h"
+#include "GpuScene.h"
+#include "MeshClusters.h"
+#include "AssetManager.h"
+
+class ProgressiveMesh;
+
+// Model transform, projection and shading toggles a frame is drawn with. The window drives it
+// from the keyboard, the headless benchmark from a scripted camera path.
+class ViewState {
+	public:
+		glm::vec3 position = glm::vec3(0.0f, 0.0f, -5.0f);
+		glm::vec3 rotationDegrees = glm::vec3(0.0f);
+		glm::vec3 scale = glm::vec3(1.0f);
+		float fovy = 45.0f;
+		float nearPlane = 0.1f;
+		float farPlane = 1000.0f;
+		float aspectRatio = 800.0f / 600.0f;
+
+		bool showZBuffer = false;
+		bool useGouraudShading = false;
+		bool usePhongShading = false;
+		bool useFlatShading = false;
+};
+
+// The shading toggles of a ViewState, compiled into a program as constants instead of branched on
+// per vertex and fragment. defines() sets SHADING_VARIANT and SHADING_ZBUFFER, SHADING_GOURAUD,
+// SHADING_PHONG and SHADING_FLAT to true or false. A shader specializes on them by mapping its
+// mode flags onto the constants after declaring them:
+//
+//   #ifdef SHADING_VARIANT
+//   #define showZBuffer SHADING_ZBUFFER
+//   #define useGouraudShading SHADING_GOURAUD
+//   #define usePhongShading SHADING_PHONG
+//   #define useFlatShading SHADING_FLAT
+//   #endif
+//
+// A shader without the mapping ignores the defines and keeps branching on the uploaded flags.
+class ShadingVariant {
+	public:
+		static const unsigned int count = 16;
+
+		bool showZBuffer = false;
+		bool useGouraudShading = false;
+		bool usePhongShading = false;
+		bool useFlatShading = false;
+
+		static ShadingVariant of(const ViewState& view);
+		unsigned int index() const;
+		std::vector<std::string> defines() const;
+		std::string name() const;
+};
+
+// Index range of one level of detail in the model's index buffer, and its simplification error
+// in model units
+class RenderLod {
+	public:
+		unsigned int firstIndex;
+		unsigned int indexCount;
+		float error;
+};
+
+// A model read, welded, clustered, simplified and uploaded in one vertex layout. lods[0] is the
+// full mesh (the clusters' ranges), coarser levels follow it. Cluster and bounding sphere
+// coordinates are the model's own, before positionDequantization.
+class RenderModel {
+	public:
+		VertexBufferData vertexData;
+		MeshClusters clusters;
+		std::vector<RenderLod> lods;
+		glm::vec3 boundingCenter = glm::vec3(0.0f);
+		float boundingRadius = 0.0f;
+		std::unique_ptr<GpuMesh> mesh;
+};
+
+// Parts of FrameParameters a ViewState change affects: the model and normal matrices, the
+// projection, or only the shading flags
+enum ViewChange : unsigned int {
+	VIEW_CHANGE_MODEL = 1,
+	VIEW_CHANGE_PROJECTION = 2,
+	VIEW_CHANGE_SHADING = 4,
+	VIEW_CHANGE_ALL = 7
+};
+
+// Matrices and lighting of one frame. positionDequantization is folded into the model matrix.
+FrameParameters computeFrameParameters(const ViewState& view, const glm::mat4& positionDequantization);
+
+// Recompute only the parts of parameters (from an earlier computeFrameParameters) that changes
+// names; the view matrix and lighting don't depend on the ViewState and are left as they are
+void updateFrameParameters(const ViewState& view, const glm::mat4& positionDequantization, unsigned int changes, FrameParameters& parameters);
+
+// Weld separate triangles and convert them to the layout, printing the weld and quantization
+// stats. outWelded receives the welded data if given.
+void buildSceneModel(const ObjData& separateTriangles, VertexLayout::Type layout, SceneModel& outModel, ObjData* outWelded = nullptr);
+
+// Read (through the mesh cache) and buildSceneModel
+bool loadSceneModel(const std::string& name, VertexLayout::Type layout, SceneModel& outModel);
+
+// The same for every model of a scene, with the files read concurrently through assets
+bool loadSceneModels(AssetManager& assets, const std::vector<std::string>& names, VertexLayout::Type layout, std::vector<SceneModel>& outModels);
+
+// CPU side of a RenderModel: everything up to the upload, so it can be built on any thread
+class PreparedModel {
+	public:
+		SceneModel model;
+		MeshClusters clusters;
+		std::vector<RenderLod> lods;
+		glm::vec3 boundingCenter = glm::vec3(0.0f);
+		float boundingRadius = 0.0f;
+};
+
+// buildSceneModel, clusters and the LOD chain (unless buildLods is false), from separate triangles
+void prepareRenderModel(const ObjData& separateTriangles, VertexLayout::Type layout, bool buildLods, PreparedModel& outModel);
+
+// Move a prepared model into outModel and upload it. Needs a current GL context.
+void uploadRenderModel(PreparedModel& prepared, RenderModel& outModel);
+
+// Read (through the mesh cache), prepareRenderModel and uploadRenderModel
+bool loadRenderModel(const std::string& name, VertexLayout::Type layout, RenderModel& outModel, bool buildLods = true);
+
+// Coarsest level whose error projects to at most pixelError pixels, from the distance of the
+// bounding sphere under the frame's matrices, the vertical field of view and viewport height
+unsigned int selectLod(const RenderModel& model, const FrameParameters& parameters, float fovyDegrees, float viewportHeight, float pixelError = 1.0f);
+
+// Clusters of the model inside the view volume of the frame
+void cullRenderModel(const RenderModel& model, const FrameParameters& parameters, VisibleClusters& outVisible);
+
+// What to draw of the model this frame: the visible clusters of the full mesh when culling,
+// otherwise the whole level
+void selectDrawRanges(const RenderModel& model, const FrameParameters& parameters, unsigned int lod, bool culling, VisibleClusters& outRanges);
+
+// Where loadShaderProgram keeps linked program binaries (ProgramCache)
+const char* const programCacheDirectory = "../data/shaders/cache";
+
+// Read ../data/shaders/shader.vs/.fs with the defines, the octahedral normal decoder for the
+// quantized layout and the per instance attributes (instancingGLSL) when instanced
+bool readShaderSources(VertexLayout::Type layout, bool instanced, ShaderData& outData, const std::vector<std::string>& defines = {});
+
+// Compile the readShaderSources program, or load the binary an earlier run stored in
+// programCacheDirectory unless binaryCache is false. Prints the time it took. Returns nullptr on failure.
+std::unique_ptr<ShaderProgram> loadShaderProgram(VertexLayout::Type layout, bool instanced = false, bool binaryCache = true,
+	const std::vector<std::string>& defines = {});
+
+// One program per ShadingVariant with its FrameUniforms, built (or loaded from the binary cache)
+// the first time the variant is asked for. Each variant's uniforms use their own binding point.
+// Needs a current GL context.
+class ShadingPrograms {
+	public:
+		ShadingPrograms(VertexLayout::Type layout);
+
+		// nullptr if the variant failed to build
+		ShaderProgram* getProgram(const ShadingVariant& variant);
+		FrameUniforms* getUniforms(const ShadingVariant& variant);
+
+	private:
+		VertexLayout::Type layout;
+		std::unique_ptr<ShaderProgram> programs[ShadingVariant::count];
+		std::unique_ptr<FrameUniforms> uniforms[ShadingVariant::count];
+		bool failed[ShadingVariant::count] = {};
+
+		bool build(unsigned int index, const ShadingVariant& variant);
+};
+
+// Clear, bind the program, upload the parameters and draw the index ranges (selectDrawRanges).
+// legacyUniforms looks every uniform up by name instead of using uniforms. Returns the number of
+// GL calls issued.
+unsigned int renderFrame(ShaderProgram& program, FrameUniforms& uniforms, GpuMesh& mesh, const FrameParameters& parameters, bool legacyUniforms,
+	const VisibleClusters& ranges);
+
+// renderFrame for a model that is still loading: draws the triangles the progressive mesh has
+// so far, or only clears when there is none yet
+unsigned int renderFrame(ShaderProgram& program, FrameUniforms& uniforms, ProgressiveMesh* mesh, const FrameParameters& parameters, bool legacyUniforms);
+
+// Read the model (through the mesh cache) and draw it with the SoftwareRasterizer, without a GL
+// context, into a width x height PPM at imagePath. With a referencePath PPM, fails when more than
+// 1% of the pixels differ from it.
+bool renderSoftwareImage(const std::string& name, const ViewState& view, int width, int height, const std::string& imagePath,
+	const std::string& referencePath = "");
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class SceneInstance {
+	public:
+		unsigned int model;   // index into SceneData::models
+		glm::mat4 transform;
+};
+
+// Models are listed once however many instances use them
+class SceneData {
+	public:
+		std::vector<std::string> models;
+		std::vector<SceneInstance> instances;
+};
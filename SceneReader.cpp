@@ -0,0 +1,71 @@
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SceneReader.h"
+
+SceneReader::SceneReader(const std::string& scenePath) {
+    this->scenePath = scenePath;
+    errorFlag = false;
+}
+
+void SceneReader::read(SceneData& data) {
+    std::ifstream inStream(scenePath);
+    if (!inStream.is_open()) {
+        std::cerr << "Error: Cannot open file " << scenePath << std::endl;
+        errorFlag = true;
+        return;
+    }
+
+    std::unordered_map<std::string, unsigned int> modelIndices;
+    for (size_t i = 0; i < data.models.size(); i++) {
+        modelIndices[data.models[i]] = i;
+    }
+
+    std::string currentLine;
+    int lineNumber = 0;
+    while (getline(inStream, currentLine)) {
+        lineNumber++;
+        size_t comment = currentLine.find('#');
+        if (comment != std::string::npos) {
+            currentLine.erase(comment);
+        }
+
+        std::stringstream currentLineStream(currentLine);
+        std::string keyword;
+        if (!(currentLineStream >> keyword)) {
+            continue;
+        }
+
+        std::string model;
+        glm::vec3 position(0.0f);
+        glm::vec3 rotation(0.0f);
+        float scale = 1.0f;
+        if (keyword != "instance" || !(currentLineStream >> model >> position.x >> position.y >> position.z)) {
+            std::cerr << "Error: " << scenePath << ":" << lineNumber << ": expected instance <model> <x> <y> <z>" << std::endl;
+            errorFlag = true;
+            return;
+        }
+        if (currentLineStream >> rotation.x >> rotation.y >> rotation.z) {
+            currentLineStream >> scale;
+        }
+
+        auto found = modelIndices.find(model);
+        if (found == modelIndices.end()) {
+            found = modelIndices.emplace(model, data.models.size()).first;
+            data.models.push_back(model);
+        }
+        data.instances.push_back({ found->second, instanceTransform(position, rotation, scale) });
+    }
+}
+
+glm::mat4 instanceTransform(const glm::vec3& position, const glm::vec3& rotationDegrees, float scale) {
+    glm::mat4 identity(1.0f);
+    return glm::translate(identity, position)
+        * glm::rotate(identity, glm::radians(rotationDegrees.x), glm::vec3(1.f, 0.f, 0.f))
+        * glm::rotate(identity, glm::radians(rotationDegrees.y), glm::vec3(0.f, 1.f, 0.f))
+        * glm::rotate(identity, glm::radians(rotationDegrees.z), glm::vec3(0.f, 0.f, 1.f))
+        * glm::scale(identity, glm::vec3(scale));
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+#include "SceneData.h"
+
+// Reads a scene file: one "instance <model> <x> <y> <z> [<rx> <ry> <rz> [<scale>]]" line per
+// placed copy of an .obj model, rotations in degrees. '#' starts a comment.
+class SceneReader {
+    public:
+        SceneReader(const std::string& scenePath);
+        void read(SceneData& data);
+        bool wasError(){ return errorFlag; }
+
+    private:
+        bool errorFlag;
+        std::string scenePath;
+};
+
+// Transform of an instance line: translate * rotate x * rotate y * rotate z * scale
+glm::mat4 instanceTransform(const glm::vec3& position, const glm::vec3& rotationDegrees, float scale);
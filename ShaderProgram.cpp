@@ -1,15 +1,34 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <iostream>
+#include <memory>
 
 #include "ShaderProgram.h"
+#include "ProgramCache.h"
+#include "Trace.h"
 
 
 // From https://learnopengl.com/Getting-started/Shaders
 // On contruction, links and compiles shader data through OpenGL
-ShaderProgram::ShaderProgram(ShaderData& shaderData) { 
-	// 2. compile shaders
+ShaderProgram::ShaderProgram(ShaderData& shaderData, const std::string& binaryCacheDirectory) { 
+	// 1. a binary linked by an earlier run skips compiling and linking
 	errorFlag = false;
+	loadedFromCache = false;
+	std::unique_ptr<ProgramCache> cache;
+	if(!binaryCacheDirectory.empty()){
+		cache.reset(new ProgramCache(binaryCacheDirectory, shaderData));
+		ID = glCreateProgram();
+		if(cache->load(ID)){
+			loadedFromCache = true;
+			reflectUniforms();
+			return;
+		}
+		glDeleteProgram(ID);
+	}
+
+	// 2. compile shaders
+	TraceScope trace("ShaderProgram::compileAndLink");
+	trace.setBytes(shaderData.vertexShaderCode.size() + shaderData.fragmentShaderCode.size());
 	int success;
 	char infoLog[512];
 	
@@ -45,6 +64,9 @@ ShaderProgram::ShaderProgram(ShaderData& shaderData) {
 	ID = glCreateProgram();
 	glAttachShader(ID, vertex);
 	glAttachShader(ID, fragment);
+	if(cache && cache->isSupported()){
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(ID);
 
 	// print linking errors if any
@@ -59,6 +81,78 @@ ShaderProgram::ShaderProgram(ShaderData& shaderData) {
 	// delete the shaders as they're linked into our program now and no longer necessary
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+
+	if(!errorFlag){
+		reflectUniforms();
+		if(cache){
+			cache->store(ID);
+		}
+	}
+}
+
+// Cache every active uniform and uniform block so the render loop never looks names up in GL
+void ShaderProgram::reflectUniforms(){
+	int blockCount = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	for(int i = 0; i < blockCount; i++){
+		char name[256];
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(ID, i, sizeof(name), &length, name);
+		ShaderUniformBlock block;
+		block.name = std::string(name, length);
+		block.index = i;
+		glGetActiveUniformBlockiv(ID, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+		uniformBlocks.push_back(block);
+	}
+
+	int uniformCount = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for(int i = 0; i < uniformCount; i++){
+		char name[256];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, i, sizeof(name), &length, &size, &type, name);
+
+		ShaderUniform uniform;
+		uniform.name = std::string(name, length);
+		uniform.type = type;
+		uniform.size = size;
+
+		GLuint index = i;
+		glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &uniform.blockIndex);
+		if(uniform.blockIndex >= 0){
+			glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_OFFSET, &uniform.offset);
+		} else {
+			uniform.location = glGetUniformLocation(ID, name);
+		}
+
+		size_t arraySuffix = uniform.name.rfind("[0]");
+		if(arraySuffix != std::string::npos && arraySuffix + 3 == uniform.name.size()){
+			uniform.name.erase(arraySuffix);
+		}
+		uniformIndices[uniform.name] = uniforms.size();
+		uniforms.push_back(uniform);
+	}
+}
+
+const ShaderUniform* ShaderProgram::findUniform(const std::string& name) const {
+	auto found = uniformIndices.find(name);
+	return found == uniformIndices.end() ? nullptr : &uniforms[found->second];
+}
+
+const ShaderUniformBlock* ShaderProgram::findUniformBlock(const std::string& name) const {
+	for(const ShaderUniformBlock& block : uniformBlocks){
+		if(block.name == name){
+			return &block;
+		}
+	}
+	return nullptr;
+}
+
+int ShaderProgram::getUniformLocation(const std::string& name) const {
+	const ShaderUniform* uniform = findUniform(name);
+	return uniform == nullptr ? -1 : uniform->location;
 }
 
 ShaderProgram::~ShaderProgram(){
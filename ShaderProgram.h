@@ -1,17 +1,57 @@
 #pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
 #include "ShaderData.h"
 
+// An active uniform as reported by the driver after linking. Arrays are listed once under
+// their name without "[0]". Members of a uniform block have no location but a block index
+// and a byte offset inside the block.
+class ShaderUniform {
+	public:
+		std::string name;
+		unsigned int type;
+		int size;
+		int location = -1;
+		int blockIndex = -1;
+		int offset = -1;
+};
+
+class ShaderUniformBlock {
+	public:
+		std::string name;
+		unsigned int index;
+		int dataSize;
+};
+
 class ShaderProgram {
     public:
-        // constructor reads and builds the shader
-        ShaderProgram(ShaderData& data);
+        // constructor reads and builds the shader. With a binaryCacheDirectory the linked program
+        // is loaded from / stored to a ProgramCache there, compiling only when it misses.
+        ShaderProgram(ShaderData& data, const std::string& binaryCacheDirectory = "");
 		~ShaderProgram();
 		void use();
 
         bool wasError() { return errorFlag; }
-		unsigned int getID() { return ID; }
+		bool wasLoadedFromCache() { return loadedFromCache; }
+		unsigned int getID() const { return ID; }
+
+		// Reflection over the active uniforms, queried once after linking.
+		// Lookups don't call into GL; missing names give -1 / nullptr.
+		const std::vector<ShaderUniform>& getUniforms() const { return uniforms; }
+		const std::vector<ShaderUniformBlock>& getUniformBlocks() const { return uniformBlocks; }
+		const ShaderUniform* findUniform(const std::string& name) const;
+		const ShaderUniformBlock* findUniformBlock(const std::string& name) const;
+		int getUniformLocation(const std::string& name) const;
 
     private:
 		unsigned int ID;
         bool errorFlag;
+		bool loadedFromCache;
+
+		std::vector<ShaderUniform> uniforms;
+		std::vector<ShaderUniformBlock> uniformBlocks;
+		std::unordered_map<std::string, size_t> uniformIndices;
+
+		void reflectUniforms();
 };
\ No newline at end of file
@@ -1,14 +1,17 @@
 #include <string>
 #include "ShaderReader.h"
+#include "Trace.h"
 
-ShaderReader::ShaderReader(const char* vertexPath, const char* fragmentPath) {
+ShaderReader::ShaderReader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines) {
     this->vertexPath = vertexPath;
     this->fragmentPath = fragmentPath;
+    this->defines = defines;
 }
 
 // From https://learnopengl.com/Getting-started/Shaders
 // Reads shader from file
 void ShaderReader::read(ShaderData& data) {
+    TraceScope trace("ShaderReader::read");
     // 1. retrieve the vertex/fragment source code from filePath
     std::ifstream vShaderFile;
     std::ifstream fShaderFile;
@@ -34,10 +37,31 @@ void ShaderReader::read(ShaderData& data) {
         // convert stream into string
         data.vertexShaderCode = vShaderStream.str();
         data.fragmentShaderCode = fShaderStream.str(); 
+        insertDefines(data.vertexShaderCode);
+        insertDefines(data.fragmentShaderCode);
+        trace.setBytes(data.vertexShaderCode.size() + data.fragmentShaderCode.size());
         errorFlag = false;
     }
     catch(std::ifstream::failure e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         errorFlag = true;
     }
+}
+
+// #version has to stay the first statement, so the defines go on the lines after it
+void ShaderReader::insertDefines(std::string& source) {
+    if (defines.empty()) {
+        return;
+    }
+    std::string block;
+    for (const std::string& define : defines) {
+        block += "#define " + define + "\n";
+    }
+    size_t version = source.find("#version");
+    size_t insertAt = 0;
+    if (version != std::string::npos) {
+        size_t lineEnd = source.find('\n', version);
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+    source.insert(insertAt, block);
 }
\ No newline at end of file
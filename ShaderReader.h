@@ -3,12 +3,15 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>  
+#include <vector>
 
 #include "ShaderData.h"
 
 class ShaderReader {
     public:
-        ShaderReader(const char* vertexPath, const char* fragmentPath);
+        // defines ("NAME" or "NAME value") are inserted into both sources after #version,
+        // so one pair of files can be built into several variants
+        ShaderReader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {});
         void read(ShaderData& data);
         bool wasError(){ return errorFlag; }
 
@@ -16,4 +19,7 @@ class ShaderReader {
         bool errorFlag;
         const char* vertexPath;
         const char* fragmentPath;
+        std::vector<std::string> defines;
+
+        void insertDefines(std::string& source);
 };
\ No newline at end of file
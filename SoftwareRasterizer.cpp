@@ -0,0 +1,667 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTERIZER_SSE
+#endif
+
+#include "SoftwareRasterizer.h"
+#include "Trace.h"
+
+namespace {
+	const int subpixelBits = 4;
+	const int subpixelScale = 1 << subpixelBits;
+	// Triangles reaching further outside the target are clipped. With 4 sub pixel bits the edge
+	// values over a partly covered block then fit in 32 bits for targets up to 16k pixels wide.
+	const float guardBandPixels = 1024.0f;
+	const size_t verticesPerRange = 4096;
+	const size_t minTrianglesPerBin = 4096;
+	const int blocksPerTile = SoftwareRasterizer::tileSize / SoftwareRasterizer::blockSize;
+
+	// Sides of the view volume (or guard band) a clip space position can be outside of
+	enum ClipPlane : unsigned int {
+		CLIP_NEAR = 1,
+		CLIP_FAR = 2,
+		CLIP_LEFT = 4,
+		CLIP_RIGHT = 8,
+		CLIP_BOTTOM = 16,
+		CLIP_TOP = 32
+	};
+
+	// Planes the position is outside of, with the sides scaled by guard (1 for the view volume)
+	unsigned int outcode(const glm::vec4& position, float guardX, float guardY){
+		unsigned int code = 0;
+		if(position.z < -position.w){
+			code |= CLIP_NEAR;
+		}
+		if(position.z > position.w){
+			code |= CLIP_FAR;
+		}
+		if(position.x < -guardX * position.w){
+			code |= CLIP_LEFT;
+		}
+		if(position.x > guardX * position.w){
+			code |= CLIP_RIGHT;
+		}
+		if(position.y < -guardY * position.w){
+			code |= CLIP_BOTTOM;
+		}
+		if(position.y > guardY * position.w){
+			code |= CLIP_TOP;
+		}
+		return code;
+	}
+
+	int64_t floorDivide(int64_t value, int64_t divisor){
+		return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+
+	glm::vec3 lighting(const FrameParameters& parameters, const glm::vec3& position, const glm::vec3& normal, float ambient){
+		glm::vec3 l = glm::normalize(parameters.lightPosition - position);
+		glm::vec3 v = glm::normalize(parameters.viewerPosition - position);
+		float diffuse = std::max(glm::dot(normal, l), 0.0f);
+		float reflected = glm::dot(glm::reflect(-l, normal), v);
+		float specular = reflected > 0.0f ? std::pow(reflected, parameters.shininess) : 0.0f;
+		return (ambient + diffuse + specular) * parameters.lightColor * parameters.objectColor;
+	}
+
+	// Normal of the triangle turned towards the viewer, as cross(dFdx, dFdy) is
+	glm::vec3 facingNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& viewerPosition){
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if(length == 0.0f){
+			return glm::vec3(0.0f);
+		}
+		normal /= length;
+		return glm::dot(normal, viewerPosition - a) < 0.0f ? -normal : normal;
+	}
+
+	unsigned char toUnorm8(float value){
+		return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	// Bit 8 * row + column of a block set where the pixel is inside every partial edge, for rows
+	// firstRow to lastRow. value is the edge at the block's first pixel, stepX and stepY its change per pixel.
+	uint64_t blockCoverage(const int32_t* value, const int32_t* stepX, const int32_t* stepY, int edgeCount, int firstRow, int lastRow){
+		const int size = SoftwareRasterizer::blockSize;
+		uint64_t coverage = 0;
+#if defined(RASTERIZER_SSE)
+		__m128i left[3], right[3], down[3];
+		for(int k = 0; k < edgeCount; k++){
+			int32_t first = value[k] + firstRow * stepY[k];
+			left[k] = _mm_setr_epi32(first, first + stepX[k], first + 2 * stepX[k], first + 3 * stepX[k]);
+			right[k] = _mm_add_epi32(left[k], _mm_set1_epi32(4 * stepX[k]));
+			down[k] = _mm_set1_epi32(stepY[k]);
+		}
+		for(int row = firstRow; row <= lastRow; row++){
+			// A pixel is outside when any edge is negative: or the values and look at the sign bits
+			__m128i outsideLeft = _mm_setzero_si128();
+			__m128i outsideRight = _mm_setzero_si128();
+			for(int k = 0; k < edgeCount; k++){
+				outsideLeft = _mm_or_si128(outsideLeft, left[k]);
+				outsideRight = _mm_or_si128(outsideRight, right[k]);
+				left[k] = _mm_add_epi32(left[k], down[k]);
+				right[k] = _mm_add_epi32(right[k], down[k]);
+			}
+			int outside = _mm_movemask_ps(_mm_castsi128_ps(outsideLeft)) | (_mm_movemask_ps(_mm_castsi128_ps(outsideRight)) << 4);
+			coverage |= (uint64_t)(~outside & 0xff) << (row * size);
+		}
+#else
+		for(int row = firstRow; row <= lastRow; row++){
+			for(int column = 0; column < size; column++){
+				bool inside = true;
+				for(int k = 0; k < edgeCount; k++){
+					inside = inside && value[k] + column * stepX[k] + row * stepY[k] >= 0;
+				}
+				coverage |= (uint64_t)inside << (row * size + column);
+			}
+		}
+#endif
+		return coverage;
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, unsigned int threadCount) : pool(threadCount) {
+	this->width = std::max(width, 1);
+	this->height = std::max(height, 1);
+	tilesX = (this->width + tileSize - 1) / tileSize;
+	tilesY = (this->height + tileSize - 1) / tileSize;
+	pixels.resize((size_t)this->width * this->height * 4);
+	depth.resize((size_t)this->width * this->height);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer(){
+}
+
+void SoftwareRasterizer::runParallel(size_t count, const std::function<void(size_t)>& fn){
+	size_t workerCount = std::min<size_t>(pool.getThreadCount(), count);
+	if(workerCount <= 1){
+		for(size_t i = 0; i < count; i++){
+			fn(i);
+		}
+		return;
+	}
+	std::atomic<size_t> next(0);
+	std::vector<std::future<void>> workers;
+	workers.reserve(workerCount);
+	for(size_t worker = 0; worker < workerCount; worker++){
+		workers.push_back(pool.submit([&](){
+			for(size_t i = next++; i < count; i = next++){
+				fn(i);
+			}
+		}));
+	}
+	for(std::future<void>& worker : workers){
+		worker.get();
+	}
+}
+
+void SoftwareRasterizer::render(const ObjData& mesh, const FrameParameters& parameters){
+	TraceScope trace("SoftwareRasterizer::render");
+	size_t triangleCount = mesh.vertexIndices.size() / 3;
+	trace.setTriangles(triangleCount);
+
+	Frame frame;
+	frame.mesh = &mesh;
+	frame.parameters = &parameters;
+	frame.viewProjection = parameters.projection * parameters.view;
+	frame.smoothNormals = !mesh.normals.empty() && mesh.normalIndices.size() == mesh.vertexIndices.size();
+	frame.gouraud = parameters.useGouraudShading && !parameters.showZBuffer;
+	transformVertices(frame);
+
+	// Bins are kept across frames so their vectors keep their capacity
+	size_t binCount = std::max<size_t>(1, std::min<size_t>(pool.getThreadCount() * 4, triangleCount / minTrianglesPerBin));
+	bins.resize(binCount);
+	std::vector<Stats> binStats(binCount);
+	{
+		TraceScope setupTrace("SoftwareRasterizer::setup");
+		runParallel(binCount, [&](size_t i){
+			setUpTriangles(frame, triangleCount * i / binCount, triangleCount * (i + 1) / binCount, bins[i], binStats[i]);
+		});
+	}
+
+	size_t tileCount = (size_t)tilesX * tilesY;
+	std::vector<Stats> tileStats(tileCount);
+	{
+		TraceScope rasterTrace("SoftwareRasterizer::raster");
+		runParallel(tileCount, [&](size_t tile){
+			drawTile(frame, (int)(tile % tilesX), (int)(tile / tilesX), tileStats[tile]);
+		});
+	}
+
+	stats = Stats();
+	for(const Stats& bin : binStats){
+		stats.trianglesSetUp += bin.trianglesSetUp;
+		stats.trianglesClipped += bin.trianglesClipped;
+		stats.binnedTriangles += bin.binnedTriangles;
+	}
+	for(const Stats& tile : tileStats){
+		stats.blocksTested += tile.blocksTested;
+		stats.blocksRejectedByDepth += tile.blocksRejectedByDepth;
+		stats.pixelsShaded += tile.pixelsShaded;
+	}
+}
+
+void SoftwareRasterizer::transformVertices(const Frame& frame){
+	TraceScope trace("SoftwareRasterizer::transform");
+	const ObjData& mesh = *frame.mesh;
+	const FrameParameters& parameters = *frame.parameters;
+	clipPositions.resize(mesh.vertices.size());
+	worldPositions.resize(mesh.vertices.size());
+	worldNormals.resize(frame.smoothNormals ? mesh.normals.size() : 0);
+
+	size_t positionRanges = (mesh.vertices.size() + verticesPerRange - 1) / verticesPerRange;
+	size_t normalRanges = (worldNormals.size() + verticesPerRange - 1) / verticesPerRange;
+	glm::mat3 normalMatrix = parameters.getNormalMatrix();
+	runParallel(positionRanges + normalRanges, [&](size_t range){
+		if(range < positionRanges){
+			size_t end = std::min(mesh.vertices.size(), (range + 1) * verticesPerRange);
+			for(size_t i = range * verticesPerRange; i < end; i++){
+				glm::vec4 world = parameters.model * glm::vec4(mesh.vertices[i], 1.0f);
+				worldPositions[i] = glm::vec3(world);
+				clipPositions[i] = frame.viewProjection * world;
+			}
+		} else {
+			range -= positionRanges;
+			size_t end = std::min(worldNormals.size(), (range + 1) * verticesPerRange);
+			for(size_t i = range * verticesPerRange; i < end; i++){
+				worldNormals[i] = glm::normalize(normalMatrix * mesh.normals[i]);
+			}
+		}
+	});
+
+	// Gouraud lights each corner once, as the vertex shader does
+	if(!frame.gouraud){
+		return;
+	}
+	size_t cornerCount = mesh.vertexIndices.size() / 3 * 3;
+	cornerColors.resize(cornerCount);
+	size_t cornerRanges = (cornerCount + verticesPerRange - 1) / verticesPerRange;
+	runParallel(cornerRanges, [&](size_t range){
+		size_t end = std::min(cornerCount, (range + 1) * verticesPerRange);
+		for(size_t corner = range * verticesPerRange; corner < end; corner++){
+			size_t first = corner - corner % 3;
+			unsigned int vertex = mesh.vertexIndices[corner];
+			if(vertex >= worldPositions.size()){
+				cornerColors[corner] = glm::vec3(0.0f);
+				continue;
+			}
+			glm::vec3 normal;
+			if(frame.smoothNormals){
+				unsigned int normalIndex = mesh.normalIndices[corner];
+				normal = normalIndex < worldNormals.size() ? worldNormals[normalIndex] : glm::vec3(0.0f);
+			} else {
+				unsigned int a = mesh.vertexIndices[first], b = mesh.vertexIndices[first + 1], c = mesh.vertexIndices[first + 2];
+				size_t count = worldPositions.size();
+				normal = a < count && b < count && c < count
+					? facingNormal(worldPositions[a], worldPositions[b], worldPositions[c], parameters.viewerPosition) : glm::vec3(0.0f);
+			}
+			cornerColors[corner] = lighting(parameters, worldPositions[vertex], normal, 0.0f);
+		}
+	});
+}
+
+void SoftwareRasterizer::setUpTriangles(const Frame& frame, size_t begin, size_t end, Bin& bin, Stats& binStats){
+	const ObjData& mesh = *frame.mesh;
+	bin.triangles.clear();
+	bin.tiles.resize((size_t)tilesX * tilesY);
+	for(std::vector<unsigned int>& tile : bin.tiles){
+		tile.clear();
+	}
+
+	float guardX = 1.0f + 2.0f * guardBandPixels / width;
+	float guardY = 1.0f + 2.0f * guardBandPixels / height;
+	for(size_t triangle = begin; triangle < end; triangle++){
+		const unsigned int* corners = &mesh.vertexIndices[3 * triangle];
+		if(corners[0] >= clipPositions.size() || corners[1] >= clipPositions.size() || corners[2] >= clipPositions.size()){
+			continue;
+		}
+		if(frame.smoothNormals){
+			const unsigned int* normals = &mesh.normalIndices[3 * triangle];
+			if(normals[0] >= worldNormals.size() || normals[1] >= worldNormals.size() || normals[2] >= worldNormals.size()){
+				continue;
+			}
+		}
+
+		ClipVertex vertices[3];
+		for(int k = 0; k < 3; k++){
+			vertices[k].position = clipPositions[corners[k]];
+			vertices[k].barycentric = glm::vec3(k == 0, k == 1, k == 2);
+		}
+		// Entirely outside one side of the view volume
+		if(outcode(vertices[0].position, 1.0f, 1.0f) & outcode(vertices[1].position, 1.0f, 1.0f) & outcode(vertices[2].position, 1.0f, 1.0f)){
+			continue;
+		}
+		if(outcode(vertices[0].position, guardX, guardY) | outcode(vertices[1].position, guardX, guardY) | outcode(vertices[2].position, guardX, guardY)){
+			setUpClipped(vertices, (unsigned int)triangle, bin, binStats);
+		} else {
+			setUpTriangle(vertices[0], vertices[1], vertices[2], (unsigned int)triangle, bin, binStats);
+		}
+	}
+}
+
+void SoftwareRasterizer::setUpClipped(const ClipVertex* vertices, unsigned int triangle, Bin& bin, Stats& binStats){
+	binStats.trianglesClipped++;
+	float guardX = 1.0f + 2.0f * guardBandPixels / width;
+	float guardY = 1.0f + 2.0f * guardBandPixels / height;
+	const glm::vec4 planes[6] = {
+		glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+		glm::vec4(0.0f, 0.0f, -1.0f, 1.0f),
+		glm::vec4(1.0f, 0.0f, 0.0f, guardX),
+		glm::vec4(-1.0f, 0.0f, 0.0f, guardX),
+		glm::vec4(0.0f, 1.0f, 0.0f, guardY),
+		glm::vec4(0.0f, -1.0f, 0.0f, guardY)
+	};
+
+	// Sutherland-Hodgman; each plane adds at most one vertex
+	ClipVertex polygon[2][9];
+	int count = 3;
+	std::copy(vertices, vertices + 3, polygon[0]);
+	int current = 0;
+	for(const glm::vec4& plane : planes){
+		const ClipVertex* input = polygon[current];
+		ClipVertex* output = polygon[1 - current];
+		int outputCount = 0;
+		for(int i = 0; i < count; i++){
+			const ClipVertex& a = input[i];
+			const ClipVertex& b = input[(i + 1) % count];
+			float distanceA = glm::dot(plane, a.position);
+			float distanceB = glm::dot(plane, b.position);
+			if(distanceA >= 0.0f){
+				output[outputCount++] = a;
+			}
+			if((distanceA >= 0.0f) != (distanceB >= 0.0f)){
+				float t = distanceA / (distanceA - distanceB);
+				output[outputCount].position = a.position + (b.position - a.position) * t;
+				output[outputCount].barycentric = a.barycentric + (b.barycentric - a.barycentric) * t;
+				outputCount++;
+			}
+		}
+		count = outputCount;
+		current = 1 - current;
+		if(count < 3){
+			return;
+		}
+	}
+	for(int i = 1; i + 1 < count; i++){
+		setUpTriangle(polygon[current][0], polygon[current][i], polygon[current][i + 1], triangle, bin, binStats);
+	}
+}
+
+void SoftwareRasterizer::setUpTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, unsigned int triangle, Bin& bin, Stats& binStats){
+	const ClipVertex* vertices[3] = { &v0, &v1, &v2 };
+	double x[3], y[3];
+	float z[3], inverseW[3];
+	int64_t fixedX[3], fixedY[3];
+	for(int k = 0; k < 3; k++){
+		const glm::vec4& position = vertices[k]->position;
+		inverseW[k] = 1.0f / position.w;
+		fixedX[k] = std::llround(((double)position.x * inverseW[k] * 0.5 + 0.5) * width * subpixelScale);
+		fixedY[k] = std::llround(((double)position.y * inverseW[k] * 0.5 + 0.5) * height * subpixelScale);
+		x[k] = (double)fixedX[k] / subpixelScale;
+		y[k] = (double)fixedY[k] / subpixelScale;
+		z[k] = position.z * inverseW[k] * 0.5f + 0.5f;
+	}
+	int64_t area = (fixedX[1] - fixedX[0]) * (fixedY[2] - fixedY[0]) - (fixedX[2] - fixedX[0]) * (fixedY[1] - fixedY[0]);
+	if(area == 0){
+		return;
+	}
+
+	// Pixels whose centers are in the bounding box, inside the target
+	int64_t minFixedX = std::min({ fixedX[0], fixedX[1], fixedX[2] }), maxFixedX = std::max({ fixedX[0], fixedX[1], fixedX[2] });
+	int64_t minFixedY = std::min({ fixedY[0], fixedY[1], fixedY[2] }), maxFixedY = std::max({ fixedY[0], fixedY[1], fixedY[2] });
+	const int64_t halfPixel = subpixelScale / 2;
+	RasterTriangle raster;
+	raster.minX = (int)std::max<int64_t>(0, floorDivide(minFixedX - halfPixel + subpixelScale - 1, subpixelScale));
+	raster.minY = (int)std::max<int64_t>(0, floorDivide(minFixedY - halfPixel + subpixelScale - 1, subpixelScale));
+	raster.maxX = (int)std::min<int64_t>(width - 1, floorDivide(maxFixedX - halfPixel, subpixelScale));
+	raster.maxY = (int)std::min<int64_t>(height - 1, floorDivide(maxFixedY - halfPixel, subpixelScale));
+	if(raster.minX > raster.maxX || raster.minY > raster.maxY){
+		return;
+	}
+
+	// Counterclockwise on screen, so the inside is left of every edge. Pixels exactly on an edge
+	// belong to the triangle on its left or top side only (edges going down, or left when
+	// horizontal), so neighbours sharing it don't both draw them.
+	int order[3] = { 0, 1, 2 };
+	if(area < 0){
+		std::swap(order[1], order[2]);
+	}
+	for(int k = 0; k < 3; k++){
+		int a = order[(k + 1) % 3];
+		int b = order[(k + 2) % 3];
+		int64_t edgeA = fixedY[a] - fixedY[b];
+		int64_t edgeB = fixedX[b] - fixedX[a];
+		bool topLeft = edgeA > 0 || (edgeA == 0 && edgeB < 0);
+		raster.a[k] = (int32_t)edgeA;
+		raster.b[k] = (int32_t)edgeB;
+		raster.c[k] = -(edgeA * fixedX[a] + edgeB * fixedY[a]) - (topLeft ? 0 : 1);
+	}
+
+	// Planes through the three vertices, evaluated at pixel centers
+	double determinant = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	auto plane = [&](double value0, double value1, double value2){
+		double dx = ((value1 - value0) * (y[2] - y[0]) - (value2 - value0) * (y[1] - y[0])) / determinant;
+		double dy = ((value2 - value0) * (x[1] - x[0]) - (value1 - value0) * (x[2] - x[0])) / determinant;
+		Plane result;
+		result.c = (float)(value0 + dx * (0.5 - x[0]) + dy * (0.5 - y[0]));
+		result.dx = (float)dx;
+		result.dy = (float)dy;
+		return result;
+	};
+	raster.depth = plane(z[0], z[1], z[2]);
+	raster.inverseW = plane(inverseW[0], inverseW[1], inverseW[2]);
+	raster.barycentric1 = plane(v0.barycentric.y * inverseW[0], v1.barycentric.y * inverseW[1], v2.barycentric.y * inverseW[2]);
+	raster.barycentric2 = plane(v0.barycentric.z * inverseW[0], v1.barycentric.z * inverseW[1], v2.barycentric.z * inverseW[2]);
+	raster.nearestDepth = std::max(0.0f, std::min({ z[0], z[1], z[2] }));
+	raster.triangle = triangle;
+
+	unsigned int index = (unsigned int)bin.triangles.size();
+	bin.triangles.push_back(raster);
+	binStats.trianglesSetUp++;
+	for(int tileY = raster.minY / tileSize; tileY <= raster.maxY / tileSize; tileY++){
+		for(int tileX = raster.minX / tileSize; tileX <= raster.maxX / tileSize; tileX++){
+			bin.tiles[(size_t)tileY * tilesX + tileX].push_back(index);
+			binStats.binnedTriangles++;
+		}
+	}
+}
+
+void SoftwareRasterizer::drawTile(const Frame& frame, int tileX, int tileY, Stats& tileStats){
+	const int originX = tileX * tileSize;
+	const int originY = tileY * tileSize;
+	const int tileWidth = std::min(tileSize, width - originX);
+	const int tileHeight = std::min(tileSize, height - originY);
+	const size_t tile = (size_t)tileY * tilesX + tileX;
+
+	// Nearest depth and triangle per pixel, and the farthest depth per block and in the tile
+	float tileDepth[tileSize * tileSize];
+	const RasterTriangle* nearest[tileSize * tileSize];
+	float farthest[blocksPerTile * blocksPerTile];
+	std::fill(tileDepth, tileDepth + tileSize * tileSize, 1.0f);
+	std::fill(nearest, nearest + tileSize * tileSize, nullptr);
+	std::fill(farthest, farthest + blocksPerTile * blocksPerTile, 1.0f);
+	float tileFarthest = 1.0f;
+
+	for(const Bin& bin : bins){
+		for(unsigned int index : bin.tiles[tile]){
+			const RasterTriangle& triangle = bin.triangles[index];
+			if(triangle.nearestDepth >= tileFarthest){
+				continue;
+			}
+			bool blockChanged = false;
+			int firstBlockX = (std::max(triangle.minX, originX) - originX) / blockSize;
+			int firstBlockY = (std::max(triangle.minY, originY) - originY) / blockSize;
+			int lastBlockX = (std::min(triangle.maxX, originX + tileWidth - 1) - originX) / blockSize;
+			int lastBlockY = (std::min(triangle.maxY, originY + tileHeight - 1) - originY) / blockSize;
+			for(int blockY = firstBlockY; blockY <= lastBlockY; blockY++){
+				for(int blockX = firstBlockX; blockX <= lastBlockX; blockX++){
+					tileStats.blocksTested++;
+					int block = blockY * blocksPerTile + blockX;
+					if(triangle.nearestDepth >= farthest[block]){
+						tileStats.blocksRejectedByDepth++;
+						continue;
+					}
+
+					// Edges at the block's first pixel center; the extremes over the block are at its corners
+					int x = originX + blockX * blockSize;
+					int y = originY + blockY * blockSize;
+					int32_t value[3], stepX[3], stepY[3];
+					int partialEdges = 0;
+					bool outside = false;
+					for(int k = 0; k < 3 && !outside; k++){
+						int64_t dx = (int64_t)triangle.a[k] * subpixelScale;
+						int64_t dy = (int64_t)triangle.b[k] * subpixelScale;
+						int64_t first = triangle.a[k] * ((int64_t)x * subpixelScale + subpixelScale / 2)
+							+ triangle.b[k] * ((int64_t)y * subpixelScale + subpixelScale / 2) + triangle.c[k];
+						int64_t lowest = first + std::min<int64_t>(0, dx * (blockSize - 1)) + std::min<int64_t>(0, dy * (blockSize - 1));
+						int64_t highest = first + std::max<int64_t>(0, dx * (blockSize - 1)) + std::max<int64_t>(0, dy * (blockSize - 1));
+						if(highest < 0){
+							outside = true;
+						} else if(lowest < 0){
+							// Crosses the block, so first is within a block's change of 0
+							value[partialEdges] = (int32_t)first;
+							stepX[partialEdges] = (int32_t)dx;
+							stepY[partialEdges] = (int32_t)dy;
+							partialEdges++;
+						}
+					}
+					if(outside){
+						continue;
+					}
+					// Only the rows and columns of the block in the triangle's bounding box and the tile
+					int firstRow = std::max(triangle.minY - y, 0);
+					int lastRow = std::min(std::min(triangle.maxY - y, originY + tileHeight - 1 - y), blockSize - 1);
+					int firstColumn = std::max(triangle.minX - x, 0);
+					int lastColumn = std::min(std::min(triangle.maxX - x, originX + tileWidth - 1 - x), blockSize - 1);
+					unsigned int columns = ((2u << lastColumn) - 1) & ~((1u << firstColumn) - 1);
+					uint64_t coverage = partialEdges ? blockCoverage(value, stepX, stepY, partialEdges, firstRow, lastRow) : ~(uint64_t)0;
+
+					// The block's farthest depth can only move closer when a pixel at that depth is replaced
+					bool farthestReplaced = false;
+					for(int row = firstRow; row <= lastRow; row++){
+						unsigned int rowCoverage = (unsigned int)(coverage >> (row * blockSize)) & columns;
+						float* depthRow = tileDepth + (size_t)(y - originY + row) * tileSize + (x - originX);
+						const RasterTriangle** nearestRow = nearest + (size_t)(y - originY + row) * tileSize + (x - originX);
+						for(int column = firstColumn; rowCoverage >> column; column++){
+							if(!((rowCoverage >> column) & 1)){
+								continue;
+							}
+							float z = triangle.depth.at(x + column, y + row);
+							if(z < depthRow[column]){
+								farthestReplaced = farthestReplaced || depthRow[column] == farthest[block];
+								depthRow[column] = z;
+								nearestRow[column] = &triangle;
+							}
+						}
+					}
+					if(farthestReplaced){
+						// Unchanged as long as another pixel is still at it, which is usual while the block fills
+						float blockFarthest = 0.0f;
+						for(int row = 0; row < blockSize && blockFarthest < farthest[block]; row++){
+							const float* depthRow = tileDepth + (size_t)(blockY * blockSize + row) * tileSize + blockX * blockSize;
+							for(int column = 0; column < blockSize; column++){
+								blockFarthest = std::max(blockFarthest, depthRow[column]);
+							}
+						}
+						blockChanged = blockChanged || blockFarthest != farthest[block];
+						farthest[block] = blockFarthest;
+					}
+				}
+			}
+			if(blockChanged){
+				tileFarthest = *std::max_element(farthest, farthest + blocksPerTile * blocksPerTile);
+			}
+		}
+	}
+
+	unsigned char clear[4] = { toUnorm8(clearColor.x), toUnorm8(clearColor.y), toUnorm8(clearColor.z), 255 };
+	for(int row = 0; row < tileHeight; row++){
+		size_t target = (size_t)(originY + row) * width + originX;
+		for(int column = 0; column < tileWidth; column++){
+			size_t local = (size_t)row * tileSize + column;
+			unsigned char* pixel = &pixels[(target + column) * 4];
+			depth[target + column] = tileDepth[local];
+			if(!nearest[local]){
+				std::copy(clear, clear + 4, pixel);
+				continue;
+			}
+			glm::vec3 color = shade(frame, *nearest[local], originX + column, originY + row);
+			pixel[0] = toUnorm8(color.x);
+			pixel[1] = toUnorm8(color.y);
+			pixel[2] = toUnorm8(color.z);
+			pixel[3] = 255;
+			tileStats.pixelsShaded++;
+		}
+	}
+}
+
+glm::vec3 SoftwareRasterizer::shade(const Frame& frame, const RasterTriangle& triangle, int x, int y) const {
+	const FrameParameters& parameters = *frame.parameters;
+	if(parameters.showZBuffer){
+		return glm::vec3(triangle.depth.at(x, y));
+	}
+
+	const ObjData& mesh = *frame.mesh;
+	size_t corner = 3 * (size_t)triangle.triangle;
+	float w = 1.0f / triangle.inverseW.at(x, y);
+	float barycentric1 = triangle.barycentric1.at(x, y) * w;
+	float barycentric2 = triangle.barycentric2.at(x, y) * w;
+	float barycentric0 = 1.0f - barycentric1 - barycentric2;
+	if(frame.gouraud){
+		return barycentric0 * cornerColors[corner] + barycentric1 * cornerColors[corner + 1] + barycentric2 * cornerColors[corner + 2];
+	}
+	if(!parameters.usePhongShading && !parameters.useFlatShading){
+		return parameters.objectColor;
+	}
+
+	const glm::vec3& a = worldPositions[mesh.vertexIndices[corner]];
+	const glm::vec3& b = worldPositions[mesh.vertexIndices[corner + 1]];
+	const glm::vec3& c = worldPositions[mesh.vertexIndices[corner + 2]];
+	glm::vec3 position = barycentric0 * a + barycentric1 * b + barycentric2 * c;
+	glm::vec3 normal;
+	if(parameters.useFlatShading || !frame.smoothNormals){
+		normal = facingNormal(a, b, c, parameters.viewerPosition);
+	} else {
+		normal = glm::normalize(barycentric0 * worldNormals[mesh.normalIndices[corner]] + barycentric1 * worldNormals[mesh.normalIndices[corner + 1]]
+			+ barycentric2 * worldNormals[mesh.normalIndices[corner + 2]]);
+	}
+	return lighting(parameters, position, normal, 0.1f);
+}
+
+double differingPixels(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b){
+	size_t differing = 0;
+	for(size_t i = 0; i < a.size(); i += 4){
+		for(size_t channel = 0; channel < 3; channel++){
+			if(std::abs((int)a[i + channel] - (int)b[i + channel]) > 2){
+				differing++;
+				break;
+			}
+		}
+	}
+	return a.empty() ? 0.0 : (double)differing / (a.size() / 4);
+}
+
+bool writePpm(const std::string& path, const std::vector<unsigned char>& pixels, int width, int height){
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if(!out.is_open()){
+		std::cerr << "Error: Cannot write " << path << std::endl;
+		return false;
+	}
+	out << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<unsigned char> row((size_t)width * 3);
+	for(int y = height - 1; y >= 0; y--){
+		for(int x = 0; x < width; x++){
+			const unsigned char* pixel = &pixels[((size_t)y * width + x) * 4];
+			std::copy(pixel, pixel + 3, &row[(size_t)x * 3]);
+		}
+		out.write((const char*)row.data(), row.size());
+	}
+	return out.good();
+}
+
+bool readPpm(const std::string& path, std::vector<unsigned char>& outPixels, int& outWidth, int& outHeight){
+	std::ifstream in(path, std::ios::binary);
+	if(!in.is_open()){
+		std::cerr << "Error: Cannot read " << path << std::endl;
+		return false;
+	}
+	// Header fields are separated by whitespace and may be followed by # comments
+	auto field = [&](){
+		std::string token;
+		while(in >> token && token[0] == '#'){
+			std::string comment;
+			std::getline(in, comment);
+		}
+		return token;
+	};
+	std::string magic = field();
+	std::string width = field();
+	std::string height = field();
+	std::string maxValue = field();
+	if(magic != "P6" || maxValue != "255" || width.empty() || height.empty()){
+		std::cerr << "Error: " << path << " is not an 8 bit binary PPM" << std::endl;
+		return false;
+	}
+	in.get();
+	outWidth = std::atoi(width.c_str());
+	outHeight = std::atoi(height.c_str());
+	outPixels.assign((size_t)outWidth * outHeight * 4, 255);
+	std::vector<unsigned char> row((size_t)outWidth * 3);
+	for(int y = outHeight - 1; y >= 0; y--){
+		if(!in.read((char*)row.data(), row.size())){
+			std::cerr << "Error: " << path << " is truncated" << std::endl;
+			return false;
+		}
+		for(int x = 0; x < outWidth; x++){
+			std::copy(&row[(size_t)x * 3], &row[(size_t)x * 3] + 3, &outPixels[((size_t)y * outWidth + x) * 4]);
+		}
+	}
+	return true;
+}
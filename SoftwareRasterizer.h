@@ -0,0 +1,154 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include "ObjData.h"
+#include "FrameUniforms.h"
+#include "ThreadPool.h"
+
+// CPU renderer for machines without a GPU. Draws the triangles of an ObjData (as readObjAsIndexed
+// or readObjCached with breakIntoTris give them) with the FrameParameters of the GL path into an
+// RGBA8 color buffer and a float depth buffer, rows bottom up like glReadPixels returns them.
+// Triangles are clipped to the near and far planes, drawn from both sides with a less depth test,
+// and shaded like shader.vs/shader.fs:
+//
+//   z buffer:  the window depth as gray
+//   Gouraud:   (diffuse + specular) * lightColor * objectColor per vertex, interpolated
+//   Phong:     (0.1 + diffuse + specular) * lightColor * objectColor per pixel
+//   flat:      Phong with the face normal turned towards the viewer (cross(dFdx, dFdy) on the GPU)
+//   otherwise: objectColor
+//
+// with diffuse = max(dot(n, l), 0) and specular = pow(max(dot(reflect(-l, n), v), 0), shininess).
+//
+// A frame runs in three passes on the rasterizer's ThreadPool: vertices and normals are
+// transformed in ranges; triangles are set up (fixed point edge functions with 4 sub pixel bits,
+// depth and barycentric planes) in ranges and binned into 64x64 pixel tiles, each range in its
+// own bins; then each tile walks its bins in triangle order. A triangle is skipped in a tile, or
+// in one of its 8x8 pixel blocks, when its nearest depth is behind the farthest depth stored there.
+// Blocks with all four corners inside are covered without per pixel edge tests; partly covered
+// ones test their pixels with SSE2 edge functions, 4 at a time. Only the triangle nearest in each
+// pixel is remembered, so every pixel is shaded once at the end of the tile.
+class SoftwareRasterizer {
+	public:
+		// Work done in the last render; a triangle counts once per tile it is binned into
+		class Stats {
+			public:
+				size_t trianglesSetUp = 0;
+				size_t trianglesClipped = 0;
+				size_t binnedTriangles = 0;
+				size_t blocksTested = 0;
+				size_t blocksRejectedByDepth = 0;
+				size_t pixelsShaded = 0;
+		};
+
+		static constexpr int tileSize = 64;
+		static constexpr int blockSize = 8;
+		// Clear color of renderFrame
+		glm::vec3 clearColor = glm::vec3(0.2f, 0.3f, 0.3f);
+
+		// threadCount 0 = all hardware threads
+		SoftwareRasterizer(int width, int height, unsigned int threadCount = 0);
+		~SoftwareRasterizer();
+
+		SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+		SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+		// Clears and draws the mesh. Triangles with an index out of range are skipped; without one
+		// normal index per corner the face normal is used.
+		void render(const ObjData& mesh, const FrameParameters& parameters);
+
+		// RGBA, 4 bytes per pixel, bottom row first
+		const std::vector<unsigned char>& getPixels() { return pixels; }
+		// Window depth in [0, 1], bottom row first
+		const std::vector<float>& getDepth() { return depth; }
+		Stats getStats() { return stats; }
+		int getWidth() { return width; }
+		int getHeight() { return height; }
+		unsigned int getThreadCount() { return pool.getThreadCount(); }
+
+	private:
+		// value = c + dx * x + dy * y at the center of pixel (x, y)
+		class Plane {
+			public:
+				float c;
+				float dx;
+				float dy;
+
+				float at(int x, int y) const { return c + dx * x + dy * y; }
+		};
+
+		class RasterTriangle {
+			public:
+				// Edge k is inside where a[k] * x + b[k] * y + c[k] >= 0, x and y in 1/16 pixels.
+				// The fill rule is folded into c.
+				int32_t a[3];
+				int32_t b[3];
+				int64_t c[3];
+				int minX, minY, maxX, maxY;
+				float nearestDepth;
+				Plane depth;
+				// 1/w and the second and third barycentric coordinates over w, for perspective correct attributes
+				Plane inverseW;
+				Plane barycentric1;
+				Plane barycentric2;
+				unsigned int triangle;
+		};
+
+		// Triangles set up by one range of the setup pass and, per tile, the ones touching it in order
+		class Bin {
+			public:
+				std::vector<RasterTriangle> triangles;
+				std::vector<std::vector<unsigned int>> tiles;
+		};
+
+		class ClipVertex {
+			public:
+				glm::vec4 position;
+				glm::vec3 barycentric;
+		};
+
+		// Per frame state the passes share
+		class Frame {
+			public:
+				const ObjData* mesh;
+				const FrameParameters* parameters;
+				glm::mat4 viewProjection;
+				bool smoothNormals;
+				bool gouraud;
+		};
+
+		int width;
+		int height;
+		int tilesX;
+		int tilesY;
+		std::vector<unsigned char> pixels;
+		std::vector<float> depth;
+		Stats stats;
+		ThreadPool pool;
+
+		std::vector<glm::vec4> clipPositions;
+		std::vector<glm::vec3> worldPositions;
+		std::vector<glm::vec3> worldNormals;
+		std::vector<glm::vec3> cornerColors;
+		std::vector<Bin> bins;
+
+		// fn(i) for i in [0, count) on the pool; returns once all are done
+		void runParallel(size_t count, const std::function<void(size_t)>& fn);
+
+		void transformVertices(const Frame& frame);
+		void setUpTriangles(const Frame& frame, size_t begin, size_t end, Bin& bin, Stats& binStats);
+		void setUpClipped(const ClipVertex* vertices, unsigned int triangle, Bin& bin, Stats& binStats);
+		void setUpTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, unsigned int triangle, Bin& bin, Stats& binStats);
+		void drawTile(const Frame& frame, int tileX, int tileY, Stats& tileStats);
+		glm::vec3 shade(const Frame& frame, const RasterTriangle& triangle, int x, int y) const;
+};
+
+// Share of pixels (RGBA) with a color channel more than 2 apart
+double differingPixels(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b);
+
+// Binary PPM of RGBA pixels stored bottom row first, as getPixels and glReadPixels give them
+bool writePpm(const std::string& path, const std::vector<unsigned char>& pixels, int width, int height);
+// Reads a binary PPM into RGBA pixels, bottom row first
+bool readPpm(const std::string& path, std::vector<unsigned char>& outPixels, int& outWidth, int& outHeight);
@@ -0,0 +1,45 @@
+#include "ThreadPool.h"
+#include "Parallel.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false) {
+	unsigned int workerCount = resolveThreadCount(threadCount);
+	workers.reserve(workerCount);
+	for(unsigned int i = 0; i < workerCount; i++){
+		workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(std::thread& worker : workers){
+		worker.join();
+	}
+}
+
+void ThreadPool::enqueue(std::function<void()> task){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::work(){
+	while(true){
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this](){ return stopping || !tasks.empty(); });
+			if(tasks.empty()){
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+// Fixed set of worker threads pulling tasks from one queue, for work that arrives over time
+// (parallelFor in Parallel.h spawns its workers per call instead). The destructor runs the
+// tasks still queued, then joins the workers.
+class ThreadPool {
+	public:
+		// 0 = all hardware threads
+		ThreadPool(unsigned int threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Queues fn() and returns a future of its result. An exception thrown by fn is rethrown by get().
+		template <typename Fn>
+		std::future<std::invoke_result_t<Fn>> submit(Fn fn){
+			typedef std::invoke_result_t<Fn> Result;
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+			std::future<Result> result = task->get_future();
+			enqueue([task](){ (*task)(); });
+			return result;
+		}
+
+		unsigned int getThreadCount() { return (unsigned int)workers.size(); }
+
+	private:
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<std::function<void()>> tasks;
+		std::vector<std::thread> workers;
+		bool stopping;
+
+		void enqueue(std::function<void()> task);
+		void work();
+};
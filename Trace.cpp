@@ -0,0 +1,234 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+
+#include "Trace.h"
+
+std::atomic<bool> tracingEnabled(false);
+
+namespace {
+	class TraceEvent {
+		public:
+			const char* name;
+			int64_t startNanoseconds;
+			int64_t durationNanoseconds;
+			uint64_t bytes;
+			uint64_t triangles;
+	};
+
+	// Events of one thread. Parallel workers are short lived, so the list is shared with the
+	// registry and outlives its thread; the mutex is only contended while exporting.
+	class ThreadEvents {
+		public:
+			std::mutex mutex;
+			unsigned int threadId = 0;
+			std::string threadName;
+			std::vector<TraceEvent> events;
+	};
+
+	class TraceRegistry {
+		public:
+			std::mutex mutex;
+			std::vector<std::shared_ptr<ThreadEvents>> threads;
+			std::chrono::steady_clock::time_point origin;
+			bool originSet = false;
+	};
+
+	TraceRegistry& registry(){
+		static TraceRegistry instance;
+		return instance;
+	}
+
+	ThreadEvents& currentThreadEvents(){
+		thread_local std::shared_ptr<ThreadEvents> events;
+		if(!events){
+			events = std::make_shared<ThreadEvents>();
+			TraceRegistry& traces = registry();
+			std::lock_guard<std::mutex> lock(traces.mutex);
+			events->threadId = (unsigned int)traces.threads.size() + 1;
+			traces.threads.push_back(events);
+		}
+		return *events;
+	}
+
+	std::string jsonString(const std::string& text){
+		std::string escaped = "\"";
+		for(char c : text){
+			if(c == '"' || c == '\\'){
+				escaped += '\\';
+				escaped += c;
+			} else if((unsigned char)c < 0x20){
+				escaped += ' ';
+			} else {
+				escaped += c;
+			}
+		}
+		return escaped + "\"";
+	}
+
+	// Copies of every thread's events, taken under each list's lock
+	std::vector<std::pair<std::shared_ptr<ThreadEvents>, std::vector<TraceEvent>>> snapshot(){
+		std::vector<std::shared_ptr<ThreadEvents>> threads;
+		{
+			TraceRegistry& traces = registry();
+			std::lock_guard<std::mutex> lock(traces.mutex);
+			threads = traces.threads;
+		}
+		std::vector<std::pair<std::shared_ptr<ThreadEvents>, std::vector<TraceEvent>>> copies;
+		for(const std::shared_ptr<ThreadEvents>& thread : threads){
+			std::lock_guard<std::mutex> lock(thread->mutex);
+			copies.emplace_back(thread, thread->events);
+		}
+		return copies;
+	}
+}
+
+void enableTracing(bool enabled){
+	if(enabled){
+		TraceRegistry& traces = registry();
+		std::lock_guard<std::mutex> lock(traces.mutex);
+		if(!traces.originSet){
+			traces.origin = std::chrono::steady_clock::now();
+			traces.originSet = true;
+		}
+	}
+	tracingEnabled.store(enabled);
+}
+
+void setTraceThreadName(const std::string& name){
+	ThreadEvents& events = currentThreadEvents();
+	std::lock_guard<std::mutex> lock(events.mutex);
+	events.threadName = name;
+}
+
+void clearTrace(){
+	for(auto& thread : snapshot()){
+		std::lock_guard<std::mutex> lock(thread.first->mutex);
+		thread.first->events.clear();
+	}
+}
+
+void TraceScope::record(){
+	auto end = std::chrono::steady_clock::now();
+	TraceEvent event;
+	event.name = name;
+	event.startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(start - registry().origin).count();
+	event.durationNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	event.bytes = bytes;
+	event.triangles = triangles;
+
+	ThreadEvents& events = currentThreadEvents();
+	std::lock_guard<std::mutex> lock(events.mutex);
+	events.events.push_back(event);
+}
+
+bool writeChromeTrace(const std::string& path){
+	std::ofstream out(path, std::ios::trunc);
+	if(!out.is_open()){
+		std::cerr << "Error: Cannot write trace " << path << std::endl;
+		return false;
+	}
+
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+	for(auto& thread : snapshot()){
+		unsigned int threadId = thread.first->threadId;
+		std::string threadName;
+		{
+			std::lock_guard<std::mutex> lock(thread.first->mutex);
+			threadName = thread.first->threadName;
+		}
+		if(threadName.empty()){
+			threadName = "thread " + std::to_string(threadId);
+		}
+		out << (first ? "" : ",") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << threadId
+			<< ", \"args\": {\"name\": " << jsonString(threadName) << "}}";
+		first = false;
+
+		// Chrome wants microseconds; three decimals keep the nanoseconds
+		out << std::fixed << std::setprecision(3);
+		for(const TraceEvent& event : thread.second){
+			out << ",\n{\"name\": " << jsonString(event.name) << ", \"cat\": \"viewGL\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << threadId
+				<< ", \"ts\": " << event.startNanoseconds / 1000.0 << ", \"dur\": " << event.durationNanoseconds / 1000.0;
+			if(event.bytes || event.triangles){
+				out << ", \"args\": {\"bytes\": " << event.bytes << ", \"triangles\": " << event.triangles << "}";
+			}
+			out << "}";
+		}
+		out << std::defaultfloat;
+	}
+	out << "\n]}\n";
+	return out.good();
+}
+
+void printTraceSummary(std::ostream& out){
+	class Totals {
+		public:
+			std::string name;
+			uint64_t calls = 0;
+			int64_t totalNanoseconds = 0;
+			int64_t maxNanoseconds = 0;
+			uint64_t bytes = 0;
+			uint64_t triangles = 0;
+	};
+	std::map<std::string, Totals> byName;
+	for(auto& thread : snapshot()){
+		for(const TraceEvent& event : thread.second){
+			Totals& totals = byName[event.name];
+			totals.name = event.name;
+			totals.calls++;
+			totals.totalNanoseconds += event.durationNanoseconds;
+			totals.maxNanoseconds = std::max(totals.maxNanoseconds, event.durationNanoseconds);
+			totals.bytes += event.bytes;
+			totals.triangles += event.triangles;
+		}
+	}
+	std::vector<Totals> rows;
+	for(auto& entry : byName){
+		rows.push_back(entry.second);
+	}
+	std::sort(rows.begin(), rows.end(), [](const Totals& a, const Totals& b){ return a.totalNanoseconds > b.totalNanoseconds; });
+
+	size_t nameWidth = 4;
+	for(const Totals& row : rows){
+		nameWidth = std::max(nameWidth, row.name.size());
+	}
+	std::ios::fmtflags flags = out.flags();
+	out << std::left << std::setw((int)nameWidth) << "name" << std::right
+		<< std::setw(10) << "calls" << std::setw(12) << "total ms" << std::setw(12) << "mean ms" << std::setw(12) << "max ms"
+		<< std::setw(12) << "MB" << std::setw(14) << "triangles" << "\n";
+	out << std::fixed;
+	for(const Totals& row : rows){
+		out << std::left << std::setw((int)nameWidth) << row.name << std::right
+			<< std::setw(10) << row.calls
+			<< std::setprecision(3) << std::setw(12) << row.totalNanoseconds / 1e6
+			<< std::setw(12) << row.totalNanoseconds / 1e6 / row.calls
+			<< std::setw(12) << row.maxNanoseconds / 1e6
+			<< std::setprecision(2) << std::setw(12) << row.bytes / (1024.0 * 1024.0)
+			<< std::setw(14) << row.triangles << "\n";
+	}
+	out.flags(flags);
+}
+
+TraceSession::TraceSession(const std::string& path) : path(path) {
+	if(!path.empty()){
+		setTraceThreadName("main");
+		enableTracing(true);
+	}
+}
+
+TraceSession::~TraceSession(){
+	if(path.empty()){
+		return;
+	}
+	enableTracing(false);
+	if(writeChromeTrace(path)){
+		std::cout << "Trace written to " << path << "\n";
+	}
+	printTraceSummary(std::cout);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+// Scoped timers for the load and frame pipelines. A TraceScope records its name, thread, start and
+// duration, and optionally a byte and a triangle count, when it goes out of scope. Recording is
+// off until enableTracing(true); while off a scope costs one relaxed atomic load and no clock read.
+// Each thread appends to its own event list, so workers don't contend while recording.
+extern std::atomic<bool> tracingEnabled;
+
+inline bool isTracingEnabled(){
+	return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+// Timestamps in the exports count from the first enableTracing(true)
+void enableTracing(bool enabled);
+// Shown instead of "thread <n>" in the exports, e.g. "main" or "model loader"
+void setTraceThreadName(const std::string& name);
+// Drops every recorded event
+void clearTrace();
+
+// Chrome trace event JSON ("X" complete events, one track per thread), for chrome://tracing or Perfetto
+bool writeChromeTrace(const std::string& path);
+// Per name: calls, total, mean and max milliseconds, bytes and triangles, sorted by total time
+void printTraceSummary(std::ostream& out);
+
+class TraceScope {
+	public:
+		// name has to outlive the trace (a string literal); events keep the pointer
+		explicit TraceScope(const char* name) : name(name), active(isTracingEnabled()) {
+			if(active){
+				start = std::chrono::steady_clock::now();
+			}
+		}
+		~TraceScope(){
+			if(active){
+				record();
+			}
+		}
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+		void setBytes(uint64_t value) { bytes = value; }
+		void setTriangles(uint64_t value) { triangles = value; }
+
+	private:
+		const char* name;
+		bool active;
+		std::chrono::steady_clock::time_point start;
+		uint64_t bytes = 0;
+		uint64_t triangles = 0;
+
+		void record();
+};
+
+// Enables tracing for its lifetime when path is not empty, then writes the Chrome trace to path
+// and prints the summary. Meant to be the first object in main, so every other one is gone by then.
+class TraceSession {
+	public:
+		TraceSession(const std::string& path);
+		~TraceSession();
+
+		TraceSession(const TraceSession&) = delete;
+		TraceSession& operator=(const TraceSession&) = delete;
+
+	private:
+		std::string path;
+};
@@ -0,0 +1,387 @@
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "VertexLayout.h"
+#include "Bounds.h"
+
+namespace {
+	// Signed normalized 10:10:10:2, w left at 0
+	uint32_t packNormal1010102(const glm::vec3& normal){
+		auto component = [](float value){
+			int scaled = (int)std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f);
+			return (uint32_t)scaled & 0x3FF;
+		};
+		return component(normal.x) | (component(normal.y) << 10) | (component(normal.z) << 20);
+	}
+
+	float signNotZero(float value){
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	unsigned short toUnorm16(float value){
+		return (unsigned short)std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+	}
+
+	// Octahedral normal as 2x16 bit snorm. Of the four neighbouring grid points, keep the one
+	// that decodes closest to the input rather than just rounding each component.
+	void octahedralQuantize(const glm::vec3& normal, short outEncoded[2]){
+		glm::vec2 encoded = octahedralEncode(normal);
+		int baseX = (int)std::floor(encoded.x * 32767.0f);
+		int baseY = (int)std::floor(encoded.y * 32767.0f);
+		float bestDot = -2.0f;
+		for(int dx = 0; dx <= 1; dx++){
+			for(int dy = 0; dy <= 1; dy++){
+				int x = std::clamp(baseX + dx, -32767, 32767);
+				int y = std::clamp(baseY + dy, -32767, 32767);
+				float dot = glm::dot(octahedralDecode(glm::vec2(x / 32767.0f, y / 32767.0f)), normal);
+				if(dot > bestDot){
+					bestDot = dot;
+					outEncoded[0] = (short)x;
+					outEncoded[1] = (short)y;
+				}
+			}
+		}
+	}
+
+	// Read one component the way the vertex fetch would (GL normalized integer rules)
+	float readComponent(const unsigned char* source, VertexAttributeFormat::Type type, bool normalized, int component){
+		typedef VertexAttributeFormat::Type Format;
+		if(type == Format::FLOAT){
+			float value;
+			memcpy(&value, source + component * sizeof(float), sizeof(value));
+			return value;
+		} else if(type == Format::HALF_FLOAT){
+			unsigned short value;
+			memcpy(&value, source + component * sizeof(value), sizeof(value));
+			return halfToFloat(value);
+		} else if(type == Format::UNSIGNED_SHORT){
+			unsigned short value;
+			memcpy(&value, source + component * sizeof(value), sizeof(value));
+			return normalized ? value / 65535.0f : value;
+		} else if(type == Format::SHORT){
+			short value;
+			memcpy(&value, source + component * sizeof(value), sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+		}
+
+		uint32_t packed;
+		memcpy(&packed, source, sizeof(packed));
+		int value = (int)((packed >> (10 * component)) & 0x3FF);
+		if(value >= 512){
+			value -= 1024;
+		}
+		return normalized ? std::max(value / 511.0f, -1.0f) : value;
+	}
+
+	glm::vec3 readAttribute(const VertexBufferData& vertexData, const VertexAttributeFormat& attribute, size_t vertex){
+		const unsigned char* source = vertexData.buffers[attribute.buffer].data()
+			+ vertex * vertexData.layout.strides[attribute.buffer] + attribute.offset;
+		glm::vec3 value(0.0f);
+		for(int i = 0; i < std::min(attribute.components, 3); i++){
+			value[i] = readComponent(source, attribute.type, attribute.normalized, i);
+		}
+		return value;
+	}
+
+	template <typename T>
+	void writeAt(std::vector<unsigned char>& buffer, size_t offset, const T& value){
+		memcpy(buffer.data() + offset, &value, sizeof(T));
+	}
+}
+
+// Project onto the octahedron |x|+|y|+|z| = 1 and fold the lower half over the diagonals
+glm::vec2 octahedralEncode(const glm::vec3& normal){
+	float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if(sum == 0.0f){
+		return glm::vec2(0.0f);
+	}
+	glm::vec2 encoded(normal.x / sum, normal.y / sum);
+	if(normal.z < 0.0f){
+		encoded = glm::vec2((1.0f - std::fabs(encoded.y)) * signNotZero(encoded.x),
+			(1.0f - std::fabs(encoded.x)) * signNotZero(encoded.y));
+	}
+	return encoded;
+}
+
+glm::vec3 octahedralDecode(const glm::vec2& encoded){
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+	if(normal.z < 0.0f){
+		float x = normal.x;
+		normal.x = (1.0f - std::fabs(normal.y)) * signNotZero(x);
+		normal.y = (1.0f - std::fabs(x)) * signNotZero(normal.y);
+	}
+	return glm::normalize(normal);
+}
+
+std::string octahedralDecodeGLSL(){
+	return
+		"#define OCTAHEDRAL_NORMALS\n"
+		"vec3 octahedralDecode(vec2 e) {\n"
+		"    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));\n"
+		"    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+		"    return normalize(n);\n"
+		"}\n";
+}
+
+// IEEE 754 binary16 with round to nearest even; out of range values become infinity
+unsigned short floatToHalf(float value){
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if(exponent == 0xFF){
+		return (unsigned short)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	}
+
+	int halfExponent = (int)exponent - 127 + 15;
+	if(halfExponent >= 0x1F){
+		return (unsigned short)(sign | 0x7C00);
+	}
+
+	if(halfExponent <= 0){
+		// Subnormal half (or zero)
+		if(halfExponent < -10){
+			return (unsigned short)sign;
+		}
+		mantissa |= 0x800000;
+		int shift = 14 - halfExponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if(rest > halfway || (rest == halfway && (half & 1))){
+			half++;
+		}
+		return (unsigned short)(sign | half);
+	}
+
+	// A carry out of the mantissa correctly bumps the exponent
+	uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	if(rest > 0x1000 || (rest == 0x1000 && (half & 1))){
+		half++;
+	}
+	return (unsigned short)(sign | half);
+}
+
+float halfToFloat(unsigned short value){
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	if(exponent == 0){
+		float magnitude = std::ldexp((float)mantissa, -24);
+		return sign ? -magnitude : magnitude;
+	}
+
+	uint32_t bits;
+	if(exponent == 0x1F){
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	} else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+VertexLayout VertexLayout::create(Type type, bool hasNormals, bool hasUvs){
+	typedef VertexAttributeFormat::Type Format;
+	VertexLayout layout;
+	layout.type = type;
+
+	if(type == Type::SEPARATE){
+		layout.strides.push_back(sizeof(glm::vec3));
+		layout.attributes.push_back({0, 3, Format::FLOAT, false, 0, 0});
+		if(hasNormals){
+			layout.attributes.push_back({1, 3, Format::FLOAT, false, (unsigned int)layout.strides.size(), 0});
+			layout.strides.push_back(sizeof(glm::vec3));
+		}
+		if(hasUvs){
+			layout.attributes.push_back({2, 2, Format::FLOAT, false, (unsigned int)layout.strides.size(), 0});
+			layout.strides.push_back(sizeof(glm::vec2));
+		}
+	} else if(type == Type::INTERLEAVED){
+		size_t stride = 0;
+		layout.attributes.push_back({0, 3, Format::FLOAT, false, 0, stride});
+		stride += sizeof(glm::vec3);
+		if(hasNormals){
+			layout.attributes.push_back({1, 3, Format::FLOAT, false, 0, stride});
+			stride += sizeof(glm::vec3);
+		}
+		if(hasUvs){
+			layout.attributes.push_back({2, 2, Format::FLOAT, false, 0, stride});
+			stride += sizeof(glm::vec2);
+		}
+		layout.strides.push_back(stride);
+	} else if(type == Type::QUANTIZED){
+		// Position padded to 8 bytes so the following attributes stay 4 byte aligned
+		size_t stride = 0;
+		layout.attributes.push_back({0, 3, Format::UNSIGNED_SHORT, true, 0, stride});
+		stride += 4 * sizeof(unsigned short);
+		if(hasNormals){
+			layout.attributes.push_back({1, 2, Format::SHORT, true, 0, stride});
+			stride += 2 * sizeof(short);
+		}
+		if(hasUvs){
+			layout.attributes.push_back({2, 2, Format::HALF_FLOAT, false, 0, stride});
+			stride += 2 * sizeof(unsigned short);
+		}
+		layout.strides.push_back(stride);
+	} else {
+		size_t stride = 0;
+		layout.attributes.push_back({0, 3, Format::FLOAT, false, 0, stride});
+		stride += sizeof(glm::vec3);
+		if(hasNormals){
+			layout.attributes.push_back({1, 4, Format::INT_2_10_10_10_REV, true, 0, stride});
+			stride += sizeof(uint32_t);
+		}
+		if(hasUvs){
+			layout.attributes.push_back({2, 2, Format::HALF_FLOAT, false, 0, stride});
+			stride += 2 * sizeof(unsigned short);
+		}
+		layout.strides.push_back(stride);
+	}
+	return layout;
+}
+
+const char* VertexLayout::name(Type type){
+	switch(type){
+		case Type::SEPARATE: return "separate";
+		case Type::INTERLEAVED: return "interleaved";
+		case Type::PACKED: return "packed";
+		case Type::QUANTIZED: return "quantized";
+	}
+	return "unknown";
+}
+
+size_t VertexBufferData::bytes() const {
+	size_t total = 0;
+	for(const std::vector<unsigned char>& buffer : buffers){
+		total += buffer.size();
+	}
+	return total;
+}
+
+void buildVertexBuffers(const ObjData& data, VertexLayout::Type type, VertexBufferData& outData){
+	typedef VertexAttributeFormat::Type Format;
+	const size_t vertexCount = data.vertices.size();
+	const bool hasNormals = data.normals.size() == vertexCount && vertexCount > 0;
+	const bool hasUvs = data.uvs.size() == vertexCount && vertexCount > 0;
+
+	outData.layout = VertexLayout::create(type, hasNormals, hasUvs);
+	outData.vertexCount = vertexCount;
+	outData.buffers.assign(outData.layout.strides.size(), std::vector<unsigned char>());
+	for(size_t i = 0; i < outData.buffers.size(); i++){
+		outData.buffers[i].assign(outData.layout.strides[i] * vertexCount, 0);
+	}
+
+	// Quantized positions are stored relative to their bounds
+	glm::vec3 positionMin(0.0f);
+	glm::vec3 positionExtent(1.0f);
+	outData.positionDequantization = glm::mat4(1.0f);
+	if(type == VertexLayout::Type::QUANTIZED && vertexCount > 0){
+		Bounds bounds = computeBounds(data.vertices);
+		positionMin = bounds.min;
+		positionExtent = bounds.max - bounds.min;
+		for(int axis = 0; axis < 3; axis++){
+			if(positionExtent[axis] <= 0.0f){
+				positionExtent[axis] = 1.0f;
+			}
+		}
+		outData.positionDequantization = glm::scale(glm::translate(glm::mat4(1.0f), positionMin), positionExtent);
+	}
+
+	for(const VertexAttributeFormat& attribute : outData.layout.attributes){
+		std::vector<unsigned char>& buffer = outData.buffers[attribute.buffer];
+		const size_t stride = outData.layout.strides[attribute.buffer];
+
+		// Tightly packed float source, plain copy
+		if(attribute.type == Format::FLOAT && outData.layout.type == VertexLayout::Type::SEPARATE){
+			const void* source = attribute.location == 0 ? (const void*)data.vertices.data()
+				: attribute.location == 1 ? (const void*)data.normals.data() : (const void*)data.uvs.data();
+			memcpy(buffer.data(), source, buffer.size());
+			continue;
+		}
+
+		for(size_t i = 0; i < vertexCount; i++){
+			size_t offset = i * stride + attribute.offset;
+			if(attribute.location == 0){
+				if(attribute.type == Format::FLOAT){
+					writeAt(buffer, offset, data.vertices[i]);
+				} else {
+					glm::vec3 relative = (data.vertices[i] - positionMin) / positionExtent;
+					unsigned short position[3] = { toUnorm16(relative.x), toUnorm16(relative.y), toUnorm16(relative.z) };
+					writeAt(buffer, offset, position);
+				}
+			} else if(attribute.location == 1){
+				if(attribute.type == Format::FLOAT){
+					writeAt(buffer, offset, data.normals[i]);
+				} else if(attribute.type == Format::SHORT){
+					short encoded[2];
+					octahedralQuantize(data.normals[i], encoded);
+					writeAt(buffer, offset, encoded);
+				} else {
+					writeAt(buffer, offset, packNormal1010102(data.normals[i]));
+				}
+			} else if(attribute.location == 2){
+				if(attribute.type == Format::FLOAT){
+					writeAt(buffer, offset, data.uvs[i]);
+				} else {
+					unsigned short uv[2] = { floatToHalf(data.uvs[i].x), floatToHalf(data.uvs[i].y) };
+					writeAt(buffer, offset, uv);
+				}
+			}
+		}
+	}
+}
+
+QuantizationReport measureQuantizationError(const ObjData& data, const VertexBufferData& vertexData){
+	typedef VertexAttributeFormat::Type Format;
+	QuantizationReport report;
+	if(vertexData.vertexCount == 0){
+		return report;
+	}
+
+	Bounds bounds = computeBounds(data.vertices);
+	float diagonal = glm::length(bounds.max - bounds.min);
+
+	size_t floatBytes = sizeof(glm::vec3);
+	size_t layoutBytes = 0;
+	for(size_t stride : vertexData.layout.strides){
+		layoutBytes += stride;
+	}
+
+	for(const VertexAttributeFormat& attribute : vertexData.layout.attributes){
+		if(attribute.location == 1){
+			floatBytes += sizeof(glm::vec3);
+		} else if(attribute.location == 2){
+			floatBytes += sizeof(glm::vec2);
+		}
+
+		for(size_t i = 0; i < vertexData.vertexCount; i++){
+			glm::vec3 decoded = readAttribute(vertexData, attribute, i);
+			if(attribute.location == 0){
+				glm::vec3 position = glm::vec3(vertexData.positionDequantization * glm::vec4(decoded, 1.0f));
+				report.maxPositionError = std::max(report.maxPositionError, glm::length(position - data.vertices[i]));
+			} else if(attribute.location == 1){
+				glm::vec3 normal = attribute.type == Format::SHORT ? octahedralDecode(glm::vec2(decoded.x, decoded.y)) : glm::normalize(decoded);
+				float cosine = std::clamp(glm::dot(normal, glm::normalize(data.normals[i])), -1.0f, 1.0f);
+				report.maxNormalErrorDegrees = std::max(report.maxNormalErrorDegrees, glm::degrees(std::acos(cosine)));
+			} else if(attribute.location == 2){
+				glm::vec2 difference = glm::vec2(decoded.x, decoded.y) - data.uvs[i];
+				report.maxUvError = std::max(report.maxUvError, std::max(std::fabs(difference.x), std::fabs(difference.y)));
+			}
+		}
+	}
+
+	report.maxPositionErrorRelative = diagonal > 0.0f ? report.maxPositionError / diagonal : 0.0f;
+	report.bytesPerVertexBefore = (float)floatBytes;
+	report.bytesPerVertexAfter = (float)layoutBytes;
+	return report;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <string>
+#include <glm/glm.hpp>
+#include "ObjData.h"
+
+// One vertex attribute inside a layout: which shader location reads it, its format, and where
+// it sits in which buffer. Formats are mapped to GL enums when the layout is bound (GpuMesh).
+class VertexAttributeFormat {
+	public:
+		enum class Type { FLOAT, HALF_FLOAT, INT_2_10_10_10_REV, UNSIGNED_SHORT, SHORT };
+
+		unsigned int location;
+		int components;
+		Type type;
+		bool normalized;
+		unsigned int buffer;
+		size_t offset;
+};
+
+// Describes how the position/normal/uv attributes (shader locations 0/1/2) are stored.
+//   SEPARATE:    one tightly packed float buffer per attribute (the original upload path)
+//   INTERLEAVED: one buffer, position/normal/uv floats next to each other with a single stride
+//   PACKED:      one buffer, float position, 10:10:10:2 normal and half float uv (20 bytes)
+//   QUANTIZED:   one buffer, 16 bit unorm position within the bounding box, octahedral normal
+//                in 2x16 bit snorm and half float uv (16 bytes), so uvs need no decoding.
+//                The vertex shader must decode normals (see octahedralDecodeGLSL) and the
+//                model matrix must include VertexBufferData::positionDequantization.
+class VertexLayout {
+	public:
+		enum class Type { SEPARATE, INTERLEAVED, PACKED, QUANTIZED };
+
+		Type type;
+		std::vector<size_t> strides;
+		std::vector<VertexAttributeFormat> attributes;
+
+		static VertexLayout create(Type type, bool hasNormals, bool hasUvs);
+		static const char* name(Type type);
+};
+
+// Vertex data of a mesh converted to a layout, one byte array per layout buffer
+class VertexBufferData {
+	public:
+		VertexLayout layout;
+		std::vector<std::vector<unsigned char>> buffers;
+		size_t vertexCount = 0;
+
+		// Maps quantized [0,1] positions back to the mesh bounds; identity for float layouts
+		glm::mat4 positionDequantization = glm::mat4(1.0f);
+
+		size_t bytes() const;
+};
+
+// Largest deviation of the layout's decoded attributes from the float source
+class QuantizationReport {
+	public:
+		float maxPositionError = 0.0f;
+		float maxPositionErrorRelative = 0.0f; // fraction of the bounding box diagonal
+		float maxNormalErrorDegrees = 0.0f;
+		float maxUvError = 0.0f;
+		float bytesPerVertexBefore = 0.0f;
+		float bytesPerVertexAfter = 0.0f;
+};
+
+// Convert the unified attribute arrays of a welded (or separate triangle) ObjData
+void buildVertexBuffers(const ObjData& data, VertexLayout::Type type, VertexBufferData& outData);
+
+// Decode data built by buildVertexBuffers the way the GPU would and compare it to the source
+QuantizationReport measureQuantizationError(const ObjData& data, const VertexBufferData& vertexData);
+
+// GLSL for the vertex shader of the QUANTIZED layout, inserted after #version with OCTAHEDRAL_NORMALS defined
+std::string octahedralDecodeGLSL();
+
+glm::vec2 octahedralEncode(const glm::vec3& normal);
+glm::vec3 octahedralDecode(const glm::vec2& encoded);
+
+unsigned short floatToHalf(float value);
+float halfToFloat(unsigned short value);
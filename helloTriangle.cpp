@@ -8,17 +8,26 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <ctime>
+#include <memory>
 #include <glm/gtc/matrix_transform.hpp>
 #include "ShaderReader.h"
 #include "ShaderProgram.h"
 #include "ObjReader.h"
+#include "Benchmarks.h"
+#include "VertexLayout.h"
+#include "GpuMesh.h"
+#include "FrameUniforms.h"
+#include "Renderer.h"
+#include "HeadlessBenchmark.h"
+#include "AsyncModelLoader.h"
+#include "Trace.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void window_refresh_callback(GLFWwindow* window);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
-void set_vec3_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, glm::vec3 const& v);
-void set_boolean_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, bool v);
-void set_float_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, float v);
+ViewState current_view_state();
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -45,6 +54,11 @@ bool useGouraudShading = false;
 bool usePhongShading = false;
 bool useFlatShading = false;
 
+// Set by the input handlers: which parts of the frame parameters to recompute (ViewChange bits),
+// and whether the window needs a redraw for another reason (resize, damaged contents)
+unsigned int view_changes = VIEW_CHANGE_ALL;
+bool redraw_needed = true;
+
 void reset_variables() {
     x_position = 0.0;
     y_position = 0.0;
@@ -58,17 +72,209 @@ void reset_variables() {
     fovy = 45.0;
     near_plane = 0.1;
     far_plane = 1000.0f;
+    view_changes = VIEW_CHANGE_ALL;
 }
 
 int main(int argc, char *argv[])
 {
-    // Load in program arguments as variables
-    std::string input;
-    std::cout << "Enter the object you want to read: ";
+    // Chrome trace of the load and frame pipelines, written with a summary table at exit: --trace <file.json>
+    // Works with the benchmarks too. Declared first, so everything traced is gone when it is written.
+    std::string tracePath;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--trace") {
+            tracePath = argv[i + 1];
+        }
+    }
+    TraceSession traceSession(tracePath);
+
+    // Benchmarks run without a window: helloTriangle --bench-parse <model>
+    if (argc >= 3 && std::string(argv[1]) == "--bench-parse") {
+        return benchmarkObjParsers(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-parallel") {
+        unsigned int maxThreads = argc >= 4 ? std::stoi(argv[3]) : 0;
+        return benchmarkParallelLoad(argv[2], maxThreads) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-cache") {
+        return benchmarkMeshCache(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-weld") {
+        return benchmarkWeld(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 4 && std::string(argv[1]) == "--bench-stream") {
+        size_t ceilingMegabytes = std::stoul(argv[3]);
+        return benchmarkStreaming(argv[2], ceilingMegabytes * 1024 * 1024) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-layouts") {
+        return benchmarkVertexLayouts(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-clip") {
+        size_t vertexCount = argc >= 3 ? std::stoul(argv[2]) : 10000000;
+        unsigned int threads = argc >= 4 ? std::stoi(argv[3]) : 0;
+        return benchmarkScaleToClipCoords(vertexCount, threads) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-separate") {
+        unsigned int threads = argc >= 4 ? std::stoi(argv[3]) : 0;
+        return benchmarkSeparateTriangles(argv[2], threads) ? 0 : 1;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-polygons") {
+        unsigned int copies = argc >= 3 ? std::stoi(argv[2]) : 20000;
+        return benchmarkPolygonTriangulation(copies) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-optimize") {
+        return benchmarkTriangleOrder(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-assets") {
+        std::string directory = argc >= 3 ? argv[2] : "../data/assets";
+        unsigned int fileCount = argc >= 4 ? std::stoi(argv[3]) : 500;
+        return benchmarkAssetManager(directory, fileCount) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-normals") {
+        unsigned int maxThreads = argc >= 4 ? std::stoi(argv[3]) : 0;
+        return benchmarkNormalGeneration(argv[2], maxThreads) ? 0 : 1;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-memory") {
+        unsigned int loads = argc >= 4 ? std::stoi(argv[3]) : 10;
+        return benchmarkRepeatedLoads(argv[2], loads) ? 0 : 1;
+    }
 
-    // Take input as a string
-    std::getline(std::cin, input);
-    std::string targetModel = input; // choose shape/model
+    // Vertex layout: helloTriangle --layout separate|interleaved|packed|quantized
+    // Uniform upload: --uniforms legacy looks every uniform up by name each frame, for comparison
+    // Model without the stdin prompt: --model <name>
+    // Frustum culling of the mesh clusters: --culling off draws every triangle
+    // Levels of detail by projected error: --lod off neither builds nor uses them
+    // Shading modes: --variants off draws every mode with the one shader branching on the flags
+    // Render on demand: --idle off redraws continuously instead of waiting for input when nothing changed
+    // Software rendering: --shading none|gouraud|phong|flat|zbuffer, --reference <image.ppm> to compare against
+    VertexLayout::Type vertexLayout = VertexLayout::Type::INTERLEAVED;
+    bool legacyUniforms = false;
+    bool culling = true;
+    bool lodEnabled = true;
+    bool shadingVariants = true;
+    bool idleWait = true;
+    std::string modelOption;
+    std::string jsonPath;
+    std::string shadingOption = "phong";
+    std::string referencePath;
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--layout") {
+            if (value == "separate") vertexLayout = VertexLayout::Type::SEPARATE;
+            else if (value == "packed") vertexLayout = VertexLayout::Type::PACKED;
+            else if (value == "quantized") vertexLayout = VertexLayout::Type::QUANTIZED;
+            else vertexLayout = VertexLayout::Type::INTERLEAVED;
+        }
+        if (option == "--uniforms") {
+            legacyUniforms = value == "legacy";
+        }
+        if (option == "--model") {
+            modelOption = value;
+        }
+        if (option == "--json") {
+            jsonPath = value;
+        }
+        if (option == "--culling") {
+            culling = value != "off";
+        }
+        if (option == "--lod") {
+            lodEnabled = value != "off";
+        }
+        if (option == "--variants") {
+            shadingVariants = value != "off";
+        }
+        if (option == "--idle") {
+            idleWait = value != "off";
+        }
+        if (option == "--shading") {
+            shadingOption = value;
+        }
+        if (option == "--reference") {
+            referencePath = value;
+        }
+    }
+
+    // Headless: helloTriangle --bench-render <model> [frames] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-render") {
+        unsigned int frameCount = argc >= 4 && argv[3][0] != '-' ? std::stoi(argv[3]) : 600;
+        return benchmarkHeadlessRender(argv[2], frameCount, vertexLayout, jsonPath) ? 0 : 1;
+    }
+    // Headless: helloTriangle --bench-scene <scene|model,model,...> [instances] [frames] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-scene") {
+        unsigned int instanceCount = argc >= 4 && argv[3][0] != '-' ? std::stoi(argv[3]) : 10000;
+        unsigned int frameCount = argc >= 5 && argv[4][0] != '-' ? std::stoi(argv[4]) : 100;
+        return benchmarkHeadlessScene(argv[2], instanceCount, frameCount, vertexLayout, jsonPath) ? 0 : 1;
+    }
+    // Headless: helloTriangle --bench-cull <model> [frames] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-cull") {
+        unsigned int frameCount = argc >= 4 && argv[3][0] != '-' ? std::stoi(argv[3]) : 300;
+        return benchmarkHeadlessCulling(argv[2], frameCount, vertexLayout, jsonPath) ? 0 : 1;
+    }
+    // Headless: helloTriangle --bench-lod <model> [frames] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-lod") {
+        unsigned int frameCount = argc >= 4 && argv[3][0] != '-' ? std::stoi(argv[3]) : 60;
+        return benchmarkHeadlessLod(argv[2], frameCount, vertexLayout, jsonPath) ? 0 : 1;
+    }
+
+    // Headless: helloTriangle --bench-shading <model> [frames] [width] [height] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-shading") {
+        unsigned int frameCount = argc >= 4 && argv[3][0] != '-' ? std::stoi(argv[3]) : 30;
+        int targetWidth = argc >= 5 && argv[4][0] != '-' ? std::stoi(argv[4]) : 3840;
+        int targetHeight = argc >= 6 && argv[5][0] != '-' ? std::stoi(argv[5]) : 2160;
+        return benchmarkHeadlessShading(argv[2], frameCount, targetWidth, targetHeight, vertexLayout, jsonPath) ? 0 : 1;
+    }
+
+    // Headless: helloTriangle --bench-software <model> [frames] [width] [height] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-software") {
+        unsigned int frameCount = argc >= 4 && argv[3][0] != '-' ? std::stoi(argv[3]) : 30;
+        int targetWidth = argc >= 5 && argv[4][0] != '-' ? std::stoi(argv[4]) : 1920;
+        int targetHeight = argc >= 6 && argv[5][0] != '-' ? std::stoi(argv[5]) : 1080;
+        return benchmarkHeadlessSoftware(argv[2], frameCount, targetWidth, targetHeight, vertexLayout, jsonPath) ? 0 : 1;
+    }
+
+    // Without a GPU: helloTriangle --render-software <model> <image.ppm> [width] [height] [--shading ...] [--reference <image.ppm>]
+    if (argc >= 4 && std::string(argv[1]) == "--render-software") {
+        int imageWidth = argc >= 5 && argv[4][0] != '-' ? std::stoi(argv[4]) : SCR_WIDTH;
+        int imageHeight = argc >= 6 && argv[5][0] != '-' ? std::stoi(argv[5]) : SCR_HEIGHT;
+        ViewState view;
+        view.showZBuffer = shadingOption == "zbuffer";
+        view.useGouraudShading = shadingOption == "gouraud";
+        view.usePhongShading = shadingOption == "phong";
+        view.useFlatShading = shadingOption == "flat";
+        return renderSoftwareImage(argv[2], view, imageWidth, imageHeight, argv[3], referencePath) ? 0 : 1;
+    }
+
+    // Headless: helloTriangle --bench-load <model> [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-load") {
+        return benchmarkHeadlessLoad(argv[2], vertexLayout, jsonPath) ? 0 : 1;
+    }
+
+    // Headless: helloTriangle --bench-idle <model> [seconds per phase] [--layout ...] [--json <file>]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-idle") {
+        double phaseSeconds = argc >= 4 && argv[3][0] != '-' ? std::stod(argv[3]) : 5.0;
+        return benchmarkHeadlessIdle(argv[2], phaseSeconds, vertexLayout, jsonPath) ? 0 : 1;
+    }
+
+    // Headless: helloTriangle --bench-shaders [repeats] [--json <file>]
+    if (argc >= 2 && std::string(argv[1]) == "--bench-shaders") {
+        unsigned int repeats = argc >= 3 && argv[2][0] != '-' ? std::stoi(argv[2]) : 10;
+        return benchmarkHeadlessProgramCache(repeats, jsonPath) ? 0 : 1;
+    }
+
+    // Load in program arguments as variables. The name is asked for before the window opens, so
+    // closing the window never waits on the prompt and startup is timed from the answer.
+    std::string targetModel = modelOption; // choose shape/model
+    if (targetModel.empty()) {
+        std::string input;
+        std::cout << "Enter the object you want to read: ";
+
+        // Take input as a string
+        std::getline(std::cin, input);
+        targetModel = input;
+    }
+
+    // Startup is timed from here to the first frame, the first triangles and the full mesh
+    auto launchTime = std::chrono::high_resolution_clock::now();
 
     // glfw: initialize and configure
     // ------------------------------
@@ -92,6 +298,7 @@ int main(int argc, char *argv[])
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
     glfwSetKeyCallback(window, key_callback);
 
     // // glew: load all OpenGL function pointers
@@ -99,78 +306,40 @@ int main(int argc, char *argv[])
 
     glEnable(GL_DEPTH_TEST);
 
-    // Choose shader    
-    std::string vertexShader = "shader";
-    std::string fragmentShader = "shader";
-
-    auto vertex = ("../data/shaders/" + vertexShader + ".vs");
-    auto frag = ("../data/shaders/" + fragmentShader + ".fs");
-    ShaderReader shaderReader(vertex.c_str(), frag.c_str());
-    ShaderData shaderData;
-    shaderReader.read(shaderData);
-    if(shaderReader.wasError()){
-        std::cout << "Failed to read shader data. \n";
+    std::unique_ptr<ShaderProgram> shaderProgram = loadShaderProgram(vertexLayout);
+    if (!shaderProgram) {
         return -1;
     }
-    
-    ShaderProgram shaderProgram(shaderData);
-    if(shaderProgram.wasError()){
-        std::cout << "Failed to compile and link program \n";
+
+    // Locations (or the FrameParameters uniform buffer) are resolved once here
+    shaderProgram->use();
+    std::unique_ptr<FrameUniforms> frameUniforms(new FrameUniforms(*shaderProgram));
+    if (!legacyUniforms && frameUniforms->wasError()) {
+        std::cout << "Failed to find the frame uniforms \n";
         return -1;
     }
+    std::cout << "Frame parameters: " << (legacyUniforms ? "looked up by name every frame" :
+        frameUniforms->usesUniformBuffer() ? "std140 uniform buffer" : "cached uniform locations") << "\n";
+
+    // One program per shading mode with the mode compiled in, built when the keys first select it.
+    // Looking every uniform up by name needs the flags as uniforms, so legacy stays on the one above.
+    std::unique_ptr<ShadingPrograms> shadingPrograms;
+    if (shadingVariants && !legacyUniforms) {
+        shadingPrograms.reset(new ShadingPrograms(vertexLayout));
+    }
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
-    ObjReader objReader;
-    ObjData objData;
-    unsigned int numVertices = 0;
-    objReader.readObjAsIndexed(targetModel, objData, true);
-    
- 
-
-    // .obj files are indexed triangle structures. Need to convert to separate triangles. 
-    ObjData currentObjData;
-   
-        // Resolve into currentObj, then count actual number of vertices used. Put here for flexibility
-     objReader.indexedToSeparateTriangles(objData, currentObjData);
-        numVertices = currentObjData.vertices.size();
-    
-    
-
-    unsigned int VAO;
-    unsigned int VBO_Verts, VBO_Color; // VAO will contain 2 buffers, use data from both. 
-    unsigned int EBO;
-
-    // Request indices from GPU, managed by OS.
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO_Verts);
-    glGenBuffers(1, &VBO_Color);
-    glGenBuffers(1, &EBO);
-
-    // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_Verts);
-    glBufferData(GL_ARRAY_BUFFER, currentObjData.vertices.size() * sizeof(glm::vec3), &currentObjData.vertices[0], GL_STATIC_DRAW);
-
-    // Pointer starts at first vertex (0 floats in), and jumps past itself (3 floats) every iteration
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_Color);
-    glBufferData(GL_ARRAY_BUFFER, currentObjData.normals.size() * sizeof(glm::vec3), &currentObjData.normals[0], GL_STATIC_DRAW);
-
-    // Pointer starts at first vertex (0 floats in), and jumps past itself (3 floats) every iteration
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-
-    // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
-
-    // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
-    // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-    glBindVertexArray(0); 
-
+    // The model is read and prepared on a background thread, so the window is already responsive,
+    // and frames draw the triangles uploaded so far until then
+    std::unique_ptr<AsyncModelLoader> loader(new AsyncModelLoader(targetModel, vertexLayout, lodEnabled));
+    RenderModel model;
+    const size_t uploadBudgetBytes = 4 * 1024 * 1024; // per frame, while loading
+    bool firstFrame = true;
+    bool firstTriangles = true;
+    auto sinceLaunch = [&]() {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - launchTime).count() * 1000.0;
+    };
 
     // uncomment this call to draw in wireframe polygons.
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -178,141 +347,159 @@ int main(int argc, char *argv[])
 
     std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
     unsigned int frames = 0;
-    double totalDuration;
-    double lastPrintDuration;
-    bool cpuAppliedTransformLastFrame = false;
+    double totalDuration = 0.0;
+    unsigned long long totalGlCalls = 0;
+    unsigned long long totalTriangles = 0;
+    double totalCullDuration = 0.0;
+    unsigned long long totalLods = 0;
+    const unsigned int framesPerReport = 600;
+    VisibleClusters visible;
+    FrameParameters frameParameters = computeFrameParameters(current_view_state(), model.vertexData.positionDequantization);
+
+    // Render on demand: frames are drawn only when input changed something, the window needs
+    // repainting or the model is still arriving; otherwise the loop sleeps in glfwWaitEventsTimeout.
+    // Swaps wait for vsync, so holding a key doesn't spin either.
+    const double idleTimeout = 0.5;
+    if (idleWait) {
+        glfwSwapInterval(1);
+    }
+
+    // Process CPU time (every thread) over wall time, to see what the viewer costs idle and while interacting
+    const double cpuReportSeconds = 10.0;
+    std::clock_t cpuReportStart = std::clock();
+    auto wallReportStart = std::chrono::high_resolution_clock::now();
+    unsigned int framesSinceCpuReport = 0;
+    auto reportCpu = [&]() {
+        double wallSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - wallReportStart).count();
+        if (wallSeconds < cpuReportSeconds) {
+            return;
+        }
+        double cpuSeconds = (double)(std::clock() - cpuReportStart) / CLOCKS_PER_SEC;
+        std::cout << "CPU: " << cpuSeconds / wallSeconds * 100.0 << "% of a core over " << wallSeconds << " s, "
+            << framesSinceCpuReport << " frames drawn\n";
+        cpuReportStart = std::clock();
+        wallReportStart = std::chrono::high_resolution_clock::now();
+        framesSinceCpuReport = 0;
+    };
 
     // render loop
     // -----------
     std::cout << "Starting render loop \n";
     while (!glfwWindowShouldClose(window))
     {
-        frames++;
         // input
         // -----
         processInput(window);
 
-        // render
-        // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-        // Create model transform. May update every frame, so need to set each frame. 
-        // ------
-        glm::mat4 modelMatrix(1.0f);        
-        float x_rotate = x_rotation * 3.142 / 180;
-        float y_rotate = y_rotation * 3.142 / 180;
-        float z_rotate = z_rotation * 3.142 / 180;
-
-        modelMatrix = glm::translate(modelMatrix, glm::vec3(x_position, y_position, z_position)) 
-            * glm::rotate(modelMatrix, x_rotate, glm::vec3(1.f, 0.f, 0.f)) 
-            * glm::rotate(modelMatrix, y_rotate, glm::vec3(0.f, 1.f, 0.f)) 
-            * glm::rotate(modelMatrix, z_rotate, glm::vec3(0.f, 0.f, 1.f))
-            * glm::scale(modelMatrix, glm::vec3(x_scale, y_scale, z_scale));
-                
-        // View Matrix
-        glm::mat4 viewMatrix(1.0f);
-        glm::vec3 viewerPosition = glm::vec3(0.0);
-        glm::vec3 viewerCenter = glm::vec3(0.0, 0.0, -1.0);
-        glm::vec3 viewerUp = glm::vec3(0.0, 1.0, 0.0);
-        viewMatrix = glm::lookAt(viewerPosition, viewerCenter, viewerUp);
-
-        // Perspective Projection Matrix
-        glm::mat4 perspectiveMatrix;
-        float fov_r = glm::radians(fovy);
-        float aspect_ratio = (float)SCR_WIDTH / (float)SCR_HEIGHT;
-        float zNear = near_plane;
-        float zFar = far_plane;
-        perspectiveMatrix = glm::perspective(fov_r, aspect_ratio, zNear, zFar);
-        
-        // Normal Matrix for lighting calculation
-        glm::mat3 normalMatrix;
-        normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
-
-        start = std::chrono::high_resolution_clock::now();
-
-        // Use model transform. Comparing strings is a fraction of time. 
-        // ------
-        
-            // Set uniform variable in GPU's existing shader program.
-            int modelPosition = glGetUniformLocation(shaderProgram.getID(), "model");
-            glUniformMatrix4fv(modelPosition, 1, GL_FALSE, &modelMatrix[0][0]);
-
-            // Set view matrix
-            int viewPosition = glGetUniformLocation(shaderProgram.getID(), "view");
-            glUniformMatrix4fv(viewPosition, 1, GL_FALSE, &viewMatrix[0][0]);
-
-            // Set uniform variable for projection matrix in GPU's shader program
-            int projectionPosition = glGetUniformLocation(shaderProgram.getID(), "projection");
-            glUniformMatrix4fv(projectionPosition, 1, GL_FALSE, &perspectiveMatrix[0][0]);
-
-            // Normal Matrix for Gouraud and Phong shading
-            int normalMatrixPosition = glGetUniformLocation(shaderProgram.getID(), "normalMatrix");
-            glUniformMatrix3fv(normalMatrixPosition, 1, GL_FALSE, &normalMatrix[0][0]);
-
-        
-
-
-        int showZBufferPosition = glGetUniformLocation(shaderProgram.getID(), "showZBuffer");
-        if (showZBufferPosition == -1) {
-            char infoLog[1024];
-            glGetProgramInfoLog(shaderProgram.getID(), 512, NULL, infoLog);
-            std::cerr << infoLog << std::endl;
-            std::cerr << "Error: Cannot find the uniform variable showZBuffer" << std::endl;
-            exit(1);
+        // Upload what the loader has for this frame; the full model replaces the progressive mesh
+        bool loading = loader->isLoading();
+        if (loader->update(model, uploadBudgetBytes)) {
+            std::cout << "Full mesh after " << sinceLaunch() << " ms\n";
+            // The model matrix includes the loaded layout's dequantization
+            view_changes |= VIEW_CHANGE_MODEL;
         }
-        if (showZBuffer) {
-            glUniform1i(showZBufferPosition, 1);
+        if (loader->wasError()) {
+            break;
         }
-        else {
-            glUniform1i(showZBufferPosition, 0);
+
+        if (idleWait && view_changes == 0 && !redraw_needed && !loading) {
+            // Nothing to draw: sleep until an event (key press, resize, refresh) or the timeout
+            glfwWaitEventsTimeout(idleTimeout);
+            reportCpu();
+            continue;
         }
+        frames++;
+        framesSinceCpuReport++;
+        TraceScope frameTrace("frame");
 
-        // Lighting Calculations
-        {
-           glm::vec3 lightPosition = glm::vec3(0.0, 3.0, -3.0);
-           glm::vec3 lightColor = glm::vec3(1.0);
-           glm::vec3 objectColor = glm::vec3(1.0, 0.0, 0.0); // RED COLOR
-           float shininess = 32;
-           set_vec3_uniform(shaderProgram, "lightPosition", lightPosition);
-           set_vec3_uniform(shaderProgram, "viewerPosition", viewerPosition);
-           set_vec3_uniform(shaderProgram, "lightColor", lightColor);
-           set_vec3_uniform(shaderProgram, "objectColor", objectColor);
-           set_boolean_uniform(shaderProgram, "useGouraudShading", useGouraudShading);
-           set_boolean_uniform(shaderProgram, "usePhongShading", usePhongShading);
-           set_boolean_uniform(shaderProgram, "useFlatShading", useFlatShading);
-           set_float_uniform(shaderProgram, "shininess", shininess);
+        // Transform, projection and lighting. Only the parts the input changed are recomputed.
+        // ------
+        ViewState viewState = current_view_state();
+        updateFrameParameters(viewState, model.vertexData.positionDequantization, view_changes, frameParameters);
+        view_changes = 0;
+        redraw_needed = false;
+
+        ShaderProgram* program = shaderProgram.get();
+        FrameUniforms* uniforms = frameUniforms.get();
+        ShadingVariant variant = ShadingVariant::of(viewState);
+        if (shadingPrograms && shadingPrograms->getProgram(variant)) {
+            program = shadingPrograms->getProgram(variant);
+            uniforms = shadingPrograms->getUniforms(variant);
         }
 
-        // Draw using GPU buffer data
+        // render
         // ------
-        shaderProgram.use();
-        glBindVertexArray(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
-        glDrawArrays(GL_TRIANGLES, 0, numVertices);
-         
+        start = std::chrono::high_resolution_clock::now();
+        unsigned int lod = 0;
+        unsigned int glCalls;
+        if (model.mesh) {
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            lod = lodEnabled ? selectLod(model, frameParameters, viewState.fovy, (float)framebufferHeight) : 0;
+            selectDrawRanges(model, frameParameters, lod, culling, visible);
+            totalCullDuration += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            glCalls = renderFrame(*program, *uniforms, *model.mesh, frameParameters, legacyUniforms, visible);
+        } else {
+            ProgressiveMesh* progressiveMesh = loader->getProgressiveMesh();
+            glCalls = renderFrame(*program, *uniforms, progressiveMesh, frameParameters, legacyUniforms);
+            visible.clear();
+            visible.triangleCount = progressiveMesh ? progressiveMesh->getVertexCount() / 3 : 0;
+        }
         end = std::chrono::high_resolution_clock::now();
+
+        // CPU submit time only; --bench-render measures GPU time with timer queries
         std::chrono::duration<double> elapsedSeconds = end - start;
         totalDuration += elapsedSeconds.count();
+        totalGlCalls += glCalls;
+        totalTriangles += visible.triangleCount;
+        frameTrace.setTriangles(visible.triangleCount);
+        totalLods += lod;
+        if (frames % framesPerReport == 0) {
+            std::cout << "Submit: " << totalDuration / framesPerReport * 1e6 << " us CPU ("
+                << totalCullDuration / framesPerReport * 1e6 << " us LOD and culling), "
+                << (double)totalGlCalls / framesPerReport << " GL calls, "
+                << (double)totalTriangles / framesPerReport << " of " << model.clusters.triangleCount << " triangles, LOD "
+                << (double)totalLods / framesPerReport << " per frame\n";
+            totalDuration = 0.0;
+            totalCullDuration = 0.0;
+            totalGlCalls = 0;
+            totalTriangles = 0;
+            totalLods = 0;
+        }
 
        
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         // Swap buffers should just move pointers, doesn't scale based on number of items.
-        glfwSwapBuffers(window);
+        {
+            TraceScope swapTrace("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+        reportCpu();
+        if (firstFrame) {
+            std::cout << "First frame after " << sinceLaunch() << " ms\n";
+            firstFrame = false;
+        }
+        if (firstTriangles && visible.triangleCount > 0) {
+            std::cout << "First triangles after " << sinceLaunch() << " ms\n";
+            firstTriangles = false;
+        }
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO_Verts);
-    glDeleteBuffers(1, &VBO_Color);
+    model.mesh.reset();
+    bool loadFailed = loader->wasError();
+    loader.reset();
+    shadingPrograms.reset();
+    frameUniforms.reset();
+    shaderProgram.reset();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    return 0;
+    return loadFailed ? -1 : 0;
 }
 
 struct ButtonBinds {
@@ -330,7 +517,9 @@ struct ButtonBinds {
 };
 
 
-void updateDeltaFromInput(GLFWwindow* window, float& x, float& y, float& z, float delta, const ButtonBinds& binds){
+// Returns true if a key changed one of the values
+bool updateDeltaFromInput(GLFWwindow* window, float& x, float& y, float& z, float delta, const ButtonBinds& binds){
+    float oldX = x, oldY = y, oldZ = z;
     bool allInc = glfwGetKey(window, binds.allInc) == GLFW_PRESS;
     bool allDec = glfwGetKey(window, binds.allDec) == GLFW_PRESS;
     if (glfwGetKey(window, binds.xInc) == GLFW_PRESS || allInc)
@@ -345,6 +534,7 @@ void updateDeltaFromInput(GLFWwindow* window, float& x, float& y, float& z, floa
         z += delta;
     if (glfwGetKey(window, binds.zDec) == GLFW_PRESS || allDec)
         z -= delta;
+    return x != oldX || y != oldY || z != oldZ;
 }
 
 void updateIfReset(GLFWwindow* window, int reset_glfw_key)
@@ -396,10 +586,13 @@ void processInput(GLFWwindow *window)
         GLFW_KEY_UNKNOWN, GLFW_KEY_UNKNOWN   // SKIP ALL INC/DEC
     };
 
-    updateDeltaFromInput(window, x_position, y_position, z_position, positionDelta, positionKeys);
-    updateDeltaFromInput(window, x_rotation, y_rotation, z_rotation, rotationDelta, rotationKeys);
-    updateDeltaFromInput(window, x_scale, y_scale, z_scale, scaleDelta, scaleKeys);
-    updateDeltaFromInput(window, fovy, near_plane, far_plane, projectionDelta, perspectiveKeys);
+    bool modelChanged = updateDeltaFromInput(window, x_position, y_position, z_position, positionDelta, positionKeys);
+    modelChanged |= updateDeltaFromInput(window, x_rotation, y_rotation, z_rotation, rotationDelta, rotationKeys);
+    modelChanged |= updateDeltaFromInput(window, x_scale, y_scale, z_scale, scaleDelta, scaleKeys);
+    if (modelChanged)
+        view_changes |= VIEW_CHANGE_MODEL;
+    if (updateDeltaFromInput(window, fovy, near_plane, far_plane, projectionDelta, perspectiveKeys))
+        view_changes |= VIEW_CHANGE_PROJECTION;
 
     // Reset values to default
     updateIfReset(window, GLFW_KEY_SPACE);
@@ -413,6 +606,14 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    redraw_needed = true;
+}
+
+// glfw: the window contents were damaged (uncovered, restored from minimized) and need repainting
+// ---------------------------------------------------------------------------------------------
+void window_refresh_callback(GLFWwindow*)
+{
+    redraw_needed = true;
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -435,31 +636,25 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         useGouraudShading = false;
         usePhongShading = false;
     }
-}
-
-void set_vec3_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, glm::vec3 const& v) {
-    int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
-    if (position == -1) {
-        std::cerr << "Error: Cannot find uniform variable: " << uniform_name << std::endl;
-        exit(1);
-    }
-    glUniform3fv(position, 1, &v[0]);
-}
-
-void set_boolean_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, bool v) {
-    int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
-    if (position == -1) {
-        std::cerr << "Error: Cannot find uniform variable: " << uniform_name << std::endl;
-        exit(1);
+    else {
+        return;
     }
-    glUniform1i(position, (int)v);
+    view_changes |= VIEW_CHANGE_SHADING;
 }
 
-void set_float_uniform(ShaderProgram &shaderProgram, std::string const& uniform_name, float v) {
-    int position = glGetUniformLocation(shaderProgram.getID(), uniform_name.c_str());
-    if (position == -1) {
-        std::cerr << "Error: Cannot find uniform variable: " << uniform_name << std::endl;
-        exit(1);
-    }
-    glUniform1f(position, v);
+// The keyboard controlled state as the renderer takes it
+ViewState current_view_state() {
+    ViewState view;
+    view.position = glm::vec3(x_position, y_position, z_position);
+    view.rotationDegrees = glm::vec3(x_rotation, y_rotation, z_rotation);
+    view.scale = glm::vec3(x_scale, y_scale, z_scale);
+    view.fovy = fovy;
+    view.nearPlane = near_plane;
+    view.farPlane = far_plane;
+    view.aspectRatio = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+    view.showZBuffer = showZBuffer;
+    view.useGouraudShading = useGouraudShading;
+    view.usePhongShading = usePhongShading;
+    view.useFlatShading = useFlatShading;
+    return view;
 }
\ No newline at end of file